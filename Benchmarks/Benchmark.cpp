@@ -0,0 +1,38 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+std::string FormatDetail(const char* format, ...)
+{
+	char text[256];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+	return std::string(text, length < 0 ? 0 : std::min<size_t>(length, sizeof(text) - 1));
+}
+
+void PrintSamples(const char* title, const char* parameter, const char* items,
+	const std::vector<BenchmarkSample>& samples)
+{
+	printf("\n%s\n", title);
+	if (items)
+		printf("  %-34s %10s %14s %12s %14s  %s\n", "", parameter, items, "ms", "per second", "");
+	else
+		printf("  %-34s %10s %12s  %s\n", "", parameter, "ms", "");
+	for (const BenchmarkSample& sample : samples)
+	{
+		if (items)
+		{
+			double rate = sample.Milliseconds > 0.0 ? sample.Items * 1000.0 / sample.Milliseconds : 0.0;
+			printf("  %-34s %10g %14.0f %12.4f %14.4g  %s\n", sample.Name.c_str(), sample.Parameter, sample.Items,
+				sample.Milliseconds, rate, sample.Detail.c_str());
+		}
+		else
+		{
+			printf("  %-34s %10g %12.4f  %s\n", sample.Name.c_str(), sample.Parameter, sample.Milliseconds,
+				sample.Detail.c_str());
+		}
+	}
+}
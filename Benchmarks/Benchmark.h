@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// timing helpers shared by the headless benchmarks
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One timed configuration of a benchmark, printed as one row by PrintSamples.
+struct BenchmarkSample
+{
+	// What was timed, e.g. "ReadObj" or "CreateGeosphere".
+	std::string Name;
+	// The value the benchmark sweeps: a thread count, a tessellation, a camera distance.
+	double Parameter = 0.0;
+	// Work done by one run, in the unit the benchmark counts (bytes, corners, vertices),
+	// so PrintSamples can show a rate.  0 prints no rate.
+	double Items = 0.0;
+	// Average time of one run.
+	double Milliseconds = 0.0;
+	// Anything else worth reading next to the time: output sizes, statistics, checks.
+	std::string Detail;
+};
+
+// Calls run repeat times and returns the average time of one call in milliseconds.
+template<typename Run>
+double AverageMilliseconds(size_t repeat, const Run& run)
+{
+	if (repeat == 0)
+		return 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t r = 0; r < repeat; ++r)
+		run();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / repeat;
+}
+
+// printf into a std::string, for BenchmarkSample::Detail.
+std::string FormatDetail(const char* format, ...);
+
+// Prints samples as a table under title.  parameter and items name the Parameter and
+// Items columns; a null items leaves out the item count and rate.
+void PrintSamples(const char* title, const char* parameter, const char* items,
+	const std::vector<BenchmarkSample>& samples);
+
+// A synthetic OBJ in the working directory, shared by the benchmarks that read a model.
+extern const wchar_t* const BenchmarkObjFileName;
+// About 2 million triangles and 210 MB of text.
+constexpr unsigned BenchmarkGridSize = 1025;
+
+// Writes a gridSize x gridSize vertex height field with v, vt and vn, triangulated into
+// f v/vt/vn lines and split into eight o parts.
+bool WriteBenchmarkObj(const wchar_t* objFileName, unsigned gridSize);
+// Writes BenchmarkObjFileName at BenchmarkGridSize unless it is already there.
+bool MakeBenchmarkObj();
+
+// The benchmarks, each printing its own table.  They return false if their input could
+// not be made or read.
+bool BenchmarkObjRead();
+bool BenchmarkVertexCache();
+bool BenchmarkMeshCodec();
+bool CheckVertexQuantization();
+bool BenchmarkLodSelect();
+bool BenchmarkGeosphere();
+bool BenchmarkRings();
+bool BenchmarkGrid();
+bool BenchmarkTerrain();
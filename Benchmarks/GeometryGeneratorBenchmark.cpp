@@ -0,0 +1,154 @@
+#include "Benchmark.h"
+#include "Common/GeometryGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// CreateGeosphere, and so Subdivide, at every depth up to 8 on one thread and on every
+// hardware thread, three calls each.
+bool BenchmarkGeosphere()
+{
+	const size_t repeat = 3;
+	const GeometryGenerator::uint32 maxSubdivisions = 8;
+	GeometryGenerator::uint32 hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	GeometryGenerator geoGen;
+	std::vector<BenchmarkSample> samples;
+	for (GeometryGenerator::uint32 level = 0; level <= maxSubdivisions; ++level)
+	{
+		for (GeometryGenerator::uint32 threads = 1; ; threads = hardwareThreads)
+		{
+			BenchmarkSample sample;
+			sample.Name = "CreateGeosphere";
+			sample.Parameter = level;
+			size_t vertices = 0, indices = 0;
+			sample.Milliseconds = AverageMilliseconds(repeat, [&]() {
+				GeometryGenerator::MeshData meshData = geoGen.CreateGeosphere(1.0f, level, threads);
+				vertices = meshData.Vertices.size();
+				indices = meshData.Indices32.size();
+			});
+			sample.Items = (double)vertices;
+			sample.Detail = FormatDetail("threads %u, %zu indices", threads, indices);
+			samples.push_back(sample);
+			if (threads == hardwareThreads)
+				break;
+		}
+	}
+	PrintSamples("Geosphere subdivision", "depth", "vertices", samples);
+	return true;
+}
+
+// The ring math of CreateSphere and CreateCylinder at 64 to 2048 slices and stacks: the
+// span overloads into preallocated memory, and the sines and cosines of every ring
+// vertex computed four at a time with XMVectorSinCos, as those functions do, and one at
+// a time with sinf and cosf, three calls each.
+bool BenchmarkRings()
+{
+	using namespace DirectX;
+	const size_t repeat = 3;
+	const GeometryGenerator::uint32 counts[] = { 64, 256, 1024, 2048 };
+
+	GeometryGenerator geoGen;
+	std::vector<GeometryGenerator::Vertex> vertices;
+	std::vector<GeometryGenerator::uint32> indices;
+	std::vector<BenchmarkSample> samples;
+	for (GeometryGenerator::uint32 count : counts)
+	{
+		auto time = [&](const char* name, GeometryGenerator::MeshSize size, const auto& run)
+		{
+			BenchmarkSample sample;
+			sample.Name = name;
+			sample.Parameter = count;
+			sample.Items = size.VertexCount;
+			sample.Milliseconds = AverageMilliseconds(repeat, run);
+			if (size.IndexCount)
+				sample.Detail = FormatDetail("%u indices", size.IndexCount);
+			samples.push_back(sample);
+		};
+
+		GeometryGenerator::MeshSize size = GeometryGenerator::SphereSize(count, count);
+		vertices.resize(size.VertexCount);
+		indices.resize(size.IndexCount);
+		time("CreateSphere", size, [&]() { geoGen.CreateSphere(1.0f, count, count, vertices.data(), indices.data()); });
+
+		size = GeometryGenerator::CylinderSize(count, count);
+		vertices.resize(size.VertexCount);
+		indices.resize(size.IndexCount);
+		time("CreateCylinder", size, [&]() {
+			geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, count, count, vertices.data(), indices.data()); });
+
+		// The angle loops sum sin*cos, which keeps the compiler from dropping them and
+		// shows both agree.
+		const float step = XM_2PI / count;
+		GeometryGenerator::MeshSize angles = { (count + 1) * count, 0 };
+		float sum = 0.0f;
+		time("XMVectorSinCos", angles, [&]() {
+			const XMVECTOR lanes = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+			for (GeometryGenerator::uint32 i = 0; i < count; ++i)
+			{
+				for (GeometryGenerator::uint32 j = 0; j <= count; j += 4)
+				{
+					XMVECTOR s, c;
+					XMVectorSinCos(&s, &c, XMVectorScale(XMVectorAdd(XMVectorReplicate((float)j), lanes), step));
+					XMFLOAT4A sines, cosines;
+					XMStoreFloat4A(&sines, s);
+					XMStoreFloat4A(&cosines, c);
+					GeometryGenerator::uint32 last = std::min(count + 1 - j, 4u);
+					for (GeometryGenerator::uint32 k = 0; k < last; ++k)
+						sum += (&sines.x)[k] * (&cosines.x)[k];
+				}
+			}
+		});
+		samples.back().Detail = FormatDetail("sum %.4f", sum / repeat);
+		sum = 0.0f;
+		time("sinf/cosf", angles, [&]() {
+			for (GeometryGenerator::uint32 i = 0; i < count; ++i)
+			{
+				for (GeometryGenerator::uint32 j = 0; j <= count; ++j)
+					sum += sinf(j * step) * cosf(j * step);
+			}
+		});
+		samples.back().Detail = FormatDetail("sum %.4f", sum / repeat);
+	}
+	PrintSamples("Ring vertices", "slices", "vertices", samples);
+	return true;
+}
+
+// The CreateGrid span overload into preallocated memory, from 64 x 64 to 4096 x 4096
+// vertices, on 1, 2 and 4 threads and on every hardware thread, three calls each.  Grids
+// too small to give each thread ParallelForMinItems vertices run on one thread whatever
+// the count.
+bool BenchmarkGrid()
+{
+	const size_t repeat = 3;
+	const GeometryGenerator::uint32 sizes[] = { 64, 256, 1024, 4096 };
+	GeometryGenerator::uint32 hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<GeometryGenerator::uint32> threadCounts = { 1, 2, 4 };
+	if (std::find(threadCounts.begin(), threadCounts.end(), hardwareThreads) == threadCounts.end())
+		threadCounts.push_back(hardwareThreads);
+
+	GeometryGenerator geoGen;
+	std::vector<GeometryGenerator::Vertex> vertices;
+	std::vector<GeometryGenerator::uint32> indices;
+	std::vector<BenchmarkSample> samples;
+	for (GeometryGenerator::uint32 size : sizes)
+	{
+		GeometryGenerator::MeshSize meshSize = GeometryGenerator::GridSize(size, size);
+		vertices.resize(meshSize.VertexCount);
+		indices.resize(meshSize.IndexCount);
+		for (GeometryGenerator::uint32 threads : threadCounts)
+		{
+			BenchmarkSample sample;
+			sample.Name = "CreateGrid";
+			sample.Parameter = size;
+			sample.Items = meshSize.VertexCount;
+			sample.Milliseconds = AverageMilliseconds(repeat, [&]() {
+				geoGen.CreateGrid(100.0f, 100.0f, size, size, vertices.data(), indices.data(), threads);
+			});
+			sample.Detail = FormatDetail("threads %u of %u", threads, hardwareThreads);
+			samples.push_back(sample);
+		}
+	}
+	PrintSamples("Grid generation", "rows", "vertices", samples);
+	return true;
+}
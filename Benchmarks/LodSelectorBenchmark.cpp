@@ -0,0 +1,97 @@
+#include "Benchmark.h"
+#include "Common/GeometryGenerator.h"
+#include "Common/LodSelector.h"
+#include "Common/MeshSimplifier.h"
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// The levels of a geosphere simplified with MeshSimplifier's default ratios, each from
+	// the one before, laid out one after another in a single index range.
+	std::vector<RenderItemLod> BuildGeosphereLods(float radius)
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData sphere = geoGen.CreateGeosphere(radius, 5);
+		const GeometryGenerator::Vertex* vertices = sphere.Vertices.data();
+
+		std::vector<std::uint32_t> indices = sphere.Indices32;
+		std::vector<RenderItemLod> levels;
+		levels.push_back(RenderItemLod{ (UINT)indices.size(), 0, 0.0f });
+		for (float ratio : MeshSimplifier::DefaultLodRatios)
+		{
+			RenderItemLod previous = levels.back();
+			std::vector<std::uint32_t> lod(indices.begin() + previous.StartIndexLocation,
+				indices.begin() + previous.StartIndexLocation + previous.IndexCount);
+			float error = 0.0f;
+			size_t lodCount = MeshSimplifier::Simplify(lod.data(), lod.data(), lod.size(), &vertices[0].Position,
+				sphere.Vertices.size(), sizeof(GeometryGenerator::Vertex), (size_t)(sphere.Indices32.size() * ratio),
+				FLT_MAX, 0, &error, &vertices[0].Normal.x, 3);
+			if (lodCount == 0 || lodCount == previous.IndexCount)
+				break;
+			levels.push_back(RenderItemLod{ (UINT)lodCount, (UINT)indices.size(), previous.Error + error });
+			indices.insert(indices.end(), lod.begin(), lod.begin() + lodCount);
+		}
+		return levels;
+	}
+}
+
+// Runs LodSelector::Select over a 64 x 64 grid of geospheres with a LOD chain while the
+// eye pulls back from the grid, 100 selects at each distance.  Distances are multiples of
+// the radius of the grid and are visited in order, so hysteresis sees the camera moving.
+bool BenchmarkLodSelect()
+{
+	const size_t repeat = 100;
+	const UINT gridSize = 64;
+	const float radius = 1.0f, spacing = 3.0f;
+	const float distances[] = { 0.05f, 0.1f, 0.25f, 0.5f, 1.0f, 2.0f, 4.0f };
+
+	std::vector<RenderItemLod> lods = BuildGeosphereLods(radius);
+	std::vector<RenderItem> items(gridSize * gridSize);
+	std::vector<RenderItem*> itemPointers;
+	for (UINT row = 0; row < gridSize; ++row)
+	{
+		for (UINT col = 0; col < gridSize; ++col)
+		{
+			RenderItem& item = items[row * gridSize + col];
+			XMStoreFloat4x4(&item.World, XMMatrixTranslation((col - 0.5f * (gridSize - 1)) * spacing, 0.0f,
+				(row - 0.5f * (gridSize - 1)) * spacing));
+			item.Lods = lods;
+			item.IndexCount = lods[0].IndexCount;
+			item.Bounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			item.Bounds.Radius = radius;
+			itemPointers.push_back(&item);
+		}
+	}
+	float sceneRadius = 0.5f * (gridSize - 1) * spacing * 1.41421356f + radius;
+
+	// A 1080 pixel high viewport with a 45 degree field of view, looking down at 45 degrees.
+	LodView view;
+	view.PixelsPerUnit = 1080.0f / (2.0f * std::tan(0.125f * XM_PI));
+	view.NearZ = 1.0f;
+	XMVECTOR direction = XMVector3Normalize(XMVectorSet(0.0f, 1.0f, -1.0f, 0.0f));
+
+	std::vector<BenchmarkSample> samples;
+	for (float distance : distances)
+	{
+		XMStoreFloat3(&view.EyePos, XMVectorScale(direction, distance * sceneRadius));
+		BenchmarkSample sample;
+		sample.Name = "Select";
+		sample.Parameter = distance;
+		sample.Items = (double)items.size();
+		LodSelectStatistics stats;
+		size_t r = 0;
+		sample.Milliseconds = AverageMilliseconds(repeat, [&]() {
+			LodSelectStatistics runStats = LodSelector::Select(itemPointers.data(), itemPointers.size(), view);
+			// Only the first select at a distance switches levels.
+			if (r++ == 0)
+				stats = runStats;
+		});
+		sample.Detail = FormatDetail("%zu switched, %zu of %zu triangles", stats.Switched, stats.Triangles,
+			stats.FullTriangles);
+		samples.push_back(sample);
+	}
+	PrintSamples("LOD selection", "distance", "items", samples);
+	return true;
+}
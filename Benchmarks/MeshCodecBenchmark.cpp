@@ -0,0 +1,93 @@
+#include "Benchmark.h"
+#include "Common/MboFile.h"
+#include "Common/MeshCodec.h"
+#include "Common/MeshOptimizer.h"
+#include "Common/ObjReader.h"
+#include <cstring>
+
+namespace
+{
+	// Encodes one stream, then decodes it ten times.  isIndices picks EncodeIndices over
+	// EncodeVertices; elementSize is the index size or the vertex stride.
+	BenchmarkSample TimeStream(const char* stream, const std::vector<std::uint8_t>& raw, size_t elementSize, bool isIndices)
+	{
+		const size_t repeat = 10;
+		size_t count = raw.size() / elementSize;
+		BenchmarkSample sample;
+		sample.Name = stream;
+		sample.Parameter = (double)elementSize;
+		sample.Items = (double)raw.size();
+
+		std::vector<std::uint8_t> encoded;
+		double encodeMilliseconds = AverageMilliseconds(1, [&]() {
+			if (isIndices)
+				MeshCodec::EncodeIndices(raw.data(), count, elementSize, encoded);
+			else
+				MeshCodec::EncodeVertices(raw.data(), count, elementSize, encoded);
+		});
+		std::vector<std::uint8_t> lz;
+		MeshCodec::LzCompress(raw.data(), raw.size(), lz);
+
+		std::vector<std::uint8_t> decoded(raw.size());
+		bool status = true;
+		sample.Milliseconds = AverageMilliseconds(repeat, [&]() {
+			status &= isIndices ? MeshCodec::DecodeIndices(encoded.data(), encoded.size(), decoded.data()) :
+				MeshCodec::DecodeVertices(encoded.data(), encoded.size(), decoded.data());
+		});
+		bool roundTrip = status && std::memcmp(decoded.data(), raw.data(), raw.size()) == 0;
+		sample.Detail = FormatDetail("ratio %.2f (LZ alone %.2f), encode %.1f ms, %s", (double)raw.size() / encoded.size(),
+			(double)raw.size() / lz.size(), encodeMilliseconds, roundTrip ? "round trip ok" : "ROUND TRIP FAILED");
+		return sample;
+	}
+
+	// The vertices and each index width of every part of file, one stream each as a
+	// compressing MboWriter stores them.  LOD indices are left out.
+	void TimeFile(const MboFile& file, std::vector<BenchmarkSample>& samples)
+	{
+		std::vector<std::uint8_t> vertices;
+		std::vector<std::uint8_t> indices16;
+		std::vector<std::uint8_t> indices32;
+		auto append = [](std::vector<std::uint8_t>& out, const auto& span) {
+			const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(span.Data);
+			out.insert(out.end(), bytes, bytes + span.size() * sizeof(*span.Data));
+		};
+		for (UINT i = 0; i < file.PartCount(); ++i)
+		{
+			if (file.IsQuantized())
+				append(vertices, file.QuantizedVertices(i));
+			else
+				append(vertices, file.Vertices(i));
+			append(indices16, file.Indices16(i));
+			append(indices32, file.Indices32(i));
+		}
+
+		size_t stride = file.IsQuantized() ? sizeof(VertexPosNormalTexQuantized) : sizeof(VertexPosNormalTex);
+		samples.push_back(TimeStream(file.IsQuantized() ? "QuantizedVertices" : "Vertices", vertices, stride, false));
+		if (!indices16.empty())
+			samples.push_back(TimeStream("Indices16", indices16, 2, true));
+		if (!indices32.empty())
+			samples.push_back(TimeStream("Indices32", indices32, 4, true));
+	}
+}
+
+// The streams of the benchmark OBJ written as MBO, with float and with quantized vertices,
+// after the vertex cache and fetch steps that order real assets.
+bool BenchmarkMeshCodec()
+{
+	ObjReader reader;
+	if (!MakeBenchmarkObj() || !reader.ReadObj(BenchmarkObjFileName, 0))
+		return false;
+
+	std::vector<BenchmarkSample> samples;
+	for (bool quantize : { false, true })
+	{
+		const wchar_t* mboFileName = L"Benchmark.mbo";
+		MboFile file;
+		if (!reader.WriteMbo(mboFileName, false, quantize, MeshCookVertexCache | MeshCookVertexFetch) ||
+			!file.Open(mboFileName))
+			return false;
+		TimeFile(file, samples);
+	}
+	PrintSamples("Mesh codec decode", "size", "bytes", samples);
+	return true;
+}
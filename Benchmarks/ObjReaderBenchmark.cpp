@@ -0,0 +1,209 @@
+#include "Benchmark.h"
+#include "Common/MappedFile.h"
+#include "Common/ObjReader.h"
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+using namespace DirectX;
+
+const wchar_t* const BenchmarkObjFileName = L"Benchmark.obj";
+
+bool WriteBenchmarkObj(const wchar_t* objFileName, unsigned gridSize)
+{
+	if (gridSize < 2)
+		return false;
+
+	const UINT partCount = 8;
+	const float step = 1.0f / (gridSize - 1);
+	auto height = [](float x, float z) { return 0.1f * sinf(12.0f * x) * cosf(9.0f * z); };
+
+	std::string text;
+	char line[128];
+	text.reserve((size_t)gridSize * gridSize * 180);
+	for (UINT row = 0; row < gridSize; ++row)
+	{
+		for (UINT col = 0; col < gridSize; ++col)
+		{
+			float x = col * step, z = row * step;
+			text.append(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x - 0.5f, height(x, z), 0.5f - z));
+		}
+	}
+	for (UINT row = 0; row < gridSize; ++row)
+	{
+		for (UINT col = 0; col < gridSize; ++col)
+			text.append(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n", col * step, row * step));
+	}
+	for (UINT row = 0; row < gridSize; ++row)
+	{
+		for (UINT col = 0; col < gridSize; ++col)
+		{
+			float x = col * step, z = row * step;
+			XMVECTOR normal = XMVector3Normalize(XMVectorSet(height(x - step, z) - height(x + step, z), 2.0f * step,
+				height(x, z + step) - height(x, z - step), 0.0f));
+			XMFLOAT3 n;
+			XMStoreFloat3(&n, normal);
+			text.append(line, snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", n.x, n.y, n.z));
+		}
+	}
+	for (UINT row = 0; row + 1 < gridSize; ++row)
+	{
+		if (row % ((gridSize - 1 + partCount - 1) / partCount) == 0)
+			text.append(line, snprintf(line, sizeof(line), "o part%u\n", row));
+		for (UINT col = 0; col + 1 < gridSize; ++col)
+		{
+			UINT i = row * gridSize + col + 1;
+			UINT j = i + gridSize;
+			text.append(line, snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i, i, i, j, j, j, i + 1, i + 1, i + 1));
+			text.append(line, snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i + 1, i + 1, i + 1, j, j, j, j + 1, j + 1, j + 1));
+		}
+	}
+
+	std::ofstream fout(objFileName, std::ios::out | std::ios::binary);
+	if (!fout.is_open())
+		return false;
+	fout.write(text.data(), text.size());
+	return fout.good();
+}
+
+bool MakeBenchmarkObj()
+{
+	MappedFile file;
+	return file.Open(BenchmarkObjFileName) || WriteBenchmarkObj(BenchmarkObjFileName, BenchmarkGridSize);
+}
+
+// ReadObjStream against ReadObj on one thread and on every hardware thread, three reads
+// each.  The vertex and index counts show that the parsers agree.
+bool BenchmarkObjRead()
+{
+	const size_t repeat = 3;
+	MappedFile file;
+	if (!WriteBenchmarkObj(BenchmarkObjFileName, BenchmarkGridSize) || !file.Open(BenchmarkObjFileName))
+		return false;
+	double bytes = (double)file.Size();
+	file.Close();
+
+	std::vector<BenchmarkSample> samples;
+	auto run = [&](const char* parser, UINT threads, const auto& read) {
+		BenchmarkSample sample;
+		sample.Name = parser;
+		sample.Parameter = threads;
+		sample.Items = bytes;
+		bool status = true;
+		size_t vertices = 0, indices = 0;
+		sample.Milliseconds = AverageMilliseconds(repeat, [&]() {
+			ObjReader reader;
+			status &= read(reader);
+			vertices = indices = 0;
+			for (auto& part : reader.objParts)
+			{
+				vertices += part.vertices.size();
+				indices += part.indices16.size() + part.indices32.size();
+			}
+		});
+		sample.Detail = FormatDetail("%zu vertices, %zu indices", vertices, indices);
+		samples.push_back(sample);
+		return status;
+	};
+
+	bool status = run("ReadObjStream", 1, [](ObjReader& reader) { return reader.ReadObjStream(BenchmarkObjFileName); });
+	UINT hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (UINT threads = 1; status; threads = hardwareThreads)
+	{
+		status = run("ReadObj", threads, [threads](ObjReader& reader) { return reader.ReadObj(BenchmarkObjFileName, threads); });
+		if (threads == hardwareThreads)
+			break;
+	}
+	PrintSamples("OBJ parsers", "threads", "bytes", samples);
+	return status;
+}
+
+// Deduplicates the face corners of the benchmark OBJ grid, as one part, the way AddVertex
+// does, with the wstring keyed std::unordered_map that ReadObj used to have, with
+// std::unordered_map on VertexKey and with the FlatHashMap of ObjReader's vertex cache,
+// unreserved and reserved for the vertex count as ReadObj does, three passes each.
+bool BenchmarkVertexCache()
+{
+	using VertexKey = ObjReader::VertexKey;
+	using VertexKeyHash = ObjReader::VertexKeyHash;
+	const size_t repeat = 3;
+	const UINT gridSize = BenchmarkGridSize;
+
+	// The corners of the WriteBenchmarkObj faces, in file order.
+	std::vector<VertexKey> corners;
+	corners.reserve((size_t)(gridSize - 1) * (gridSize - 1) * 6);
+	for (UINT row = 0; row + 1 < gridSize; ++row)
+	{
+		for (UINT col = 0; col + 1 < gridSize; ++col)
+		{
+			DWORD i = row * gridSize + col + 1;
+			DWORD j = i + gridSize;
+			for (DWORD v : { i, j, i + 1, i + 1, j, j + 1 })
+				corners.push_back({ v, v, v, 0 });
+		}
+	}
+	size_t vertexCount = (size_t)gridSize * gridSize;
+
+	// dedup fills indices with one vertex number per corner and returns the vertex count.
+	std::vector<BenchmarkSample> samples;
+	auto run = [&](const char* cache, bool reserved, const std::function<size_t(std::vector<DWORD>&)>& dedup) {
+		BenchmarkSample sample;
+		sample.Name = cache;
+		sample.Parameter = reserved;
+		sample.Items = (double)corners.size();
+		std::vector<DWORD> indices;
+		size_t vertices = 0;
+		sample.Milliseconds = AverageMilliseconds(repeat, [&]() {
+			indices.clear();
+			vertices = dedup(indices);
+		});
+		sample.Detail = FormatDetail("%zu vertices", vertices);
+		samples.push_back(sample);
+	};
+
+	run("std::unordered_map<std::wstring>", false, [&](std::vector<DWORD>& indices) {
+		std::unordered_map<std::wstring, DWORD> cache;
+		for (const VertexKey& key : corners)
+		{
+			std::wstring idxStr = std::to_wstring(key.vpi) + L"/" + std::to_wstring(key.vti) + L"/" + std::to_wstring(key.vni);
+			auto it = cache.find(idxStr);
+			if (it != cache.end())
+			{
+				indices.push_back(it->second);
+			}
+			else
+			{
+				DWORD pos = (DWORD)cache.size();
+				cache[idxStr] = pos;
+				indices.push_back(pos);
+			}
+		}
+		return cache.size();
+	});
+	for (bool reserved : { false, true })
+	{
+		run("std::unordered_map<VertexKey>", reserved, [&](std::vector<DWORD>& indices) {
+			std::unordered_map<VertexKey, DWORD, VertexKeyHash> cache;
+			if (reserved)
+				cache.reserve(vertexCount);
+			for (const VertexKey& key : corners)
+				indices.push_back(cache.emplace(key, (DWORD)cache.size()).first->second);
+			return cache.size();
+		});
+	}
+	for (bool reserved : { false, true })
+	{
+		run("FlatHashMap<VertexKey>", reserved, [&](std::vector<DWORD>& indices) {
+			FlatHashMap<VertexKey, DWORD, VertexKeyHash> cache;
+			if (reserved)
+				cache.Reserve(vertexCount);
+			for (const VertexKey& key : corners)
+				indices.push_back(*cache.Insert(key, (DWORD)cache.Size()).first);
+			return cache.Size();
+		});
+	}
+	PrintSamples("OBJ vertex caches", "reserved", "corners", samples);
+	return true;
+}
@@ -0,0 +1,161 @@
+#include "Benchmark.h"
+#include "Common/VertexQuantization.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Largest round trip errors over a set of vertices, and whether each stayed within the
+	// bound VertexQuantization promises.
+	struct QuantizationErrorStatistics
+	{
+		// In 16-bit steps of the bounds, Scale / 65535, on the worst axis.
+		float MaxPositionSteps = 0.0f;
+		float MaxNormalRadians = 0.0f;
+		// Relative to the texcoord, or absolute below the smallest normal half.
+		float MaxTexCoordError = 0.0f;
+		bool PositionInBound = true;
+		bool NormalInBound = true;
+		bool TexCoordInBound = true;
+
+		bool InBound()const { return PositionInBound && NormalInBound && TexCoordInBound; }
+	};
+
+	// Compares vertices with their round trip through VertexQuantization against bounds.
+	// Normals must be unit length.
+	QuantizationErrorStatistics MeasureError(const std::vector<VertexPosNormalTex>& vertices,
+		const std::vector<VertexPosNormalTex>& decoded, const QuantizationBounds& bounds)
+	{
+		QuantizationErrorStatistics stats;
+		const float* offset = &bounds.Offset.x;
+		const float* scale = &bounds.Scale.x;
+		// Offset + pos * Scale rounds once in the multiply and once in the add.
+		float rounding[3];
+		for (int k = 0; k < 3; ++k)
+			rounding[k] = 2.0f * FLT_EPSILON * (std::fabs(offset[k]) + std::fabs(scale[k]));
+
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			const float* pos = &vertices[i].pos.x;
+			const float* dec = &decoded[i].pos.x;
+			for (int k = 0; k < 3; ++k)
+			{
+				float error = std::fabs(dec[k] - pos[k]);
+				float step = scale[k] / 65535.0f;
+				if (step > 0.0f)
+					stats.MaxPositionSteps = std::max(stats.MaxPositionSteps, error / step);
+				if (error > 0.5f * step + rounding[k])
+					stats.PositionInBound = false;
+			}
+
+			// atan2 of |a x b| and a . b keeps its precision at small angles, unlike acos.
+			XMVECTOR a = XMLoadFloat3(&vertices[i].normal);
+			XMVECTOR b = XMLoadFloat3(&decoded[i].normal);
+			float angle = std::atan2(XMVectorGetX(XMVector3Length(XMVector3Cross(a, b))), XMVectorGetX(XMVector3Dot(a, b)));
+			stats.MaxNormalRadians = std::max(stats.MaxNormalRadians, angle);
+
+			const float* tex = &vertices[i].tex.x;
+			const float* texDec = &decoded[i].tex.x;
+			for (int k = 0; k < 2; ++k)
+			{
+				// Below 2^-14 halves are subnormal with a fixed step of 2^-24.
+				float error = std::fabs(texDec[k] - tex[k]) / std::max(std::fabs(tex[k]), 1.0f / 16384.0f);
+				stats.MaxTexCoordError = std::max(stats.MaxTexCoordError, error);
+			}
+		}
+		stats.NormalInBound = stats.MaxNormalRadians <= VertexQuantization::MaxNormalRadians;
+		stats.TexCoordInBound = stats.MaxTexCoordError <= 1.0f / 2048.0f;
+		return stats;
+	}
+
+	// count random vertices from seed inside a randomly placed box, led by the axis and
+	// diagonal normals, the poles of the octahedral fold and texcoords down to subnormal
+	// halves.
+	std::vector<VertexPosNormalTex> RandomVertices(size_t count, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::normal_distribution<float> gauss;
+
+		XMFLOAT3 lo(unit(rng) * 1000.0f, unit(rng) * 1000.0f, unit(rng) * 1000.0f);
+		XMFLOAT3 size(std::exp2(unit(rng) * 8.0f), std::exp2(unit(rng) * 8.0f), std::exp2(unit(rng) * 8.0f));
+
+		std::vector<XMFLOAT3> normals;
+		for (int x = -1; x <= 1; ++x)
+		{
+			for (int y = -1; y <= 1; ++y)
+			{
+				for (int z = -1; z <= 1; ++z)
+				{
+					if (x || y || z)
+					{
+						XMFLOAT3 n;
+						XMStoreFloat3(&n, XMVector3Normalize(XMVectorSet((float)x, (float)y, (float)z, 0.0f)));
+						normals.push_back(n);
+					}
+				}
+			}
+		}
+		// Just either side of the fold at z = 0.
+		normals.push_back(XMFLOAT3(0.6f, 0.8f, 1e-7f));
+		normals.push_back(XMFLOAT3(0.6f, 0.8f, -1e-7f));
+		const float texCoords[] = { 0.0f, 1.0f, -1.0f, 0.5f, 1e-5f, -3e-6f, 6e-8f, 65504.0f };
+
+		std::vector<VertexPosNormalTex> vertices(std::max(count, normals.size()));
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			VertexPosNormalTex& v = vertices[i];
+			v.pos = XMFLOAT3(lo.x + size.x * (0.5f + 0.5f * unit(rng)), lo.y + size.y * (0.5f + 0.5f * unit(rng)),
+				lo.z + size.z * (0.5f + 0.5f * unit(rng)));
+			if (i < normals.size())
+				v.normal = normals[i];
+			else
+				XMStoreFloat3(&v.normal, XMVector3Normalize(XMVectorSet(gauss(rng), gauss(rng), gauss(rng), 0.0f)));
+			if (i < _countof(texCoords))
+				v.tex = XMFLOAT2(texCoords[i], -texCoords[i]);
+			else
+				v.tex = XMFLOAT2(unit(rng) * 4.0f, unit(rng) * 4.0f);
+		}
+		return vertices;
+	}
+}
+
+// Checks the error bounds in VertexQuantization.h on the vertices of three seeds and
+// times their encode and decode.  Fails if any error is out of bound.
+bool CheckVertexQuantization()
+{
+	const size_t count = 200000;
+	const size_t repeat = 10;
+	bool inBound = true;
+	std::vector<BenchmarkSample> samples;
+	for (unsigned seed = 1; seed <= 3; ++seed)
+	{
+		std::vector<VertexPosNormalTex> vertices = RandomVertices(count, seed);
+		std::vector<VertexPosNormalTexQuantized> quantized(vertices.size());
+		std::vector<VertexPosNormalTex> decoded(vertices.size());
+		QuantizationBounds bounds = VertexQuantization::ComputeBounds(vertices.data(), vertices.size());
+
+		BenchmarkSample sample;
+		sample.Name = "Encode + Decode";
+		sample.Parameter = seed;
+		sample.Items = (double)vertices.size();
+		sample.Milliseconds = AverageMilliseconds(repeat, [&]() {
+			VertexQuantization::Encode(vertices.data(), vertices.size(), bounds, quantized.data());
+			VertexQuantization::Decode(quantized.data(), quantized.size(), bounds, decoded.data());
+		});
+
+		QuantizationErrorStatistics stats = MeasureError(vertices, decoded, bounds);
+		inBound &= stats.InBound();
+		sample.Detail = FormatDetail("position %.3f steps%s, normal %.2e rad%s, texcoord %.2e%s",
+			stats.MaxPositionSteps, stats.PositionInBound ? "" : " OUT OF BOUND",
+			stats.MaxNormalRadians, stats.NormalInBound ? "" : " OUT OF BOUND",
+			stats.MaxTexCoordError, stats.TexCoordInBound ? "" : " OUT OF BOUND");
+		samples.push_back(sample);
+	}
+	PrintSamples("Vertex quantization", "seed", "vertices", samples);
+	return inBound;
+}
@@ -0,0 +1,90 @@
+#include "Benchmark.h"
+#include "Common/Meshlet.h"
+#include "Common/Terrain.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Rolling hills with a ridge of finer detail, spacing 1, heights in [-40, 40].
+	std::vector<float> MakeHeightmap(std::uint32_t size)
+	{
+		std::vector<float> heights((size_t)size * size);
+		for (std::uint32_t row = 0; row < size; ++row)
+		{
+			for (std::uint32_t col = 0; col < size; ++col)
+			{
+				float x = (float)col, z = (float)row;
+				heights[(size_t)row * size + col] = 30.0f * std::sin(0.011f * x) * std::cos(0.007f * z) +
+					10.0f * std::sin(0.05f * (x + z));
+			}
+		}
+		return heights;
+	}
+}
+
+// Flies the eye diagonally over a 2049 x 2049 heightmap, 50 units above its highest
+// point and looking ahead and down, and runs Terrain::Select with the frustum of that
+// camera at 16 points from the near corner towards the far one, 100 selects each.  The
+// flight spans the bounds of the root nodes.
+bool BenchmarkTerrain()
+{
+	const size_t repeat = 100, steps = 16;
+	const std::uint32_t size = 2049;
+	const float height = 50.0f, fovY = 0.25f * XM_PI, aspectRatio = 16.0f / 9.0f;
+
+	std::vector<float> heights = MakeHeightmap(size);
+	Terrain terrain;
+	terrain.Build(heights.data(), size, size, 1.0f);
+	if (terrain.Roots().empty())
+		return false;
+
+	XMFLOAT3 low = { FLT_MAX, FLT_MAX, FLT_MAX }, high = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (std::uint32_t root : terrain.Roots())
+	{
+		const BoundingBox& bounds = terrain.Nodes()[root].Bounds;
+		low.x = std::min(low.x, bounds.Center.x - bounds.Extents.x);
+		low.z = std::min(low.z, bounds.Center.z - bounds.Extents.z);
+		high.x = std::max(high.x, bounds.Center.x + bounds.Extents.x);
+		high.y = std::max(high.y, bounds.Center.y + bounds.Extents.y);
+		high.z = std::max(high.z, bounds.Center.z + bounds.Extents.z);
+	}
+	XMVECTOR start = XMVectorSet(low.x, high.y + height, high.z, 1.0f);
+	XMVECTOR end = XMVectorSet(high.x, high.y + height, low.z, 1.0f);
+	XMVECTOR ahead = XMVector3Normalize(XMVectorSubtract(end, start));
+	XMVECTOR look = XMVector3Normalize(XMVectorAdd(ahead, XMVectorSet(0.0f, -0.3f, 0.0f, 0.0f)));
+	float farZ = 2.0f * ((high.x - low.x) + (high.z - low.z)) + height;
+
+	// A 1080 pixel high viewport.
+	LodView view;
+	view.PixelsPerUnit = 1080.0f / (2.0f * std::tan(0.5f * fovY));
+	view.NearZ = 1.0f;
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(fovY, aspectRatio, view.NearZ, farZ);
+
+	std::vector<TerrainChunk> chunks;
+	std::vector<BenchmarkSample> samples;
+	for (size_t s = 0; s < steps; ++s)
+	{
+		float t = (float)s / steps;
+		XMVECTOR eyePos = XMVectorLerp(start, end, t);
+		XMStoreFloat3(&view.EyePos, eyePos);
+		XMFLOAT4 planes[6];
+		MeshletCuller::ExtractFrustumPlanes(XMMatrixMultiply(XMMatrixLookAtLH(eyePos, XMVectorAdd(eyePos, look),
+			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)), proj), planes);
+
+		BenchmarkSample sample;
+		sample.Name = "Select";
+		sample.Parameter = t;
+		TerrainSelectStatistics stats;
+		sample.Milliseconds = AverageMilliseconds(repeat, [&]() { stats = terrain.Select(view, planes, chunks); });
+		sample.Items = (double)stats.NodesVisited;
+		sample.Detail = FormatDetail("%zu chunks, %zu culled, %zu of %zu triangles", stats.Chunks, stats.NodesCulled,
+			stats.Triangles, stats.FullTriangles);
+		samples.push_back(sample);
+	}
+	PrintSamples("Terrain selection", "position", "nodes", samples);
+	return true;
+}
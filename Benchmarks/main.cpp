@@ -0,0 +1,60 @@
+// Headless benchmarks of the mesh pipeline in ManipulaEngine/Common.  Pass the names of
+// the benchmarks to run, or nothing to run them all.  Build Release: the numbers of a
+// Debug build say little.
+//
+#include "Benchmark.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	struct Suite
+	{
+		const char* Name;
+		bool (*Run)();
+	};
+
+	const Suite Suites[] =
+	{
+		{ "obj", BenchmarkObjRead },
+		{ "vertexcache", BenchmarkVertexCache },
+		{ "codec", BenchmarkMeshCodec },
+		{ "quantization", CheckVertexQuantization },
+		{ "lod", BenchmarkLodSelect },
+		{ "geosphere", BenchmarkGeosphere },
+		{ "rings", BenchmarkRings },
+		{ "grid", BenchmarkGrid },
+		{ "terrain", BenchmarkTerrain },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	int failed = 0;
+	for (const Suite& suite : Suites)
+	{
+		bool selected = argc < 2;
+		for (int i = 1; i < argc && !selected; ++i)
+			selected = strcmp(argv[i], suite.Name) == 0;
+		if (selected && !suite.Run())
+		{
+			printf("%s: failed\n", suite.Name);
+			++failed;
+		}
+	}
+	for (int i = 1; i < argc; ++i)
+	{
+		bool known = false;
+		for (const Suite& suite : Suites)
+			known |= strcmp(argv[i], suite.Name) == 0;
+		if (!known)
+		{
+			printf("unknown benchmark %s, expected one of:", argv[i]);
+			for (const Suite& suite : Suites)
+				printf(" %s", suite.Name);
+			printf("\n");
+			++failed;
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,511 @@
+#include "ClusterDag.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "PositionWeld.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+using namespace DirectX;
+
+namespace
+{
+	const std::uint32_t None = ~0u;
+
+	const XMFLOAT3& Position(const XMFLOAT3* positions, size_t stride, std::uint32_t v)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const std::uint8_t*>(positions) + v * stride);
+	}
+
+	// Smallest sphere around the spheres a and b.
+	XMFLOAT4 MergeSpheres(const XMFLOAT4& a, const XMFLOAT4& b)
+	{
+		float dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+		if (distance + b.w <= a.w)
+			return a;
+		if (distance + a.w <= b.w)
+			return b;
+		float radius = 0.5f * (distance + a.w + b.w);
+		float t = (radius - a.w) / distance;
+		return XMFLOAT4(a.x + dx * t, a.y + dy * t, a.z + dz * t, radius);
+	}
+
+	// Spreads the low 10 bits of v to every third bit.
+	std::uint32_t SpreadBits(std::uint32_t v)
+	{
+		v &= 0x3FF;
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	class Builder
+	{
+	public:
+		Builder(const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride, const float* attributes,
+			size_t attributeCount, ClusterDag& dag)
+			: mPositions(positions), mVertexCount(vertexCount), mStride(vertexStride), mAttributes(attributes),
+			mAttributeCount(attributes ? attributeCount : 0), mDag(dag)
+		{
+		}
+
+		void Run(std::vector<std::uint32_t>& indices, size_t groupSize)
+		{
+			WeldPositions();
+
+			MeshOptimizer::OptimizeVertexCache(indices.data(), indices.size(), mVertexCount);
+			MeshletData meshlets;
+			MeshletBuilder::Build(mPositions, mVertexCount, mStride, indices.data(), indices.size(), meshlets,
+				ClusterDagBuilder::ClusterVertices, ClusterDagBuilder::ClusterTriangles);
+			std::vector<std::uint32_t> level;
+			AddClusters(meshlets, nullptr, ClusterDag::NoGroup, level);
+			for (const XMFLOAT4& sphere : meshlets.Spheres)
+			{
+				mBounds.push_back(sphere);
+				mErrors.push_back(0.0f);
+			}
+
+			// Near the top few clusters are left and most of their edges are locked, so when a
+			// level barely shrinks the next one is grouped twice as coarsely.
+			mLocal.assign(mVertexCount, None);
+			size_t groupTriangles = groupSize * ClusterDagBuilder::ClusterTriangles;
+			for (size_t depth = 0; depth < ClusterDagBuilder::MaxLevels && level.size() > 1; ++depth)
+			{
+				std::vector<std::vector<std::uint32_t>> groups = Partition(level, groupTriangles);
+				std::vector<std::uint32_t> next;
+				size_t before = 0, after = 0;
+				for (const std::vector<std::uint32_t>& group : groups)
+				{
+					if (!SimplifyGroup(group, next))
+						next.insert(next.end(), group.begin(), group.end());
+				}
+				for (std::uint32_t c : level)
+					before += mDag.Clusters[c].IndexCount;
+				for (std::uint32_t c : next)
+					after += mDag.Clusters[c].IndexCount;
+				if (after == before && groups.size() == 1)
+					break;
+				if (after * 4 > before * 3)
+					groupTriangles *= 2;
+				level.swap(next);
+			}
+		}
+
+	private:
+		// Numbers each position after the first vertex found there, so clusters that only
+		// meet across a normal or UV seam still count as neighbours.
+		void WeldPositions()
+		{
+			mWeld.resize(mVertexCount);
+			::WeldPositions(mPositions, mVertexCount, mStride, mWeld.data());
+		}
+
+		// One cluster per meshlet; vertices maps meshlet vertex numbers to mesh vertices,
+		// or is null when they already are.
+		void AddClusters(const MeshletData& meshlets, const std::uint32_t* vertices, std::uint32_t group,
+			std::vector<std::uint32_t>& level)
+		{
+			for (const Meshlet& meshlet : meshlets.Meshlets)
+			{
+				ClusterDagCluster cluster;
+				cluster.FirstIndex = (std::uint32_t)mDag.Indices.size();
+				cluster.IndexCount = meshlet.TriangleCount * 3;
+				cluster.Group = group;
+				cluster.ParentGroup = ClusterDag::NoGroup;
+				for (std::uint32_t t = 0; t < meshlet.TriangleCount; ++t)
+				{
+					std::uint32_t packed = meshlets.Triangles[meshlet.TriangleOffset + t];
+					for (int k = 0; k < 3; ++k)
+					{
+						std::uint32_t v = meshlets.Vertices[meshlet.VertexOffset + ((packed >> (8 * k)) & 0xFF)];
+						mDag.Indices.push_back(vertices ? vertices[v] : v);
+					}
+				}
+				level.push_back((std::uint32_t)mDag.Clusters.size());
+				mDag.Clusters.push_back(cluster);
+			}
+		}
+
+		// Splits the level into groups of about groupTriangles triangles, so clusters left
+		// small by earlier splits just make groups of more clusters.  Seeds are taken in
+		// Morton order of the cluster bounds and grow by the neighbour sharing the most
+		// edges with the group, which keeps the outer edges, and so the locked vertices, few.
+		std::vector<std::vector<std::uint32_t>> Partition(const std::vector<std::uint32_t>& level, size_t groupTriangles)
+		{
+			size_t count = level.size();
+
+			// One entry per edge seen in two clusters, as the pair of level positions.
+			FlatHashMap<std::uint64_t, std::uint32_t, EdgeHash> owners;
+			std::vector<std::uint64_t> pairs;
+			size_t indexCount = 0;
+			for (std::uint32_t c : level)
+				indexCount += mDag.Clusters[c].IndexCount;
+			owners.Reserve(indexCount);
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				const ClusterDagCluster& cluster = mDag.Clusters[level[i]];
+				const std::uint32_t* indices = mDag.Indices.data() + cluster.FirstIndex;
+				for (std::uint32_t t = 0; t < cluster.IndexCount; t += 3)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						std::uint32_t a = mWeld[indices[t + k]];
+						std::uint32_t b = mWeld[indices[t + (k + 1) % 3]];
+						if (a == b)
+							continue;
+						auto owner = owners.Insert(EdgeKey(a, b), i);
+						if (!owner.second && *owner.first != i)
+							pairs.push_back(EdgeKey(*owner.first, i));
+					}
+				}
+			}
+
+			// Adjacency lists weighted by the number of shared edges.
+			std::sort(pairs.begin(), pairs.end());
+			std::vector<std::uint32_t> linkStart(count + 1, 0);
+			for (size_t p = 0; p < pairs.size(); ++p)
+			{
+				if (p > 0 && pairs[p] == pairs[p - 1])
+					continue;
+				++linkStart[(pairs[p] >> 32) + 1];
+				++linkStart[(std::uint32_t)pairs[p] + 1];
+			}
+			for (size_t i = 0; i < count; ++i)
+				linkStart[i + 1] += linkStart[i];
+			std::vector<std::uint32_t> neighbours(linkStart[count]), weights(linkStart[count]);
+			std::vector<std::uint32_t> fill(linkStart.begin(), linkStart.end() - 1);
+			for (size_t p = 0; p < pairs.size();)
+			{
+				size_t end = p;
+				while (end < pairs.size() && pairs[end] == pairs[p])
+					++end;
+				std::uint32_t a = (std::uint32_t)(pairs[p] >> 32), b = (std::uint32_t)pairs[p];
+				neighbours[fill[a]] = b;
+				weights[fill[a]++] = (std::uint32_t)(end - p);
+				neighbours[fill[b]] = a;
+				weights[fill[b]++] = (std::uint32_t)(end - p);
+				p = end;
+			}
+
+			// Seeds in Morton order of the bounds centers.
+			XMFLOAT3 lo(FLT_MAX, FLT_MAX, FLT_MAX), hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (std::uint32_t c : level)
+			{
+				const XMFLOAT4& b = mBounds[c];
+				lo = XMFLOAT3(std::min(lo.x, b.x), std::min(lo.y, b.y), std::min(lo.z, b.z));
+				hi = XMFLOAT3(std::max(hi.x, b.x), std::max(hi.y, b.y), std::max(hi.z, b.z));
+			}
+			float extent = std::max(std::max(hi.x - lo.x, hi.y - lo.y), hi.z - lo.z);
+			float scale = extent > 0.0f ? 1023.0f / extent : 0.0f;
+			std::vector<std::pair<std::uint32_t, std::uint32_t>> order(count);
+			for (std::uint32_t i = 0; i < count; ++i)
+			{
+				const XMFLOAT4& b = mBounds[level[i]];
+				std::uint32_t code = SpreadBits((std::uint32_t)((b.x - lo.x) * scale)) |
+					SpreadBits((std::uint32_t)((b.y - lo.y) * scale)) << 1 |
+					SpreadBits((std::uint32_t)((b.z - lo.z) * scale)) << 2;
+				order[i] = { code, i };
+			}
+			std::sort(order.begin(), order.end());
+
+			std::vector<std::vector<std::uint32_t>> groups;
+			std::vector<size_t> groupTriangleCounts;
+			std::vector<std::uint32_t> groupOf(count, None);
+			std::vector<std::uint8_t> grouped(count, 0);
+			std::vector<std::uint32_t> score(count, 0);
+			std::vector<std::uint32_t> touched;
+			for (const auto& seed : order)
+			{
+				if (grouped[seed.second])
+					continue;
+				std::vector<std::uint32_t> group(1, seed.second);
+				grouped[seed.second] = 1;
+				size_t triangles = mDag.Clusters[level[seed.second]].IndexCount / 3;
+				while (triangles < groupTriangles)
+				{
+					std::uint32_t best = None;
+					for (std::uint32_t member : group)
+					{
+						for (std::uint32_t l = linkStart[member]; l < linkStart[member + 1]; ++l)
+						{
+							std::uint32_t n = neighbours[l];
+							if (grouped[n])
+								continue;
+							if (score[n] == 0)
+								touched.push_back(n);
+							score[n] += weights[l];
+							if (best == None || score[n] > score[best] || (score[n] == score[best] && n < best))
+								best = n;
+						}
+					}
+					for (std::uint32_t n : touched)
+						score[n] = 0;
+					touched.clear();
+					if (best == None)
+						break;
+					group.push_back(best);
+					grouped[best] = 1;
+					triangles += mDag.Clusters[level[best]].IndexCount / 3;
+				}
+				for (std::uint32_t member : group)
+					groupOf[member] = (std::uint32_t)groups.size();
+				groups.push_back(std::move(group));
+				groupTriangleCounts.push_back(triangles);
+			}
+
+			// Growth stops at the target, which strands scraps between full groups; each
+			// scrap joins the neighbouring group it shares the most edges with.
+			std::vector<std::uint32_t> shared(groups.size(), 0);
+			for (size_t g = 0; g < groups.size(); ++g)
+			{
+				if (groups[g].empty() || groupTriangleCounts[g] * 2 >= groupTriangles)
+					continue;
+				std::uint32_t best = None;
+				for (std::uint32_t member : groups[g])
+				{
+					for (std::uint32_t l = linkStart[member]; l < linkStart[member + 1]; ++l)
+					{
+						std::uint32_t other = groupOf[neighbours[l]];
+						if (other == g)
+							continue;
+						if (shared[other] == 0)
+							touched.push_back(other);
+						shared[other] += weights[l];
+						if (best == None || shared[other] > shared[best] || (shared[other] == shared[best] && other < best))
+							best = other;
+					}
+				}
+				for (std::uint32_t other : touched)
+					shared[other] = 0;
+				touched.clear();
+				if (best == None)
+					continue;
+				for (std::uint32_t member : groups[g])
+					groupOf[member] = best;
+				groups[best].insert(groups[best].end(), groups[g].begin(), groups[g].end());
+				groupTriangleCounts[best] += groupTriangleCounts[g];
+				groups[g].clear();
+			}
+
+			groups.erase(std::remove_if(groups.begin(), groups.end(),
+				[](const std::vector<std::uint32_t>& group) { return group.empty(); }), groups.end());
+			for (std::vector<std::uint32_t>& group : groups)
+			{
+				for (std::uint32_t& member : group)
+					member = level[member];
+			}
+			return groups;
+		}
+
+		// Simplifies the clusters of group into new clusters appended to next.  Fails, and
+		// leaves the DAG as it was, when the result keeps more than 85% of the triangles.
+		bool SimplifyGroup(const std::vector<std::uint32_t>& group, std::vector<std::uint32_t>& next)
+		{
+			// The group's vertices renumbered from 0, with their positions and attributes.
+			size_t localStride = 3 + mAttributeCount;
+			std::vector<std::uint32_t> globals;
+			std::vector<std::uint32_t> indices;
+			std::vector<float> local;
+			for (std::uint32_t c : group)
+			{
+				const ClusterDagCluster& cluster = mDag.Clusters[c];
+				for (std::uint32_t i = 0; i < cluster.IndexCount; ++i)
+				{
+					std::uint32_t v = mDag.Indices[cluster.FirstIndex + i];
+					if (mLocal[v] == None)
+					{
+						mLocal[v] = (std::uint32_t)globals.size();
+						globals.push_back(v);
+						const XMFLOAT3& p = Position(mPositions, mStride, v);
+						local.insert(local.end(), { p.x, p.y, p.z });
+						if (mAttributeCount)
+						{
+							const float* attributes = reinterpret_cast<const float*>(
+								reinterpret_cast<const std::uint8_t*>(mAttributes) + v * mStride);
+							local.insert(local.end(), attributes, attributes + mAttributeCount);
+						}
+					}
+					indices.push_back(mLocal[v]);
+				}
+			}
+			for (std::uint32_t v : globals)
+				mLocal[v] = None;
+
+			// Edges the group shares with the rest of the mesh are open in the local copy, so
+			// locking the border keeps them where the neighbours expect them.
+			const XMFLOAT3* localPositions = reinterpret_cast<const XMFLOAT3*>(local.data());
+			std::vector<std::uint32_t> simplified(indices.size());
+			float error = 0.0f;
+			simplified.resize(MeshSimplifier::Simplify(simplified.data(), indices.data(), indices.size(),
+				localPositions, globals.size(), localStride * sizeof(float), indices.size() / 6 * 3, FLT_MAX,
+				MeshSimplifyLockBorder, &error, mAttributeCount ? local.data() + 3 : nullptr, mAttributeCount));
+			if (simplified.empty() || simplified.size() * 20 > indices.size() * 17)
+				return false;
+
+			// The simplifier measures against the children, which are already off the source
+			// by up to their own error, so the two add up; the sum is never below a child's.
+			XMFLOAT4 bounds = mBounds[group[0]];
+			float childError = 0.0f;
+			for (std::uint32_t c : group)
+			{
+				bounds = MergeSpheres(bounds, mBounds[c]);
+				childError = std::max(childError, mErrors[c]);
+			}
+			error += childError;
+
+			std::uint32_t groupIndex = (std::uint32_t)mDag.Groups.size();
+			ClusterDagGroup dagGroup = {};
+			dagGroup.Bounds = bounds;
+			dagGroup.Error = error;
+			dagGroup.FirstChild = (std::uint32_t)mDag.Children.size();
+			dagGroup.ChildCount = (std::uint32_t)group.size();
+			dagGroup.FirstCluster = (std::uint32_t)mDag.Clusters.size();
+			for (std::uint32_t c : group)
+			{
+				mDag.Clusters[c].ParentGroup = groupIndex;
+				mDag.Children.push_back(c);
+			}
+
+			MeshOptimizer::OptimizeVertexCache(simplified.data(), simplified.size(), globals.size());
+			MeshletData meshlets;
+			MeshletBuilder::Build(localPositions, globals.size(), localStride * sizeof(float), simplified.data(),
+				simplified.size(), meshlets, ClusterDagBuilder::ClusterVertices, ClusterDagBuilder::ClusterTriangles);
+			AddClusters(meshlets, globals.data(), groupIndex, next);
+			dagGroup.ClusterCount = (std::uint32_t)meshlets.size();
+			mDag.Groups.push_back(dagGroup);
+			// The new clusters answer to the group's error at the group's bounds, the same
+			// numbers their children are measured against, so the cut is exact.
+			mBounds.resize(mDag.Clusters.size(), bounds);
+			mErrors.resize(mDag.Clusters.size(), error);
+			return true;
+		}
+
+		const XMFLOAT3* mPositions;
+		size_t mVertexCount;
+		size_t mStride;
+		const float* mAttributes;
+		size_t mAttributeCount;
+		ClusterDag& mDag;
+
+		std::vector<std::uint32_t> mWeld;
+		// Local number of each vertex during SimplifyGroup, None otherwise.
+		std::vector<std::uint32_t> mLocal;
+		// Bounds and error each cluster is drawn with, by cluster number.
+		std::vector<XMFLOAT4> mBounds;
+		std::vector<float> mErrors;
+	};
+
+	template<typename Index>
+	void BuildImpl(const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride, const Index* indices,
+		size_t indexCount, ClusterDag& dag, const float* attributes, size_t attributeCount, size_t groupSize)
+	{
+		dag.clear();
+		indexCount -= indexCount % 3;
+		if (vertexCount == 0 || indexCount == 0)
+			return;
+
+		std::vector<std::uint32_t> source(indices, indices + indexCount);
+		Builder builder(positions, vertexCount, vertexStride, attributes, attributeCount, dag);
+		builder.Run(source, std::max<size_t>(groupSize, 2));
+	}
+
+	// Pixels covered by error at the near side of the group's bounds.
+	float ProjectedError(const ClusterDagGroup& group, const LodView& view)
+	{
+		float dx = group.Bounds.x - view.EyePos.x;
+		float dy = group.Bounds.y - view.EyePos.y;
+		float dz = group.Bounds.z - view.EyePos.z;
+		float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - group.Bounds.w;
+		return group.Error * view.PixelsPerUnit / std::max(distance, view.NearZ);
+	}
+}
+
+void ClusterDag::clear()
+{
+	Clusters.clear();
+	Groups.clear();
+	Children.clear();
+	Indices.clear();
+}
+
+void ClusterDagBuilder::Build(const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+	const std::uint16_t* indices, size_t indexCount, ClusterDag& dag, const float* attributes,
+	size_t attributeCount, size_t groupSize)
+{
+	BuildImpl(positions, vertexCount, vertexStride, indices, indexCount, dag, attributes, attributeCount, groupSize);
+}
+
+void ClusterDagBuilder::Build(const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+	const std::uint32_t* indices, size_t indexCount, ClusterDag& dag, const float* attributes,
+	size_t attributeCount, size_t groupSize)
+{
+	BuildImpl(positions, vertexCount, vertexStride, indices, indexCount, dag, attributes, attributeCount, groupSize);
+}
+
+void ClusterDagSelector::Select(const ClusterDag& dag, const LodView& view, float threshold, size_t maxTriangles,
+	ClusterDagCut& cut)
+{
+	cut.Clusters.clear();
+	cut.Triangles = 0;
+	cut.Error = 0.0f;
+
+	// Pending counts the clusters of each group that are not drawn yet; a group may be
+	// refined once it reaches 0.  The roots are drawn to start with.
+	cut.Pending.assign(dag.Groups.size(), 0);
+	cut.Refined.assign(dag.Groups.size(), 0);
+	for (const ClusterDagCluster& cluster : dag.Clusters)
+	{
+		if (cluster.ParentGroup == ClusterDag::NoGroup)
+			cut.Triangles += cluster.IndexCount / 3;
+		else if (cluster.Group != ClusterDag::NoGroup)
+			++cut.Pending[cluster.Group];
+	}
+
+	std::priority_queue<std::pair<float, std::uint32_t>> candidates;
+	for (std::uint32_t g = 0; g < dag.Groups.size(); ++g)
+	{
+		if (cut.Pending[g] == 0)
+			candidates.emplace(ProjectedError(dag.Groups[g], view), g);
+	}
+
+	while (!candidates.empty())
+	{
+		float error = candidates.top().first;
+		std::uint32_t g = candidates.top().second;
+		if (error <= threshold)
+			break;
+
+		const ClusterDagGroup& group = dag.Groups[g];
+		size_t triangles = cut.Triangles;
+		for (std::uint32_t c = group.FirstCluster; c < group.FirstCluster + group.ClusterCount; ++c)
+			triangles -= dag.Clusters[c].IndexCount / 3;
+		for (std::uint32_t i = group.FirstChild; i < group.FirstChild + group.ChildCount; ++i)
+			triangles += dag.Clusters[dag.Children[i]].IndexCount / 3;
+		if (triangles > maxTriangles)
+			break;
+
+		candidates.pop();
+		cut.Triangles = triangles;
+		cut.Refined[g] = 1;
+		for (std::uint32_t i = group.FirstChild; i < group.FirstChild + group.ChildCount; ++i)
+		{
+			std::uint32_t childGroup = dag.Clusters[dag.Children[i]].Group;
+			if (childGroup != ClusterDag::NoGroup && --cut.Pending[childGroup] == 0)
+				candidates.emplace(ProjectedError(dag.Groups[childGroup], view), childGroup);
+		}
+	}
+	if (!candidates.empty())
+		cut.Error = candidates.top().first;
+
+	for (std::uint32_t c = 0; c < dag.Clusters.size(); ++c)
+	{
+		const ClusterDagCluster& cluster = dag.Clusters[c];
+		if ((cluster.ParentGroup == ClusterDag::NoGroup || cut.Refined[cluster.ParentGroup]) &&
+			(cluster.Group == ClusterDag::NoGroup || !cut.Refined[cluster.Group]))
+			cut.Clusters.push_back(c);
+	}
+}
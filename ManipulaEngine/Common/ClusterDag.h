@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// cluster hierarchy (DAG) level of detail for very large meshes
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "LodSelector.h"
+#include <cstdint>
+#include <vector>
+
+// Cluster and group records; the same layouts are stored in MBO.
+struct ClusterDagCluster
+{
+	std::uint32_t FirstIndex;   // into ClusterDag::Indices
+	std::uint32_t IndexCount;
+	// Group whose simplification made the cluster, ClusterDag::NoGroup for the source mesh.
+	std::uint32_t Group;
+	// Group the cluster was simplified with, ClusterDag::NoGroup for a root.
+	std::uint32_t ParentGroup;
+};
+
+struct ClusterDagGroup
+{
+	// Sphere around the group's children: center in xyz, radius in w.  It contains the
+	// bounds of every group below, so the projected error only grows towards the roots.
+	DirectX::XMFLOAT4 Bounds;
+	// Distance in model units by which the group's clusters may depart from the source
+	// mesh; never less than the error of a child.
+	float Error;
+	std::uint32_t FirstChild;    // into ClusterDag::Children
+	std::uint32_t ChildCount;
+	std::uint32_t FirstCluster;  // the clusters the group made, consecutive
+	std::uint32_t ClusterCount;
+	std::uint32_t Reserved;
+};
+
+static_assert(sizeof(ClusterDagCluster) == 16, "ClusterDagCluster layout");
+static_assert(sizeof(ClusterDagGroup) == 40, "ClusterDagGroup layout");
+
+// Clusters of every level of one mesh.  A group is a few neighbouring clusters simplified
+// together into fewer clusters, so each cluster is the child of at most one group and
+// the groups form a DAG.  Drawing the children of a group or the clusters it made
+// covers the same surface with the same outer edges, since those stayed locked.
+struct ClusterDag
+{
+	static constexpr std::uint32_t NoGroup = ~0u;
+
+	std::vector<ClusterDagCluster> Clusters;
+	std::vector<ClusterDagGroup> Groups;
+	// Cluster numbers of each group's children.
+	std::vector<std::uint32_t> Children;
+	// Mesh vertex numbers, three per triangle.
+	std::vector<std::uint32_t> Indices;
+
+	size_t size()const { return Clusters.size(); }
+	bool empty()const { return Clusters.empty(); }
+	void clear();
+};
+
+// Builds the DAG bottom up (the scheme of Karis et al., "Nanite: A Deep Dive"): the mesh
+// is split into meshlets, neighbouring clusters are grouped by the edges they share,
+// each group is simplified to half its triangles with its outer edges locked, and the
+// result is split into new clusters that form the next level.  A group that does not
+// simplify far enough passes its clusters on to be grouped again one level up.  Open
+// edges of the mesh stay locked too, so an open mesh keeps its borders at every level.
+class ClusterDagBuilder
+{
+public:
+	// Clusters are meshlets of up to these sizes; groups start at about groupSize clusters'
+	// worth of triangles and grow where a level barely simplifies.
+	static constexpr size_t ClusterVertices = 128;
+	static constexpr size_t ClusterTriangles = 124;
+	static constexpr size_t DefaultGroupSize = 4;
+	static constexpr size_t MaxLevels = 32;
+
+	// positions points at the position of vertex 0, the next one is vertexStride bytes on;
+	// attributes, if given, is attributeCount floats at the same stride and steers the
+	// simplifier as in MeshSimplifier::Simplify.
+	static void Build(const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+		const std::uint16_t* indices, size_t indexCount, ClusterDag& dag,
+		const float* attributes = nullptr, size_t attributeCount = 0, size_t groupSize = DefaultGroupSize);
+	static void Build(const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+		const std::uint32_t* indices, size_t indexCount, ClusterDag& dag,
+		const float* attributes = nullptr, size_t attributeCount = 0, size_t groupSize = DefaultGroupSize);
+};
+
+struct ClusterDagCut
+{
+	// Clusters to draw.
+	std::vector<std::uint32_t> Clusters;
+	size_t Triangles = 0;
+	// Projected error in pixels of the coarsest group left unrefined, 0 at full detail.
+	float Error = 0.0f;
+
+	// Scratch space kept between calls.
+	std::vector<std::uint32_t> Pending;
+	std::vector<std::uint8_t> Refined;
+};
+
+// Chooses which clusters to draw.
+class ClusterDagSelector
+{
+public:
+	// Starts from the roots and refines the group with the largest projected error, as
+	// LodSelector measures it, until every group left is under threshold pixels or the
+	// next refinement would go over maxTriangles.  A group is only refined once all the
+	// clusters it made are drawn, so the cut never mixes a cluster with its own children
+	// or leaves a hole.  view is in the mesh's space.  A threshold of 0 spends the whole
+	// budget, so the triangle count is set by maxTriangles whatever the size of the mesh.
+	static void Select(const ClusterDag& dag, const LodView& view, float threshold, size_t maxTriangles,
+		ClusterDagCut& cut);
+};
@@ -1,5 +1,11 @@
 #pragma once
 
+// Save procedurally generated meshes under gMeshCacheDirectory and read them back on
+// later runs instead of generating them again.  Off by default, since the files go
+// stale when a generator changes and nothing removes them.
+const bool gPersistMeshCache = false;
+const wchar_t* const gMeshCacheDirectory = L"Assets/Cache";
+
 enum class RenderLayer : int
 {
 	Opaque = 0,
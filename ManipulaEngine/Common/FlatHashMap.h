@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// insert-only open addressing hash map stored in flat arrays
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Each slot has one control byte: 0x80 when empty, otherwise the low 7 bits of the
+// key's hash.  Lookups compare 16 control bytes at once and only touch the key array
+// on a tag match, so a probe is usually one SSE2 compare and one key compare.
+// Entries cannot be erased; Clear() keeps the allocation for reuse.
+template<typename Key, typename Value, typename Hash>
+class FlatHashMap
+{
+public:
+	FlatHashMap() = default;
+
+	// Makes room for count entries without rehashing.
+	void Reserve(size_t count)
+	{
+		// Keep the load factor at or below 7/8.
+		size_t capacity = GroupWidth;
+		while (capacity - capacity / 8 < count)
+			capacity *= 2;
+		if (capacity > Capacity())
+			Rehash(capacity);
+	}
+
+	void Clear()
+	{
+		if (mSize == 0)
+			return;
+		std::memset(mCtrl.data(), Empty, mCtrl.size());
+		mSize = 0;
+		mGrowthLeft = Capacity() - Capacity() / 8;
+	}
+
+	size_t Size()const { return mSize; }
+	size_t Capacity()const { return mMask + 1; }
+
+	Value* Find(const Key& key)
+	{
+		if (mSize == 0)
+			return nullptr;
+		size_t hash = Hash()(key);
+		size_t slot;
+		return FindSlot(key, hash, slot) ? &mValues[slot] : nullptr;
+	}
+
+	// Returns the value stored for key, inserting value first if the key is new.
+	// The flag is true when an insertion happened.
+	std::pair<Value*, bool> Insert(const Key& key, const Value& value)
+	{
+		if (mGrowthLeft == 0)
+			Rehash(Capacity() ? Capacity() * 2 : GroupWidth);
+
+		size_t hash = Hash()(key);
+		size_t slot;
+		if (FindSlot(key, hash, slot))
+			return { &mValues[slot], false };
+
+		SetCtrl(slot, Tag(hash));
+		mKeys[slot] = key;
+		mValues[slot] = value;
+		++mSize;
+		--mGrowthLeft;
+		return { &mValues[slot], true };
+	}
+
+private:
+	static constexpr size_t GroupWidth = 16;
+	static constexpr std::uint8_t Empty = 0x80;
+
+	static std::uint8_t Tag(size_t hash) { return (std::uint8_t)(hash & 0x7F); }
+
+	// Bit i set when control byte i of the group starting at pos equals value.
+	std::uint32_t MatchGroup(size_t pos, std::uint8_t value)const
+	{
+#ifdef FLAT_HASH_MAP_SSE2
+		__m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mCtrl.data() + pos));
+		return (std::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)value)));
+#else
+		std::uint32_t mask = 0;
+		for (size_t i = 0; i < GroupWidth; ++i)
+			mask |= (std::uint32_t)(mCtrl[pos + i] == value) << i;
+		return mask;
+#endif
+	}
+
+	static unsigned LowestBit(std::uint32_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long bit;
+		_BitScanForward(&bit, mask);
+		return (unsigned)bit;
+#else
+		return (unsigned)__builtin_ctz(mask);
+#endif
+	}
+
+	// Returns true and the slot of key if present, otherwise false and the empty
+	// slot where it should be inserted.
+	bool FindSlot(const Key& key, size_t hash, size_t& slot)const
+	{
+		std::uint8_t tag = Tag(hash);
+		size_t pos = (hash >> 7) & mMask;
+		for (size_t step = GroupWidth;; step += GroupWidth)
+		{
+			for (std::uint32_t match = MatchGroup(pos, tag); match; match &= match - 1)
+			{
+				size_t i = (pos + LowestBit(match)) & mMask;
+				if (mKeys[i] == key)
+				{
+					slot = i;
+					return true;
+				}
+			}
+
+			std::uint32_t empty = MatchGroup(pos, Empty);
+			if (empty)
+			{
+				slot = (pos + LowestBit(empty)) & mMask;
+				return false;
+			}
+			pos = (pos + step) & mMask;
+		}
+	}
+
+	void SetCtrl(size_t slot, std::uint8_t value)
+	{
+		mCtrl[slot] = value;
+		// The first GroupWidth - 1 bytes are mirrored after the end so that a group
+		// load starting near the end of the table wraps around.
+		if (slot < GroupWidth - 1)
+			mCtrl[Capacity() + slot] = value;
+	}
+
+	void Rehash(size_t capacity)
+	{
+		std::vector<std::uint8_t> oldCtrl;
+		std::vector<Key> oldKeys;
+		std::vector<Value> oldValues;
+		oldCtrl.swap(mCtrl);
+		oldKeys.swap(mKeys);
+		oldValues.swap(mValues);
+		size_t oldCapacity = oldKeys.size();
+
+		mCtrl.assign(capacity + GroupWidth - 1, Empty);
+		mKeys.resize(capacity);
+		mValues.resize(capacity);
+		mMask = capacity - 1;
+		mGrowthLeft = capacity - capacity / 8 - mSize;
+
+		for (size_t i = 0; i < oldCapacity; ++i)
+		{
+			if (oldCtrl[i] == Empty)
+				continue;
+			size_t hash = Hash()(oldKeys[i]);
+			size_t slot;
+			FindSlot(oldKeys[i], hash, slot);
+			SetCtrl(slot, Tag(hash));
+			mKeys[slot] = std::move(oldKeys[i]);
+			mValues[slot] = std::move(oldValues[i]);
+		}
+	}
+
+	std::vector<std::uint8_t> mCtrl;
+	std::vector<Key> mKeys;
+	std::vector<Value> mValues;
+	size_t mMask = (size_t)-1;
+	size_t mSize = 0;
+	size_t mGrowthLeft = 0;
+};
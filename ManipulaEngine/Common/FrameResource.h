@@ -1,6 +1,7 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "GeometryGenerator.h"
 #include "MathHelper.h"
 #include "UploadBuffer.h"
 
@@ -49,6 +50,19 @@ struct Vertex
 	DirectX::XMFLOAT2 TexC;
 };
 
+template<>
+struct GeometryVertexFormat<Vertex>
+{
+	static const std::uint32_t Id = 1;
+	static const bool MboVertex = true;
+	static void Store(Vertex& out, const GeometryGenerator::Vertex& v)
+	{
+		out.Pos = v.Position;
+		out.Normal = v.Normal;
+		out.TexC = v.TexC;
+	}
+};
+
 // Stores the resources needed for the CPU to build the command lists
 // for a frame.  
 struct FrameResource
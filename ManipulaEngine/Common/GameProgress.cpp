@@ -61,6 +61,7 @@ void GameProgress::Update(const GameTimer& gt)
 {
 	OnKeyboardInput(gt);
 	UpdateCamera(gt);
+	UpdateLods(gt);
 	//׼Ⱦһ֡
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
 	mCurrFrameResource = mFrameResources[mCurrFrameResourceIndex].get();
@@ -210,6 +211,12 @@ void GameProgress::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
+void GameProgress::UpdateLods(const GameTimer& gt)
+{
+	const std::vector<RenderItem*>& opaque = mRitemLayer[(int)RenderLayer::Opaque];
+	LodSelector::Select(opaque.data(), opaque.size(), LodSelector::MakeView(mCamera, (float)mClientHeight));
+}
+
 void GameProgress::UpdateObjectCBs(const GameTimer& gt)
 {
 	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
@@ -576,56 +583,27 @@ void GameProgress::BuildShadersAndInputLayout()
 void GameProgress::BuildModel()
 {
 	PlyReader ply;
-	ply.ReadFile(L"Assets/dragon_vrip.ply");
+	ply.ReadFile(L"Assets/dragon_vrip.ply", 0);
 }
 
 void GameProgress::BuildBoxGeometry()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateSphere(1.0f, 20, 20);
-
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = 0;
-	boxSubmesh.BaseVertexLocation = 0;
-
-	std::vector<Vertex> vertices(box.Vertices.size());
-
-	for (size_t i = 0; i < box.Vertices.size(); ++i)
+	// The sphere and its levels of detail come from the cache, which only generates and
+	// uploads them the first time.  With gPersistMeshCache it also reads them from
+	// gMeshCacheDirectory if an earlier run saved them there.
+	if (gPersistMeshCache &&
+		(CreateDirectoryW(gMeshCacheDirectory, nullptr) || GetLastError() == ERROR_ALREADY_EXISTS))
 	{
-		vertices[i].Pos = box.Vertices[i].Position;
-		vertices[i].Normal = box.Vertices[i].Normal;
-		vertices[i].TexC = box.Vertices[i].TexC;
+		mMeshCache.SetDirectory(gMeshCacheDirectory);
 	}
-	std::vector<std::uint16_t> indices = box.GetIndices16();
-
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
-
-	auto mBoxGeo = std::make_unique<MeshGeometry>();
-	mBoxGeo->Name = "boxGeo";
-
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &mBoxGeo->VertexBufferCPU));
-	CopyMemory(mBoxGeo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &mBoxGeo->IndexBufferCPU));
-	CopyMemory(mBoxGeo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-	mBoxGeo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, mBoxGeo->VertexBufferUploader);
-
-	mBoxGeo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, mBoxGeo->IndexBufferUploader);
-
-	mBoxGeo->VertexByteStride = sizeof(Vertex);
-	mBoxGeo->VertexBufferByteSize = vbByteSize;
-	mBoxGeo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	mBoxGeo->IndexBufferByteSize = ibByteSize;
-
-	mBoxGeo->DrawArgs["box"] = boxSubmesh;
 
+	ProceduralMeshDesc sphereDesc = ProceduralMeshDesc::Sphere(1.0f, 20, 20);
+	sphereDesc.Lods = true;
+	std::shared_ptr<ProceduralMesh> sphere = mMeshCache.Get<Vertex>(md3dDevice.Get(), mCommandList.Get(), sphereDesc);
+	mSphereLods = sphere->Lods;
 
-	mGeometries["boxGeo"] = std::move(mBoxGeo);
+	// The map shares the cached mesh; the cache keeps it alive as well.
+	mGeometries["boxGeo"] = std::shared_ptr<MeshGeometry>(sphere, &sphere->Geometry);
 }
 
 void GameProgress::BuildShpere()
@@ -850,9 +828,11 @@ void GameProgress::BuildRenderItems()
 	sphereRitem1->Mat = mMaterials["green"].get();
 	sphereRitem1->Geo = mGeometries["boxGeo"].get();
 	sphereRitem1->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	sphereRitem1->IndexCount = sphereRitem1->Geo->DrawArgs["box"].IndexCount;
-	sphereRitem1->StartIndexLocation = sphereRitem1->Geo->DrawArgs["box"].StartIndexLocation;
-	sphereRitem1->BaseVertexLocation = sphereRitem1->Geo->DrawArgs["box"].BaseVertexLocation;
+	sphereRitem1->IndexCount = sphereRitem1->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].IndexCount;
+	sphereRitem1->StartIndexLocation = sphereRitem1->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].StartIndexLocation;
+	sphereRitem1->BaseVertexLocation = sphereRitem1->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].BaseVertexLocation;
+	sphereRitem1->Lods = mSphereLods;
+	BoundingSphere::CreateFromBoundingBox(sphereRitem1->Bounds, sphereRitem1->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].Bounds);
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(sphereRitem1.get());
 
 	auto sphereRitem2 = std::make_unique<RenderItem>();
@@ -862,9 +842,11 @@ void GameProgress::BuildRenderItems()
 	sphereRitem2->Mat = mMaterials["blue"].get();
 	sphereRitem2->Geo = mGeometries["boxGeo"].get();
 	sphereRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	sphereRitem2->IndexCount = sphereRitem2->Geo->DrawArgs["box"].IndexCount;
-	sphereRitem2->StartIndexLocation = sphereRitem2->Geo->DrawArgs["box"].StartIndexLocation;
-	sphereRitem2->BaseVertexLocation = sphereRitem2->Geo->DrawArgs["box"].BaseVertexLocation;
+	sphereRitem2->IndexCount = sphereRitem2->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].IndexCount;
+	sphereRitem2->StartIndexLocation = sphereRitem2->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].StartIndexLocation;
+	sphereRitem2->BaseVertexLocation = sphereRitem2->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].BaseVertexLocation;
+	sphereRitem2->Lods = mSphereLods;
+	BoundingSphere::CreateFromBoundingBox(sphereRitem2->Bounds, sphereRitem2->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].Bounds);
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(sphereRitem2.get());
 
 	auto sphereRitem3 = std::make_unique<RenderItem>();
@@ -874,9 +856,11 @@ void GameProgress::BuildRenderItems()
 	sphereRitem3->Mat = mMaterials["red"].get();
 	sphereRitem3->Geo = mGeometries["boxGeo"].get();
 	sphereRitem3->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	sphereRitem3->IndexCount = sphereRitem3->Geo->DrawArgs["box"].IndexCount;
-	sphereRitem3->StartIndexLocation = sphereRitem3->Geo->DrawArgs["box"].StartIndexLocation;
-	sphereRitem3->BaseVertexLocation = sphereRitem3->Geo->DrawArgs["box"].BaseVertexLocation;
+	sphereRitem3->IndexCount = sphereRitem3->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].IndexCount;
+	sphereRitem3->StartIndexLocation = sphereRitem3->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].StartIndexLocation;
+	sphereRitem3->BaseVertexLocation = sphereRitem3->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].BaseVertexLocation;
+	sphereRitem3->Lods = mSphereLods;
+	BoundingSphere::CreateFromBoundingBox(sphereRitem3->Bounds, sphereRitem3->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].Bounds);
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(sphereRitem3.get());
 
 	auto sphereRitem4 = std::make_unique<RenderItem>();
@@ -886,9 +870,11 @@ void GameProgress::BuildRenderItems()
 	sphereRitem4->Mat = mMaterials["write"].get();
 	sphereRitem4->Geo = mGeometries["boxGeo"].get();
 	sphereRitem4->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	sphereRitem4->IndexCount = sphereRitem4->Geo->DrawArgs["box"].IndexCount;
-	sphereRitem4->StartIndexLocation = sphereRitem4->Geo->DrawArgs["box"].StartIndexLocation;
-	sphereRitem4->BaseVertexLocation = sphereRitem4->Geo->DrawArgs["box"].BaseVertexLocation;
+	sphereRitem4->IndexCount = sphereRitem4->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].IndexCount;
+	sphereRitem4->StartIndexLocation = sphereRitem4->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].StartIndexLocation;
+	sphereRitem4->BaseVertexLocation = sphereRitem4->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].BaseVertexLocation;
+	sphereRitem4->Lods = mSphereLods;
+	BoundingSphere::CreateFromBoundingBox(sphereRitem4->Bounds, sphereRitem4->Geo->DrawArgs[ProceduralMeshCache::SubmeshName].Bounds);
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(sphereRitem4.get());
 
 	mAllRitems.push_back(std::move(sphereRitem1));
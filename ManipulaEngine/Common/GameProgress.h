@@ -6,6 +6,8 @@
 #include "FrameResource.h"
 #include "EngineConfig.h"
 #include "Camera.h"
+#include "LodSelector.h"
+#include "ProceduralMeshCache.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -37,6 +39,7 @@ private:
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateLods(const GameTimer& gt);
 	//void AnimateMaterials(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialCBs(const GameTimer& gt);
@@ -74,7 +77,8 @@ private:
 	ComPtr<ID3D12DescriptorHeap> mSrvNormalDescriptorHeap = nullptr;
 	ComPtr<ID3D12DescriptorHeap> mCbvDescriptorHeap = nullptr;
 
-	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
+	std::unordered_map<std::string, std::shared_ptr<MeshGeometry>> mGeometries;
+	ProceduralMeshCache mMeshCache;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
@@ -82,6 +86,9 @@ private:
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
+	// Index ranges of the sphere's levels of detail in boxGeo.
+	std::vector<RenderItemLod> mSphereLods;
+
 	RenderItem* mWavesRitem = nullptr;
 
 	// List of all the render items.
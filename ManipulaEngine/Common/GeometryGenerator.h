@@ -14,10 +14,23 @@
 
 #pragma once
 
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <type_traits>
 #include <DirectXMath.h>
 #include <vector>
 
+// Specialize for a vertex type to generate straight into it: a static
+// Store(VertexOut& out, const GeometryGenerator::Vertex& v) copies the members the
+// format has, a static const std::uint32_t Id tells it apart from every other
+// format, e.g. in ProceduralMeshCache keys, and a static const bool MboVertex says the
+// format is laid out like VertexPosNormalTex, so ProceduralMeshCache can keep it in
+// MBO files.  See the specializations below and in FrameResource.h.
+template<typename VertexOut>
+struct GeometryVertexFormat;
+
 class GeometryGenerator
 {
 public:
@@ -88,9 +101,11 @@ public:
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation, up to 8 levels (1.3M triangles).
+	/// Every vertex is shared by the triangles around it.  Each level is split
+	/// over numThreads threads (0 uses every hardware thread).
 	///</summary>
-    MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    MeshData CreateGeosphere(float radius, uint32 numSubdivisions, uint32 numThreads = 1);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -101,19 +116,614 @@ public:
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
-	/// at the origin with the specified width and depth.
+	/// at the origin with the specified width and depth.  Blocks of rows are
+	/// written by numThreads threads (0 uses every hardware thread), each with
+	/// at least ParallelForMinItems vertices; the result is the same for any
+	/// numThreads.
 	///</summary>
-    MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    MeshData CreateGrid(float width, float depth, uint32 m, uint32 n, uint32 numThreads = 1);
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	// Vertex and index counts of a primitive, for sizing the memory the span
+	// overloads below write to.
+	struct MeshSize
+	{
+		uint32 VertexCount = 0;
+		uint32 IndexCount = 0;
+	};
+
+	template<typename Index>
+	using EnableIndex = std::enable_if_t<std::is_same<Index, uint16>::value || std::is_same<Index, uint32>::value>;
+
+	static MeshSize BoxSize() { return { 24, 36 }; }
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n) { return { m*n, (m-1)*(n-1)*6 }; }
+	static MeshSize QuadSize() { return { 4, 6 }; }
+
+	///<summary>
+	/// Span overloads of the Create functions: they write the mesh straight into the
+	/// caller's memory, e.g. a mapped upload buffer, in any vertex format that has a
+	/// GeometryVertexFormat and with 16 or 32-bit indices, and allocate nothing.
+	/// vertices and indices must hold the counts the matching Size function returns,
+	/// which is also what they return.  16-bit indices need at most 65536 vertices.
+	///</summary>
+	template<typename VertexOut, typename Index, typename = EnableIndex<Index>>
+	MeshSize CreateBox(float width, float height, float depth, VertexOut* vertices, Index* indices)
+	{
+		return CreateBoxImpl(width, height, depth, vertices, indices);
+	}
+	template<typename VertexOut, typename Index, typename = EnableIndex<Index>>
+	MeshSize CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, VertexOut* vertices, Index* indices)
+	{
+		return CreateSphereImpl(radius, sliceCount, stackCount, vertices, indices);
+	}
+	template<typename VertexOut, typename Index, typename = EnableIndex<Index>>
+	MeshSize CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+		VertexOut* vertices, Index* indices)
+	{
+		return CreateCylinderImpl(bottomRadius, topRadius, height, sliceCount, stackCount, vertices, indices);
+	}
+	template<typename VertexOut, typename Index, typename = EnableIndex<Index>>
+	MeshSize CreateGrid(float width, float depth, uint32 m, uint32 n, VertexOut* vertices, Index* indices,
+		uint32 numThreads = 1)
+	{
+		return CreateGridImpl(width, depth, m, n, vertices, indices, numThreads);
+	}
+	template<typename VertexOut, typename Index, typename = EnableIndex<Index>>
+	MeshSize CreateQuad(float x, float y, float w, float h, float depth, VertexOut* vertices, Index* indices)
+	{
+		return CreateQuadImpl(x, y, w, h, depth, vertices, indices);
+	}
+
 private:
-	void Subdivide(MeshData& meshData);
+	// Defined below the class, so that GeometryVertexFormat<VertexOut>::Store inlines
+	// into the loops that write each vertex.
+	template<typename VertexOut, typename Index>
+	MeshSize CreateBoxImpl(float width, float height, float depth, VertexOut* vertices, Index* indices);
+	template<typename VertexOut, typename Index>
+	MeshSize CreateSphereImpl(float radius, uint32 sliceCount, uint32 stackCount, VertexOut* vertices, Index* indices);
+	template<typename VertexOut, typename Index>
+	MeshSize CreateCylinderImpl(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+		VertexOut* vertices, Index* indices);
+	template<typename VertexOut, typename Index>
+	MeshSize CreateGridImpl(float width, float depth, uint32 m, uint32 n, VertexOut* vertices, Index* indices,
+		uint32 numThreads);
+	template<typename VertexOut, typename Index>
+	MeshSize CreateQuadImpl(float x, float y, float w, float h, float depth, VertexOut* vertices, Index* indices);
+	template<typename VertexOut, typename Index>
+	void BuildCylinderTopCap(float topRadius, float height, uint32 sliceCount, uint32 baseIndex,
+		VertexOut* vertices, Index* indices);
+	template<typename VertexOut, typename Index>
+	void BuildCylinderBottomCap(float bottomRadius, float height, uint32 sliceCount, uint32 baseIndex,
+		VertexOut* vertices, Index* indices);
+	template<typename Body>
+	static void ForEachRingAngle(uint32 count, float step, const Body& body);
+
+	///<summary>
+	/// Splits every triangle into four, numSubdivisions times.  Each edge gets one
+	/// midpoint shared by the triangles on both sides.
+	///</summary>
+	void Subdivide(MeshData& meshData, uint32 numSubdivisions = 1, uint32 numThreads = 1);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
 };
 
+template<>
+struct GeometryVertexFormat<GeometryGenerator::Vertex>
+{
+	static const std::uint32_t Id = 0;
+	static const bool MboVertex = false;
+	static void Store(GeometryGenerator::Vertex& out, const GeometryGenerator::Vertex& v) { out = v; }
+};
+
+// Calls body(j, sin, cos) for the angles j*step, j = 0..count-1, in order.  The sines
+// and cosines are computed four at a time with XMVectorSinCos, whose 11/10-degree polynomials
+// stay within 5e-7 of sinf and cosf over [0, 2pi].  Each angle is computed directly
+// rather than by rotating the previous one, so the error does not grow with count.
+template<typename Body>
+void GeometryGenerator::ForEachRingAngle(uint32 count, float step, const Body& body)
+{
+	const DirectX::XMVECTOR lanes = DirectX::XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+	for(std::uint32_t j = 0; j < count; j += 4)
+	{
+		DirectX::XMVECTOR angles = DirectX::XMVectorScale(
+			DirectX::XMVectorAdd(DirectX::XMVectorReplicate((float)j), lanes), step);
+		DirectX::XMVECTOR s, c;
+		DirectX::XMVectorSinCos(&s, &c, angles);
+
+		DirectX::XMFLOAT4A sines, cosines;
+		DirectX::XMStoreFloat4A(&sines, s);
+		DirectX::XMStoreFloat4A(&cosines, c);
+		std::uint32_t last = std::min(count - j, 4u);
+		for(std::uint32_t k = 0; k < last; ++k)
+			body(j + k, (&sines.x)[k], (&cosines.x)[k]);
+	}
+}
+
+template<typename VertexOut, typename Index>
+GeometryGenerator::MeshSize GeometryGenerator::CreateBoxImpl(float width, float height, float depth,
+	VertexOut* vertices, Index* indices)
+{
+    //
+	// Create the vertices.
+	//
+
+	Vertex v[24];
+
+	float w2 = 0.5f*width;
+	float h2 = 0.5f*height;
+	float d2 = 0.5f*depth;
+    
+	// Fill in the front face vertex data.
+	v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	v[2] = Vertex(+w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+	v[3] = Vertex(+w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+	// Fill in the back face vertex data.
+	v[4] = Vertex(-w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+	v[5] = Vertex(+w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	v[6] = Vertex(+w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	v[7] = Vertex(-w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+	// Fill in the top face vertex data.
+	v[8]  = Vertex(-w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	v[9]  = Vertex(-w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	v[10] = Vertex(+w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+	v[11] = Vertex(+w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+	// Fill in the bottom face vertex data.
+	v[12] = Vertex(-w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+	v[13] = Vertex(+w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	v[14] = Vertex(+w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	v[15] = Vertex(-w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+	// Fill in the left face vertex data.
+	v[16] = Vertex(-w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
+	v[17] = Vertex(-w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
+	v[18] = Vertex(-w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
+	v[19] = Vertex(-w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
+
+	// Fill in the right face vertex data.
+	v[20] = Vertex(+w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
+	v[21] = Vertex(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+
+	for(uint32 k = 0; k < 24; ++k)
+		GeometryVertexFormat<VertexOut>::Store(vertices[k], v[k]);
+ 
+	//
+	// Create the indices.
+	//
+
+	uint32 i[36];
+
+	// Fill in the front face index data
+	i[0] = 0; i[1] = 1; i[2] = 2;
+	i[3] = 0; i[4] = 2; i[5] = 3;
+
+	// Fill in the back face index data
+	i[6] = 4; i[7]  = 5; i[8]  = 6;
+	i[9] = 4; i[10] = 6; i[11] = 7;
+
+	// Fill in the top face index data
+	i[12] = 8; i[13] =  9; i[14] = 10;
+	i[15] = 8; i[16] = 10; i[17] = 11;
+
+	// Fill in the bottom face index data
+	i[18] = 12; i[19] = 13; i[20] = 14;
+	i[21] = 12; i[22] = 14; i[23] = 15;
+
+	// Fill in the left face index data
+	i[24] = 16; i[25] = 17; i[26] = 18;
+	i[27] = 16; i[28] = 18; i[29] = 19;
+
+	// Fill in the right face index data
+	i[30] = 20; i[31] = 21; i[32] = 22;
+	i[33] = 20; i[34] = 22; i[35] = 23;
+
+	std::copy(&i[0], &i[36], indices);
+
+    return BoxSize();
+}
+
+template<typename VertexOut, typename Index>
+GeometryGenerator::MeshSize GeometryGenerator::CreateSphereImpl(float radius, uint32 sliceCount, uint32 stackCount,
+	VertexOut* vertices, Index* indices)
+{
+	uint32 vertexCount = 0;
+	uint32 indexCount = 0;
+
+	//
+	// Compute the vertices stating at the top pole and moving down the stacks.
+	//
+
+	// Poles: note that there will be texture coordinate distortion as there is
+	// not a unique point on the texture map to assign to the pole when mapping
+	// a rectangular texture onto a sphere.
+	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+	GeometryVertexFormat<VertexOut>::Store(vertices[vertexCount++], topVertex);
+
+	float phiStep   = DirectX::XM_PI/stackCount;
+	float thetaStep = 2.0f*DirectX::XM_PI/sliceCount;
+
+	// Compute vertices for each stack ring (do not count the poles as rings).
+	for(uint32 i = 1; i <= stackCount-1; ++i)
+	{
+		float phi = i*phiStep;
+		float sinPhi, cosPhi;
+		DirectX::XMScalarSinCos(&sinPhi, &cosPhi, phi);
+
+		// Vertices of ring.
+		ForEachRingAngle(sliceCount+1, thetaStep, [&](uint32 j, float sinTheta, float cosTheta)
+		{
+			Vertex v;
+
+			// spherical to cartesian; the unit normal is the direction of the position.
+			v.Normal = DirectX::XMFLOAT3(sinPhi*cosTheta, cosPhi, sinPhi*sinTheta);
+			v.Position = DirectX::XMFLOAT3(radius*v.Normal.x, radius*v.Normal.y, radius*v.Normal.z);
+
+			// Partial derivative of P with respect to theta, divided by its length
+			// radius*sin(phi), which is positive off the poles.
+			v.TangentU = DirectX::XMFLOAT3(-sinTheta, 0.0f, cosTheta);
+
+			v.TexC.x = j*thetaStep / DirectX::XM_2PI;
+			v.TexC.y = phi / DirectX::XM_PI;
+
+			GeometryVertexFormat<VertexOut>::Store(vertices[vertexCount + j], v);
+		});
+		vertexCount += sliceCount+1;
+	}
+
+	GeometryVertexFormat<VertexOut>::Store(vertices[vertexCount++], bottomVertex);
+
+	//
+	// Compute indices for top stack.  The top stack was written first to the vertex buffer
+	// and connects the top pole to the first ring.
+	//
+
+    for(uint32 i = 1; i <= sliceCount; ++i)
+	{
+		indices[indexCount++] = 0;
+		indices[indexCount++] = (Index)(i+1);
+		indices[indexCount++] = (Index)i;
+	}
+	
+	//
+	// Compute indices for inner stacks (not connected to poles).
+	//
+
+	// Offset the indices to the index of the first vertex in the first ring.
+	// This is just skipping the top pole vertex.
+    uint32 baseIndex = 1;
+    uint32 ringVertexCount = sliceCount + 1;
+	for(uint32 i = 0; i < stackCount-2; ++i)
+	{
+		for(uint32 j = 0; j < sliceCount; ++j)
+		{
+			indices[indexCount++] = (Index)(baseIndex + i*ringVertexCount + j);
+			indices[indexCount++] = (Index)(baseIndex + i*ringVertexCount + j+1);
+			indices[indexCount++] = (Index)(baseIndex + (i+1)*ringVertexCount + j);
+
+			indices[indexCount++] = (Index)(baseIndex + (i+1)*ringVertexCount + j);
+			indices[indexCount++] = (Index)(baseIndex + i*ringVertexCount + j+1);
+			indices[indexCount++] = (Index)(baseIndex + (i+1)*ringVertexCount + j+1);
+		}
+	}
+
+	//
+	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+	// and connects the bottom pole to the bottom ring.
+	//
+
+	// South pole vertex was added last.
+	uint32 southPoleIndex = vertexCount-1;
+
+	// Offset the indices to the index of the first vertex in the last ring.
+	baseIndex = southPoleIndex - ringVertexCount;
+	
+	for(uint32 i = 0; i < sliceCount; ++i)
+	{
+		indices[indexCount++] = (Index)southPoleIndex;
+		indices[indexCount++] = (Index)(baseIndex+i);
+		indices[indexCount++] = (Index)(baseIndex+i+1);
+	}
+
+    return { vertexCount, indexCount };
+}
+
+template<typename VertexOut, typename Index>
+GeometryGenerator::MeshSize GeometryGenerator::CreateCylinderImpl(float bottomRadius, float topRadius, float height,
+	uint32 sliceCount, uint32 stackCount, VertexOut* vertices, Index* indices)
+{
+	uint32 vertexCount = 0;
+	uint32 indexCount = 0;
+
+	//
+	// Build Stacks.
+	// 
+
+	float stackHeight = height / stackCount;
+
+	// Amount to increment radius as we move up each stack level from bottom to top.
+	float radiusStep = (topRadius - bottomRadius) / stackCount;
+
+	uint32 ringCount = stackCount+1;
+
+	// The normal is the same on every ring, see below.
+	float dr = bottomRadius-topRadius;
+	float invNormalLength = 1.0f/sqrtf(height*height + dr*dr);
+
+	// Compute vertices for each stack ring starting at the bottom and moving up.
+	for(uint32 i = 0; i < ringCount; ++i)
+	{
+		float y = -0.5f*height + i*stackHeight;
+		float r = bottomRadius + i*radiusStep;
+
+		// vertices of ring
+		float dTheta = 2.0f*DirectX::XM_PI/sliceCount;
+		ForEachRingAngle(sliceCount+1, dTheta, [&](uint32 j, float s, float c)
+		{
+			Vertex vertex;
+
+			vertex.Position = DirectX::XMFLOAT3(r*c, y, r*s);
+
+			vertex.TexC.x = (float)j/sliceCount;
+			vertex.TexC.y = 1.0f - (float)i/stackCount;
+
+			// Cylinder can be parameterized as follows, where we introduce v
+			// parameter that goes in the same direction as the v tex-coord
+			// so that the bitangent goes in the same direction as the v tex-coord.
+			//   Let r0 be the bottom radius and let r1 be the top radius.
+			//   y(v) = h - hv for v in [0,1].
+			//   r(v) = r1 + (r0-r1)v
+			//
+			//   x(t, v) = r(v)*cos(t)
+			//   y(t, v) = h - hv
+			//   z(t, v) = r(v)*sin(t)
+			// 
+			//  dx/dt = -r(v)*sin(t)
+			//  dy/dt = 0
+			//  dz/dt = +r(v)*cos(t)
+			//
+			//  dx/dv = (r0-r1)*cos(t)
+			//  dy/dv = -h
+			//  dz/dv = (r0-r1)*sin(t)
+
+			// This is unit length.
+			vertex.TangentU = DirectX::XMFLOAT3(-s, 0.0f, c);
+
+			// The normal is cross(dP/dt, dP/dv) = (h*cos(t), r0-r1, h*sin(t)), whose
+			// length sqrt(h^2 + (r0-r1)^2) does not depend on t.
+			vertex.Normal = DirectX::XMFLOAT3(height*c*invNormalLength, dr*invNormalLength, height*s*invNormalLength);
+
+			GeometryVertexFormat<VertexOut>::Store(vertices[vertexCount + j], vertex);
+		});
+		vertexCount += sliceCount+1;
+	}
+
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount+1;
+
+	// Compute indices for each stack.
+	for(uint32 i = 0; i < stackCount; ++i)
+	{
+		for(uint32 j = 0; j < sliceCount; ++j)
+		{
+			indices[indexCount++] = (Index)(i*ringVertexCount + j);
+			indices[indexCount++] = (Index)((i+1)*ringVertexCount + j);
+			indices[indexCount++] = (Index)((i+1)*ringVertexCount + j+1);
+
+			indices[indexCount++] = (Index)(i*ringVertexCount + j);
+			indices[indexCount++] = (Index)((i+1)*ringVertexCount + j+1);
+			indices[indexCount++] = (Index)(i*ringVertexCount + j+1);
+		}
+	}
+
+	// Each cap is a ring of sliceCount+1 vertices around a center.
+	BuildCylinderTopCap(topRadius, height, sliceCount, vertexCount, vertices, indices + indexCount);
+	vertexCount += sliceCount+2;
+	indexCount += sliceCount*3;
+	BuildCylinderBottomCap(bottomRadius, height, sliceCount, vertexCount, vertices, indices + indexCount);
+	vertexCount += sliceCount+2;
+	indexCount += sliceCount*3;
+
+    return { vertexCount, indexCount };
+}
+
+template<typename VertexOut, typename Index>
+void GeometryGenerator::BuildCylinderTopCap(float topRadius, float height, uint32 sliceCount, uint32 baseIndex,
+											VertexOut* vertices, Index* indices)
+{
+
+	float y = 0.5f*height;
+	float dTheta = 2.0f*DirectX::XM_PI/sliceCount;
+
+	// Duplicate cap ring vertices because the texture coordinates and normals differ.
+	ForEachRingAngle(sliceCount+1, dTheta, [&](uint32 i, float s, float c)
+	{
+		float x = topRadius*c;
+		float z = topRadius*s;
+
+		// Scale down by the height to try and make top cap texture coord area
+		// proportional to base.
+		float u = x/height + 0.5f;
+		float v = z/height + 0.5f;
+
+		GeometryVertexFormat<VertexOut>::Store(vertices[baseIndex + i], Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+	});
+
+	// Index of center vertex.
+	uint32 centerIndex = baseIndex + sliceCount+1;
+
+	// Cap center vertex.
+	GeometryVertexFormat<VertexOut>::Store(vertices[centerIndex], Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+
+	for(uint32 i = 0; i < sliceCount; ++i)
+	{
+		indices[i*3+0] = (Index)centerIndex;
+		indices[i*3+1] = (Index)(baseIndex + i+1);
+		indices[i*3+2] = (Index)(baseIndex + i);
+	}
+}
+
+template<typename VertexOut, typename Index>
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float height, uint32 sliceCount, uint32 baseIndex,
+											   VertexOut* vertices, Index* indices)
+{
+	// 
+	// Build bottom cap.
+	//
+
+	float y = -0.5f*height;
+
+	// vertices of ring
+	float dTheta = 2.0f*DirectX::XM_PI/sliceCount;
+	ForEachRingAngle(sliceCount+1, dTheta, [&](uint32 i, float s, float c)
+	{
+		float x = bottomRadius*c;
+		float z = bottomRadius*s;
+
+		// Scale down by the height to try and make top cap texture coord area
+		// proportional to base.
+		float u = x/height + 0.5f;
+		float v = z/height + 0.5f;
+
+		GeometryVertexFormat<VertexOut>::Store(vertices[baseIndex + i], Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
+	});
+
+	// Cache the index of center vertex.
+	uint32 centerIndex = baseIndex + sliceCount+1;
+
+	// Cap center vertex.
+	GeometryVertexFormat<VertexOut>::Store(vertices[centerIndex], Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+
+	for(uint32 i = 0; i < sliceCount; ++i)
+	{
+		indices[i*3+0] = (Index)centerIndex;
+		indices[i*3+1] = (Index)(baseIndex + i);
+		indices[i*3+2] = (Index)(baseIndex + i+1);
+	}
+}
+
+template<typename VertexOut, typename Index>
+GeometryGenerator::MeshSize GeometryGenerator::CreateGridImpl(float width, float depth, uint32 m, uint32 n,
+	VertexOut* vertices, Index* indices, uint32 numThreads)
+{
+	// Each thread takes a block of whole rows; row i's vertices and quads have fixed
+	// places in the output, so the threads never write to the same memory.  ParallelFor
+	// starts its threads on every call, so a block gets at least ParallelForMinItems
+	// vertices and small grids stay on the calling thread.
+	size_t minRows = std::max<size_t>(1, ParallelForMinItems / std::max(n, 1u));
+
+	//
+	// Create the vertices.
+	//
+
+	float halfWidth = 0.5f*width;
+	float halfDepth = 0.5f*depth;
+
+	float dx = width / (n-1);
+	float dz = depth / (m-1);
+
+	float du = 1.0f / (n-1);
+	float dv = 1.0f / (m-1);
+
+	ParallelFor(m, numThreads, [&](size_t first, size_t end)
+	{
+		Vertex vertex;
+		vertex.Normal   = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+		vertex.TangentU = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+		for(uint32 i = (uint32)first; i < end; ++i)
+		{
+			float z = halfDepth - i*dz;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
+
+				vertex.Position = DirectX::XMFLOAT3(x, 0.0f, z);
+
+				// Stretch texture over grid.
+				vertex.TexC.x = j*du;
+				vertex.TexC.y = i*dv;
+
+				GeometryVertexFormat<VertexOut>::Store(vertices[i*n+j], vertex);
+			}
+		}
+	}, minRows);
+ 
+    //
+	// Create the indices.
+	//
+
+	// Iterate over each quad and compute indices.
+	ParallelFor(m-1, numThreads, [&](size_t first, size_t end)
+	{
+		size_t k = first*(n-1)*6;
+		for(uint32 i = (uint32)first; i < end; ++i)
+		{
+			for(uint32 j = 0; j < n-1; ++j)
+			{
+				indices[k]   = (Index)(i*n+j);
+				indices[k+1] = (Index)(i*n+j+1);
+				indices[k+2] = (Index)((i+1)*n+j);
+
+				indices[k+3] = (Index)((i+1)*n+j);
+				indices[k+4] = (Index)(i*n+j+1);
+				indices[k+5] = (Index)((i+1)*n+j+1);
+
+				k += 6; // next quad
+			}
+		}
+	}, minRows);
+
+    return GridSize(m, n);
+}
+
+template<typename VertexOut, typename Index>
+GeometryGenerator::MeshSize GeometryGenerator::CreateQuadImpl(float x, float y, float w, float h, float depth,
+	VertexOut* vertices, Index* indices)
+{
+	// Position coordinates specified in NDC space.
+	GeometryVertexFormat<VertexOut>::Store(vertices[0], Vertex(
+        x, y - h, depth,
+		0.0f, 0.0f, -1.0f,
+		1.0f, 0.0f, 0.0f,
+		0.0f, 1.0f));
+
+	GeometryVertexFormat<VertexOut>::Store(vertices[1], Vertex(
+		x, y, depth,
+		0.0f, 0.0f, -1.0f,
+		1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f));
+
+	GeometryVertexFormat<VertexOut>::Store(vertices[2], Vertex(
+		x+w, y, depth,
+		0.0f, 0.0f, -1.0f,
+		1.0f, 0.0f, 0.0f,
+		1.0f, 0.0f));
+
+	GeometryVertexFormat<VertexOut>::Store(vertices[3], Vertex(
+		x+w, y-h, depth,
+		0.0f, 0.0f, -1.0f,
+		1.0f, 0.0f, 0.0f,
+		1.0f, 1.0f));
+
+	indices[0] = 0;
+	indices[1] = 1;
+	indices[2] = 2;
+
+	indices[3] = 0;
+	indices[4] = 2;
+	indices[5] = 3;
+
+    return QuadSize();
+}
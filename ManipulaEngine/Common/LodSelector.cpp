@@ -0,0 +1,110 @@
+#include "LodSelector.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Moves current towards the coarsest level that still looks good enough.  Errors grow
+	// with the level, so the walk stops at the first level on the other side.
+	UINT PickLevel(const std::vector<RenderItemLod>& lods, UINT current, float pixelsPerError,
+		float threshold, float coarserThreshold)
+	{
+		UINT last = (UINT)lods.size() - 1;
+		UINT level = std::min(current, last);
+		if (lods[level].Error * pixelsPerError > threshold)
+		{
+			while (level > 0 && lods[level].Error * pixelsPerError > threshold)
+				--level;
+		}
+		else
+		{
+			while (level < last && lods[level + 1].Error * pixelsPerError <= coarserThreshold)
+				++level;
+		}
+		return level;
+	}
+}
+
+LodView LodSelector::MakeView(const Camera& camera, float viewportHeight)
+{
+	LodView view;
+	view.EyePos = camera.GetPosition3f();
+	view.PixelsPerUnit = viewportHeight / (2.0f * std::tan(0.5f * camera.GetFovY()));
+	view.NearZ = camera.GetNearZ();
+	return view;
+}
+
+LodSelectStatistics LodSelector::Select(RenderItem* const* items, size_t count, const LodView& view,
+	float threshold, float hysteresis)
+{
+	LodSelectStatistics stats;
+	stats.Items = count;
+
+	XMVECTOR eyeX = XMVectorReplicate(view.EyePos.x);
+	XMVECTOR eyeY = XMVectorReplicate(view.EyePos.y);
+	XMVECTOR eyeZ = XMVectorReplicate(view.EyePos.z);
+	XMVECTOR nearZ = XMVectorReplicate(view.NearZ);
+	XMVECTOR pixelsPerUnit = XMVectorReplicate(view.PixelsPerUnit);
+	float coarserThreshold = threshold * (1.0f - hysteresis);
+
+	for (size_t first = 0; first < count; first += 4)
+	{
+		size_t batch = std::min<size_t>(4, count - first);
+
+		// World bounds of four items side by side; unused lanes sit on the eye.
+		XMFLOAT4 x(view.EyePos.x, view.EyePos.x, view.EyePos.x, view.EyePos.x);
+		XMFLOAT4 y(view.EyePos.y, view.EyePos.y, view.EyePos.y, view.EyePos.y);
+		XMFLOAT4 z(view.EyePos.z, view.EyePos.z, view.EyePos.z, view.EyePos.z);
+		XMFLOAT4 radius(0.0f, 0.0f, 0.0f, 0.0f);
+		XMFLOAT4 scale(1.0f, 1.0f, 1.0f, 1.0f);
+		for (size_t i = 0; i < batch; ++i)
+		{
+			const RenderItem* item = items[first + i];
+			XMMATRIX world = XMLoadFloat4x4(&item->World);
+			XMVECTOR center = XMVector3Transform(XMLoadFloat3(&item->Bounds.Center), world);
+			// The longest axis bounds both the world radius and the world size of an error.
+			XMVECTOR axis = XMVectorMax(XMVector3LengthSq(world.r[0]),
+				XMVectorMax(XMVector3LengthSq(world.r[1]), XMVector3LengthSq(world.r[2])));
+			float s = XMVectorGetX(XMVectorSqrt(axis));
+			(&x.x)[i] = XMVectorGetX(center);
+			(&y.x)[i] = XMVectorGetY(center);
+			(&z.x)[i] = XMVectorGetZ(center);
+			(&radius.x)[i] = item->Bounds.Radius * s;
+			(&scale.x)[i] = s;
+		}
+
+		XMVECTOR dx = XMVectorSubtract(XMLoadFloat4(&x), eyeX);
+		XMVECTOR dy = XMVectorSubtract(XMLoadFloat4(&y), eyeY);
+		XMVECTOR dz = XMVectorSubtract(XMLoadFloat4(&z), eyeZ);
+		XMVECTOR distance = XMVectorSqrt(XMVectorMultiplyAdd(dx, dx, XMVectorMultiplyAdd(dy, dy, XMVectorMultiply(dz, dz))));
+		// Errors are measured at the point of the sphere nearest the eye, which is the
+		// largest they can appear anywhere on the item.
+		XMVECTOR nearest = XMVectorMax(XMVectorSubtract(distance, XMLoadFloat4(&radius)), nearZ);
+		XMFLOAT4 pixelsPerError;
+		XMStoreFloat4(&pixelsPerError, XMVectorDivide(XMVectorMultiply(pixelsPerUnit, XMLoadFloat4(&scale)), nearest));
+
+		for (size_t i = 0; i < batch; ++i)
+		{
+			RenderItem* item = items[first + i];
+			if (item->Lods.empty())
+			{
+				stats.Triangles += item->IndexCount / 3;
+				stats.FullTriangles += item->IndexCount / 3;
+				continue;
+			}
+
+			UINT level = PickLevel(item->Lods, item->CurrentLod, (&pixelsPerError.x)[i], threshold, coarserThreshold);
+			if (level != item->CurrentLod)
+				++stats.Switched;
+			const RenderItemLod& lod = item->Lods[level];
+			item->CurrentLod = level;
+			item->IndexCount = lod.IndexCount;
+			item->StartIndexLocation = lod.StartIndexLocation;
+			stats.Triangles += lod.IndexCount / 3;
+			stats.FullTriangles += item->Lods[0].IndexCount / 3;
+		}
+	}
+	return stats;
+}
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// per-frame level of detail selection by screen-space error
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "RenderItem.h"
+#include "Camera.h"
+#include <vector>
+
+// What the selector needs to know about the camera.
+struct LodView
+{
+	DirectX::XMFLOAT3 EyePos = { 0.0f, 0.0f, 0.0f };
+	// Pixels covered by one world unit seen face-on at distance 1: the viewport height
+	// over the height of the view volume at that distance.
+	float PixelsPerUnit = 1.0f;
+	// Items closer than this are treated as being this far away.
+	float NearZ = 1.0f;
+};
+
+struct LodSelectStatistics
+{
+	size_t Items = 0;
+	// Items whose level changed.
+	size_t Switched = 0;
+	// Triangles drawn at the chosen levels, and at full detail.
+	size_t Triangles = 0;
+	size_t FullTriangles = 0;
+};
+
+// Picks for each item the coarsest level whose error, projected from the near side of
+// its bounding sphere, stays under a threshold in pixels.  Hysteresis keeps an item on
+// its level until the threshold is crossed by a margin, so one that sits at a switch
+// distance does not pop back and forth.  Items are processed four at a time.
+class LodSelector
+{
+public:
+	static constexpr float DefaultThreshold = 1.0f;
+	// An item only moves to a coarser level once that level's error is below
+	// (1 - hysteresis) of the threshold; it moves finer as soon as it is above it.
+	static constexpr float DefaultHysteresis = 0.25f;
+
+	static LodView MakeView(const Camera& camera, float viewportHeight);
+
+	// Items without levels are left alone.
+	static LodSelectStatistics Select(RenderItem* const* items, size_t count, const LodView& view,
+		float threshold = DefaultThreshold, float hysteresis = DefaultHysteresis);
+};
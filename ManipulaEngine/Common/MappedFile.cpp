@@ -0,0 +1,151 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+{
+	*this = std::move(rhs);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		Close();
+#ifdef _WIN32
+		std::swap(mFile, rhs.mFile);
+		std::swap(mMapping, rhs.mMapping);
+#else
+		std::swap(mFd, rhs.mFd);
+#endif
+		std::swap(mData, rhs.mData);
+		std::swap(mSize, rhs.mSize);
+		std::swap(mOpen, rhs.mOpen);
+	}
+	return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	Close();
+
+	mFile = CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(mFile, &size))
+	{
+		Close();
+		return false;
+	}
+
+	mOpen = true;
+	mSize = (size_t)size.QuadPart;
+	// CreateFileMapping refuses zero-length files.
+	if (mSize == 0)
+		return true;
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle(mMapping);
+	if (mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+
+	mFile = INVALID_HANDLE_VALUE;
+	mMapping = nullptr;
+	mData = nullptr;
+	mSize = 0;
+	mOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const wchar_t* fileName)
+{
+	Close();
+
+	std::string path(std::wcslen(fileName) * MB_CUR_MAX + 1, '\0');
+	size_t len = std::wcstombs(&path[0], fileName, path.size());
+	if (len == (size_t)-1)
+		return false;
+	path.resize(len);
+
+	mFd = open(path.c_str(), O_RDONLY);
+	if (mFd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(mFd, &st) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	mOpen = true;
+	mSize = (size_t)st.st_size;
+	if (mSize == 0)
+		return true;
+
+	void* p = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+	if (p == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	madvise(p, mSize, MADV_SEQUENTIAL);
+	mData = static_cast<const char*>(p);
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mData)
+		munmap(const_cast<char*>(mData), mSize);
+	if (mFd >= 0)
+		close(mFd);
+
+	mFd = -1;
+	mData = nullptr;
+	mSize = 0;
+	mOpen = false;
+}
+
+#endif
@@ -0,0 +1,45 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// read-only memory mapping of a whole file
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& rhs) noexcept;
+	MappedFile& operator=(MappedFile&& rhs) noexcept;
+
+	// Maps the whole file read-only.  An empty file opens successfully with Size() == 0.
+	bool Open(const wchar_t* fileName);
+	void Close();
+
+	bool IsOpen()const { return mOpen; }
+	const char* Data()const { return mData; }
+	size_t Size()const { return mSize; }
+	const char* End()const { return mData + mSize; }
+
+private:
+#ifdef _WIN32
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+#else
+	int mFd = -1;
+#endif
+	const char* mData = nullptr;
+	size_t mSize = 0;
+	bool mOpen = false;
+};
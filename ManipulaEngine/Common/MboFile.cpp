@@ -0,0 +1,448 @@
+#include "MboFile.h"
+#include "MeshCodec.h"
+#include <cstring>
+#include <fstream>
+
+using namespace DirectX;
+
+namespace
+{
+	std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+MboMaterial ToMboMaterial(const Material& material)
+{
+	MboMaterial mboMaterial;
+	mboMaterial.BaseColor = material.BaseColor;
+	mboMaterial.DiffuseAlbedo = material.DiffuseAlbedo;
+	mboMaterial.FresnelR0 = material.FresnelR0;
+	mboMaterial.Roughness = material.Roughness;
+	mboMaterial.AmbientColor = material.AmbientColor;
+	mboMaterial.SpecularStrength = material.SpecularStrength;
+	mboMaterial.MatTransform = material.MatTransform;
+	return mboMaterial;
+}
+
+void FromMboMaterial(const MboMaterial& mboMaterial, Material& material)
+{
+	material.BaseColor = mboMaterial.BaseColor;
+	material.DiffuseAlbedo = mboMaterial.DiffuseAlbedo;
+	material.FresnelR0 = mboMaterial.FresnelR0;
+	material.Roughness = mboMaterial.Roughness;
+	material.AmbientColor = mboMaterial.AmbientColor;
+	material.SpecularStrength = mboMaterial.SpecularStrength;
+	material.MatTransform = mboMaterial.MatTransform;
+}
+
+bool MboFile::IsMboV2(const wchar_t* mboFileName)
+{
+	std::ifstream fin(mboFileName, std::ios::in | std::ios::binary);
+	std::uint32_t magic = 0;
+	fin.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	return fin && magic == MboMagic;
+}
+
+bool MboFile::Open(const wchar_t* mboFileName)
+{
+	Close();
+
+	if (!mFile.Open(mboFileName) || mFile.Size() < sizeof(MboHeader))
+	{
+		Close();
+		return false;
+	}
+
+	mHeader = reinterpret_cast<const MboHeader*>(mFile.Data());
+	if (mHeader->Magic != MboMagic || mHeader->Version != MboVersion || mHeader->FileSize != mFile.Size() ||
+		mHeader->SectionCount > (mFile.Size() - sizeof(MboHeader)) / sizeof(MboSection))
+	{
+		Close();
+		return false;
+	}
+
+	mSections.Data = reinterpret_cast<const MboSection*>(mFile.Data() + sizeof(MboHeader));
+	mSections.Count = mHeader->SectionCount;
+	for (const MboSection& section : mSections)
+	{
+		if (section.Offset % MboSectionAlignment != 0 || section.Stride == 0 ||
+			section.Offset > mFile.Size() || section.Size > mFile.Size() - section.Offset ||
+			section.Size % section.Stride != 0)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	mParts = TypedSection<MboPart>(MboSectionType::Parts);
+	mVertices = TypedSection<VertexPosNormalTex>(MboSectionType::Vertices);
+	mQuantizedVertices = TypedSection<VertexPosNormalTexQuantized>(MboSectionType::QuantizedVertices);
+	mBounds = TypedSection<QuantizationBounds>(MboSectionType::QuantizationBounds);
+	mIndices16 = TypedSection<WORD>(MboSectionType::Indices16);
+	mIndices32 = TypedSection<DWORD>(MboSectionType::Indices32);
+	mStrings = TypedSection<char>(MboSectionType::Strings);
+	mMeshletRanges = TypedSection<MboMeshletRange>(MboSectionType::MeshletRanges);
+	mMeshlets.Meshlets = TypedSection<Meshlet>(MboSectionType::Meshlets);
+	mMeshlets.Vertices = TypedSection<std::uint32_t>(MboSectionType::MeshletVertices);
+	mMeshlets.Triangles = TypedSection<std::uint32_t>(MboSectionType::MeshletTriangles);
+	mMeshlets.Spheres = TypedSection<XMFLOAT4>(MboSectionType::MeshletSpheres);
+	mMeshlets.BoxCenters = TypedSection<XMFLOAT3>(MboSectionType::MeshletBoxCenters);
+	mMeshlets.BoxExtents = TypedSection<XMFLOAT3>(MboSectionType::MeshletBoxExtents);
+	mMeshlets.ConeApexes = TypedSection<XMFLOAT3>(MboSectionType::MeshletConeApexes);
+	mMeshlets.ConeAxes = TypedSection<XMFLOAT4>(MboSectionType::MeshletConeAxes);
+	mLodRanges = TypedSection<MboLodRange>(MboSectionType::LodRanges);
+	mLods = TypedSection<MboLod>(MboSectionType::Lods);
+	mClusterDagRanges = TypedSection<MboClusterDagRange>(MboSectionType::ClusterDagRanges);
+	mClusterDags.Clusters = TypedSection<ClusterDagCluster>(MboSectionType::ClusterDagClusters);
+	mClusterDags.Groups = TypedSection<ClusterDagGroup>(MboSectionType::ClusterDagGroups);
+	mClusterDags.Children = TypedSection<std::uint32_t>(MboSectionType::ClusterDagChildren);
+	mClusterDags.Indices = TypedSection<std::uint32_t>(MboSectionType::ClusterDagIndices);
+	if (!DecodeSection(MboSectionType::EncodedVertices, mDecodedVertices, mVertices) ||
+		!DecodeSection(MboSectionType::EncodedQuantizedVertices, mDecodedQuantizedVertices, mQuantizedVertices) ||
+		!DecodeSection(MboSectionType::EncodedIndices16, mDecodedIndices16, mIndices16) ||
+		!DecodeSection(MboSectionType::EncodedIndices32, mDecodedIndices32, mIndices32))
+	{
+		Close();
+		return false;
+	}
+
+	// Check every range once here so the accessors can trust them.
+	if (((!mQuantizedVertices.empty() || !mBounds.empty()) && mBounds.size() != mParts.size()) || !ValidMeshlets() || !ValidLods() ||
+		!ValidClusterDags())
+	{
+		Close();
+		return false;
+	}
+	for (const MboPart& part : mParts)
+	{
+		size_t indexLimit = part.IndexStride == sizeof(WORD) ? mIndices16.size() :
+			part.IndexStride == sizeof(DWORD) ? mIndices32.size() : 0;
+		std::uint64_t lastVertex = (std::uint64_t)part.FirstVertex + part.VertexCount;
+		if ((!mVertices.empty() && lastVertex > mVertices.size()) ||
+			(!mQuantizedVertices.empty() && lastVertex > mQuantizedVertices.size()) ||
+			(mVertices.empty() && mQuantizedVertices.empty() && part.VertexCount != 0) ||
+			(std::uint64_t)part.FirstIndex + part.IndexCount > indexLimit ||
+			!ValidString(part.Name, sizeof(char)) || !ValidString(part.Texture, sizeof(char16_t)))
+		{
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MboFile::Close()
+{
+	mFile.Close();
+	mHeader = nullptr;
+	mSections = {};
+	mParts = {};
+	mVertices = {};
+	mQuantizedVertices = {};
+	mBounds = {};
+	mIndices16 = {};
+	mIndices32 = {};
+	mStrings = {};
+	mMeshletRanges = {};
+	mMeshlets = {};
+	mLodRanges = {};
+	mLods = {};
+	mClusterDagRanges = {};
+	mClusterDags = {};
+	mDecodedVertices.clear();
+	mDecodedQuantizedVertices.clear();
+	mDecodedIndices16.clear();
+	mDecodedIndices32.clear();
+}
+
+MboSpan<std::uint8_t> MboFile::Section(MboSectionType type)const
+{
+	return TypedSection<std::uint8_t>(type);
+}
+
+template<typename T>
+MboSpan<T> MboFile::TypedSection(MboSectionType type)const
+{
+	MboSpan<T> span;
+	for (const MboSection& section : mSections)
+	{
+		if (section.Type == type)
+		{
+			span.Data = reinterpret_cast<const T*>(mFile.Data() + section.Offset);
+			span.Count = (size_t)(section.Size / sizeof(T));
+			break;
+		}
+	}
+	return span;
+}
+
+template<typename T>
+bool MboFile::DecodeSection(MboSectionType type, std::vector<std::uint8_t>& buffer, MboSpan<T>& span)
+{
+	MboSpan<std::uint8_t> encoded = Section(type);
+	if (encoded.empty())
+		return true;
+
+	size_t count, elementSize;
+	if (!MeshCodec::PeekHeader(encoded.Data, encoded.size(), count, elementSize) || elementSize != sizeof(T))
+		return false;
+	// The codec cannot expand data by more than this; reject corrupt counts before allocating.
+	const size_t maxExpansion = 4096;
+	if (count / maxExpansion > encoded.size())
+		return false;
+
+	buffer.resize(count * sizeof(T));
+	bool status = type == MboSectionType::EncodedVertices || type == MboSectionType::EncodedQuantizedVertices ?
+		MeshCodec::DecodeVertices(encoded.Data, encoded.size(), buffer.data()) :
+		MeshCodec::DecodeIndices(encoded.Data, encoded.size(), buffer.data());
+	if (!status)
+		return false;
+
+	span.Data = reinterpret_cast<const T*>(buffer.data());
+	span.Count = count;
+	return true;
+}
+
+bool MboFile::ValidString(const MboString& str, size_t charSize)const
+{
+	return (std::uint64_t)str.Offset + str.Length <= mStrings.size() && str.Length % charSize == 0;
+}
+
+bool MboFile::ValidMeshlets()const
+{
+	const MboMeshlets& m = mMeshlets;
+	size_t count = m.Meshlets.size();
+	if (mMeshletRanges.empty())
+		return count == 0;
+	if (mMeshletRanges.size() != mParts.size() || m.Spheres.size() != count || m.BoxCenters.size() != count ||
+		m.BoxExtents.size() != count || m.ConeApexes.size() != count || m.ConeAxes.size() != count)
+		return false;
+
+	for (const MboMeshletRange& range : mMeshletRanges)
+	{
+		if ((std::uint64_t)range.FirstMeshlet + range.MeshletCount > count)
+			return false;
+	}
+	for (const Meshlet& meshlet : m.Meshlets)
+	{
+		if ((std::uint64_t)meshlet.VertexOffset + meshlet.VertexCount > m.Vertices.size() ||
+			(std::uint64_t)meshlet.TriangleOffset + meshlet.TriangleCount > m.Triangles.size())
+			return false;
+	}
+	return true;
+}
+
+bool MboFile::ValidLods()const
+{
+	if (mLodRanges.empty())
+		return mLods.empty();
+	if (mLodRanges.size() != mParts.size())
+		return false;
+
+	for (size_t i = 0; i < mParts.size(); ++i)
+	{
+		const MboLodRange& range = mLodRanges[i];
+		if ((std::uint64_t)range.FirstLod + range.LodCount > mLods.size())
+			return false;
+		size_t indexLimit = mParts[i].IndexStride == sizeof(WORD) ? mIndices16.size() :
+			mParts[i].IndexStride == sizeof(DWORD) ? mIndices32.size() : 0;
+		for (UINT lod = range.FirstLod; lod < range.FirstLod + range.LodCount; ++lod)
+		{
+			if ((std::uint64_t)mLods[lod].FirstIndex + mLods[lod].IndexCount > indexLimit)
+				return false;
+		}
+	}
+	return true;
+}
+
+bool MboFile::ValidClusterDags()const
+{
+	const MboClusterDags& d = mClusterDags;
+	if (mClusterDagRanges.empty())
+		return d.Clusters.empty() && d.Groups.empty();
+	if (mClusterDagRanges.size() != mParts.size())
+		return false;
+
+	for (size_t i = 0; i < mParts.size(); ++i)
+	{
+		const MboClusterDagRange& range = mClusterDagRanges[i];
+		if ((std::uint64_t)range.FirstCluster + range.ClusterCount > d.Clusters.size() ||
+			(std::uint64_t)range.FirstGroup + range.GroupCount > d.Groups.size() ||
+			(std::uint64_t)range.FirstChild + range.ChildCount > d.Children.size() ||
+			(std::uint64_t)range.FirstIndex + range.IndexCount > d.Indices.size())
+			return false;
+
+		for (UINT c = range.FirstCluster; c < range.FirstCluster + range.ClusterCount; ++c)
+		{
+			const ClusterDagCluster& cluster = d.Clusters[c];
+			if ((std::uint64_t)cluster.FirstIndex + cluster.IndexCount > range.IndexCount ||
+				(cluster.Group != ClusterDag::NoGroup && cluster.Group >= range.GroupCount) ||
+				(cluster.ParentGroup != ClusterDag::NoGroup && cluster.ParentGroup >= range.GroupCount))
+				return false;
+		}
+		for (UINT g = range.FirstGroup; g < range.FirstGroup + range.GroupCount; ++g)
+		{
+			const ClusterDagGroup& group = d.Groups[g];
+			if ((std::uint64_t)group.FirstChild + group.ChildCount > range.ChildCount ||
+				(std::uint64_t)group.FirstCluster + group.ClusterCount > range.ClusterCount)
+				return false;
+		}
+		for (UINT c = range.FirstChild; c < range.FirstChild + range.ChildCount; ++c)
+		{
+			if (d.Children[c] >= range.ClusterCount)
+				return false;
+		}
+		for (UINT v = range.FirstIndex; v < range.FirstIndex + range.IndexCount; ++v)
+		{
+			if (d.Indices[v] >= mParts[i].VertexCount)
+				return false;
+		}
+	}
+	return true;
+}
+
+std::string_view MboFile::PartName(UINT i)const
+{
+	const MboString& name = mParts[i].Name;
+	return std::string_view(mStrings.Data + name.Offset, name.Length);
+}
+
+std::wstring MboFile::PartTexture(UINT i)const
+{
+	const MboString& texture = mParts[i].Texture;
+	std::wstring str(texture.Length / sizeof(char16_t), L'\0');
+	for (size_t c = 0; c < str.size(); ++c)
+	{
+		char16_t ch;
+		std::memcpy(&ch, mStrings.Data + texture.Offset + c * sizeof(char16_t), sizeof(char16_t));
+		str[c] = (wchar_t)ch;
+	}
+	return str;
+}
+
+MboSpan<VertexPosNormalTex> MboFile::Vertices(UINT i)const
+{
+	if (mVertices.empty())
+		return {};
+	return { mVertices.Data + mParts[i].FirstVertex, mParts[i].VertexCount };
+}
+
+MboSpan<VertexPosNormalTexQuantized> MboFile::QuantizedVertices(UINT i)const
+{
+	if (mQuantizedVertices.empty())
+		return {};
+	return { mQuantizedVertices.Data + mParts[i].FirstVertex, mParts[i].VertexCount };
+}
+
+MboSpan<WORD> MboFile::Indices16(UINT i)const
+{
+	if (mParts[i].IndexStride != sizeof(WORD))
+		return {};
+	return { mIndices16.Data + mParts[i].FirstIndex, mParts[i].IndexCount };
+}
+
+MboSpan<DWORD> MboFile::Indices32(UINT i)const
+{
+	if (mParts[i].IndexStride != sizeof(DWORD))
+		return {};
+	return { mIndices32.Data + mParts[i].FirstIndex, mParts[i].IndexCount };
+}
+
+MboSpan<WORD> MboFile::LodIndices16(UINT i, UINT lod)const
+{
+	if (mParts[i].IndexStride != sizeof(WORD))
+		return {};
+	const MboLod& l = mLods[mLodRanges[i].FirstLod + lod];
+	return { mIndices16.Data + l.FirstIndex, l.IndexCount };
+}
+
+MboSpan<DWORD> MboFile::LodIndices32(UINT i, UINT lod)const
+{
+	if (mParts[i].IndexStride != sizeof(DWORD))
+		return {};
+	const MboLod& l = mLods[mLodRanges[i].FirstLod + lod];
+	return { mIndices32.Data + l.FirstIndex, l.IndexCount };
+}
+
+MboString MboWriter::AddString(const void* data, size_t bytes)
+{
+	MboString str = { (std::uint32_t)mStrings.size(), (std::uint32_t)bytes };
+	const std::uint8_t* src = static_cast<const std::uint8_t*>(data);
+	mStrings.insert(mStrings.end(), src, src + bytes);
+	return str;
+}
+
+void MboWriter::AddSection(MboSectionType type, std::uint32_t stride, const void* data, size_t bytes)
+{
+	const std::uint8_t* src = static_cast<const std::uint8_t*>(data);
+	mSections.push_back({ type, stride, std::vector<std::uint8_t>(src, src + bytes) });
+}
+
+bool MboWriter::Write(const wchar_t* mboFileName, const XMFLOAT3& vMin, const XMFLOAT3& vMax)const
+{
+	// Compressed sections live in their own storage; keep it stable while writing.
+	std::vector<PendingSection> encodedSections;
+	encodedSections.reserve(mSections.size());
+
+	// The string table goes last so that AddString may be called after AddSection.
+	std::vector<const PendingSection*> sections;
+	for (const PendingSection& section : mSections)
+	{
+		bool isVertices = section.type == MboSectionType::Vertices || section.type == MboSectionType::QuantizedVertices;
+		bool isIndices = section.type == MboSectionType::Indices16 || section.type == MboSectionType::Indices32;
+		if (!mCompress || !(isVertices || isIndices))
+		{
+			sections.push_back(&section);
+			continue;
+		}
+
+		PendingSection encoded = { (MboSectionType)((std::uint32_t)section.type | 0x100), 1, {} };
+		size_t count = section.data.size() / section.stride;
+		if (isVertices)
+			MeshCodec::EncodeVertices(section.data.data(), count, section.stride, encoded.data);
+		else
+			MeshCodec::EncodeIndices(section.data.data(), count, section.stride, encoded.data);
+		encodedSections.push_back(std::move(encoded));
+		sections.push_back(&encodedSections.back());
+	}
+	PendingSection strings = { MboSectionType::Strings, 1, mStrings };
+	sections.push_back(&strings);
+
+	std::vector<MboSection> toc;
+	std::uint64_t offset = AlignUp(sizeof(MboHeader) + sections.size() * sizeof(MboSection), MboSectionAlignment);
+	for (const PendingSection* section : sections)
+	{
+		toc.push_back({ section->type, section->stride, offset, section->data.size() });
+		offset = AlignUp(offset + section->data.size(), MboSectionAlignment);
+	}
+
+	MboHeader header = {};
+	header.Magic = MboMagic;
+	header.Version = MboVersion;
+	header.SectionCount = (std::uint32_t)toc.size();
+	header.Flags = encodedSections.empty() ? 0 : MboFlagCompressed;
+	header.VMin = vMin;
+	header.VMax = vMax;
+	header.FileSize = offset;
+
+	std::ofstream fout(mboFileName, std::ios::out | std::ios::binary);
+	if (!fout.is_open())
+		return false;
+
+	static const char padding[MboSectionAlignment] = {};
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(MboSection));
+	std::uint64_t written = sizeof(header) + toc.size() * sizeof(MboSection);
+	for (size_t i = 0; i < sections.size(); ++i)
+	{
+		fout.write(padding, (std::streamsize)(toc[i].Offset - written));
+		fout.write(reinterpret_cast<const char*>(sections[i]->data.data()), sections[i]->data.size());
+		written = toc[i].Offset + toc[i].Size;
+	}
+	fout.write(padding, (std::streamsize)(offset - written));
+
+	return (bool)fout;
+}
@@ -0,0 +1,307 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MBO v2 mesh container
+//
+// [MboHeader]
+// [MboSection] * SectionCount      table of contents
+// [section data]                   every section starts on a 64-byte boundary
+//
+// The vertex and index sections are stored exactly as they are uploaded, so a
+// memory-mapped file can hand them out in place without copying.
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "d3dUtil.h"
+#include "MappedFile.h"
+#include "ClusterDag.h"
+#include "Meshlet.h"
+#include "VertexQuantization.h"
+#include <cstdint>
+#include <string_view>
+
+// "MBO\0".  A v1 file starts with its part count, which never reaches this value.
+const std::uint32_t MboMagic = 0x004F424D;
+const std::uint32_t MboVersion = 2;
+const std::uint64_t MboSectionAlignment = 64;
+
+enum class MboSectionType : std::uint32_t
+{
+	Parts = 1,       // MboPart[]
+	Vertices = 2,    // VertexPosNormalTex[] of every part, back to back
+	Indices16 = 3,   // WORD[] of the parts with IndexStride 2
+	Indices32 = 4,   // DWORD[] of the parts with IndexStride 4
+	Strings = 5,     // bytes referenced by MboString
+	// Written instead of Vertices by a quantizing writer; both use FirstVertex/VertexCount.
+	QuantizedVertices = 6,   // VertexPosNormalTexQuantized[]
+	QuantizationBounds = 7,  // QuantizationBounds[], one per part
+	// Meshlets of every part back to back, see Meshlet.h.  The arrays from MeshletSpheres on
+	// are parallel to Meshlets; Meshlet offsets index the whole vertex and triangle arrays.
+	MeshletRanges = 8,       // MboMeshletRange[], one per part
+	Meshlets = 9,            // Meshlet[]
+	MeshletVertices = 10,    // std::uint32_t[], part-local vertex numbers
+	MeshletTriangles = 11,   // std::uint32_t[], packed corners
+	MeshletSpheres = 12,     // XMFLOAT4[]
+	MeshletBoxCenters = 13,  // XMFLOAT3[]
+	MeshletBoxExtents = 14,  // XMFLOAT3[]
+	MeshletConeApexes = 15,  // XMFLOAT3[]
+	MeshletConeAxes = 16,    // XMFLOAT4[]
+	// Simplified index buffers of every part back to back.  Their indices live in the
+	// index section of their part's IndexStride, after the indices of that part.
+	LodRanges = 17,          // MboLodRange[], one per part
+	Lods = 18,               // MboLod[]
+	// Cluster DAGs of every part back to back, see ClusterDag.h.  Numbers inside the
+	// records are local to the part's ranges; indices are part-local vertex numbers.
+	ClusterDagRanges = 19,   // MboClusterDagRange[], one per part
+	ClusterDagClusters = 20, // ClusterDagCluster[]
+	ClusterDagGroups = 21,   // ClusterDagGroup[]
+	ClusterDagChildren = 22, // std::uint32_t[]
+	ClusterDagIndices = 23,  // std::uint32_t[]
+
+	// MeshCodec streams of the section type in the low byte, written by a compressing
+	// MboWriter.  MboFile decodes them on open and serves the same spans.
+	EncodedVertices = 0x102,
+	EncodedIndices16 = 0x103,
+	EncodedIndices32 = 0x104,
+	EncodedQuantizedVertices = 0x106,
+};
+
+// MboHeader::Flags
+const std::uint32_t MboFlagCompressed = 0x1;
+
+struct MboHeader
+{
+	std::uint32_t Magic;
+	std::uint32_t Version;
+	std::uint32_t SectionCount;
+	std::uint32_t Flags;
+	DirectX::XMFLOAT3 VMin;
+	DirectX::XMFLOAT3 VMax;
+	std::uint64_t FileSize;
+};
+
+struct MboSection
+{
+	MboSectionType Type;
+	// Element size in bytes, 1 for untyped data.
+	std::uint32_t Stride;
+	std::uint64_t Offset;
+	std::uint64_t Size;
+};
+
+// Byte range in the Strings section.  Length is in bytes.
+struct MboString
+{
+	std::uint32_t Offset;
+	std::uint32_t Length;
+};
+
+// The shading fields of Material.
+struct MboMaterial
+{
+	DirectX::XMFLOAT4 BaseColor;
+	DirectX::XMFLOAT4 DiffuseAlbedo;
+	DirectX::XMFLOAT3 FresnelR0;
+	float Roughness;
+	DirectX::XMFLOAT4 AmbientColor;
+	DirectX::XMFLOAT4 SpecularStrength;
+	DirectX::XMFLOAT4X4 MatTransform;
+};
+
+struct MboPart
+{
+	MboMaterial Material;
+	// Part name as written in the OBJ file, texture path as UTF-16.
+	MboString Name;
+	MboString Texture;
+	// Ranges in the Vertices section and in the index section selected by IndexStride.
+	std::uint32_t FirstVertex;
+	std::uint32_t VertexCount;
+	std::uint32_t FirstIndex;
+	std::uint32_t IndexCount;
+	std::uint32_t IndexStride;
+	std::uint32_t Reserved;
+};
+
+struct MboMeshletRange
+{
+	std::uint32_t FirstMeshlet;
+	std::uint32_t MeshletCount;
+};
+
+struct MboLodRange
+{
+	std::uint32_t FirstLod;
+	std::uint32_t LodCount;
+};
+
+struct MboLod
+{
+	// Range in the index section selected by the part's IndexStride.
+	std::uint32_t FirstIndex;
+	std::uint32_t IndexCount;
+	// Deviation from the full part in model units, see ObjReader::ObjLod.
+	float Error;
+	std::uint32_t Reserved;
+};
+
+struct MboClusterDagRange
+{
+	std::uint32_t FirstCluster;
+	std::uint32_t ClusterCount;
+	std::uint32_t FirstGroup;
+	std::uint32_t GroupCount;
+	std::uint32_t FirstChild;
+	std::uint32_t ChildCount;
+	std::uint32_t FirstIndex;
+	std::uint32_t IndexCount;
+};
+
+static_assert(sizeof(MboHeader) == 48, "MboHeader layout");
+static_assert(sizeof(MboSection) == 24, "MboSection layout");
+static_assert(sizeof(MboPart) == 184, "MboPart layout");
+
+MboMaterial ToMboMaterial(const Material& material);
+void FromMboMaterial(const MboMaterial& mboMaterial, Material& material);
+
+// Read-only view of an array inside a mapped file.
+template<typename T>
+struct MboSpan
+{
+	const T* Data = nullptr;
+	size_t Count = 0;
+
+	const T* begin()const { return Data; }
+	const T* end()const { return Data + Count; }
+	size_t size()const { return Count; }
+	bool empty()const { return Count == 0; }
+	const T& operator[](size_t i)const { return Data[i]; }
+};
+
+// The meshlet sections of a file as spans.
+struct MboMeshlets
+{
+	MboSpan<Meshlet> Meshlets;
+	MboSpan<std::uint32_t> Vertices;
+	MboSpan<std::uint32_t> Triangles;
+	MboSpan<DirectX::XMFLOAT4> Spheres;
+	MboSpan<DirectX::XMFLOAT3> BoxCenters;
+	MboSpan<DirectX::XMFLOAT3> BoxExtents;
+	MboSpan<DirectX::XMFLOAT3> ConeApexes;
+	MboSpan<DirectX::XMFLOAT4> ConeAxes;
+};
+
+// The cluster DAG sections of a file as spans.
+struct MboClusterDags
+{
+	MboSpan<ClusterDagCluster> Clusters;
+	MboSpan<ClusterDagGroup> Groups;
+	MboSpan<std::uint32_t> Children;
+	MboSpan<std::uint32_t> Indices;
+};
+
+// Maps an MBO v2 file and exposes its sections in place.  The spans stay valid
+// until the MboFile is closed or destroyed.  Compressed vertex and index sections
+// are decoded once in Open, so only uncompressed files are truly zero-copy.
+class MboFile
+{
+public:
+	// Fails on v1 files and on any header, section or part range that does not fit.
+	bool Open(const wchar_t* mboFileName);
+	void Close();
+
+	const MboHeader& Header()const { return *mHeader; }
+	// Raw bytes of the first section of the given type; empty if there is none.
+	MboSpan<std::uint8_t> Section(MboSectionType type)const;
+
+	UINT PartCount()const { return (UINT)mParts.size(); }
+	const MboPart& Part(UINT i)const { return mParts[i]; }
+	std::string_view PartName(UINT i)const;
+	std::wstring PartTexture(UINT i)const;
+	MboSpan<VertexPosNormalTex> Vertices(UINT i)const;
+	// Quantized files have these instead of Vertices(i).
+	bool IsQuantized()const { return !mBounds.empty(); }
+	MboSpan<VertexPosNormalTexQuantized> QuantizedVertices(UINT i)const;
+	const QuantizationBounds& PartBounds(UINT i)const { return mBounds[i]; }
+	// Only the span matching Part(i).IndexStride is non-empty.
+	MboSpan<WORD> Indices16(UINT i)const;
+	MboSpan<DWORD> Indices32(UINT i)const;
+	// Files cooked with meshlets have a range per part into Meshlets().
+	bool HasMeshlets()const { return !mMeshletRanges.empty(); }
+	const MboMeshletRange& MeshletRange(UINT i)const { return mMeshletRanges[i]; }
+	const MboMeshlets& Meshlets()const { return mMeshlets; }
+	// Files cooked with LODs have a range per part into Lod(); lod counts from 0 within
+	// the part in LodIndices16/32.
+	bool HasLods()const { return !mLodRanges.empty(); }
+	const MboLodRange& LodRange(UINT i)const { return mLodRanges[i]; }
+	const MboLod& Lod(UINT i)const { return mLods[i]; }
+	MboSpan<WORD> LodIndices16(UINT i, UINT lod)const;
+	MboSpan<DWORD> LodIndices32(UINT i, UINT lod)const;
+	// Files cooked with cluster DAGs have a range per part into each ClusterDags() span.
+	bool HasClusterDags()const { return !mClusterDagRanges.empty(); }
+	const MboClusterDagRange& ClusterDagRange(UINT i)const { return mClusterDagRanges[i]; }
+	const MboClusterDags& ClusterDags()const { return mClusterDags; }
+
+	// True if the file starts with the v2 magic.
+	static bool IsMboV2(const wchar_t* mboFileName);
+
+private:
+	template<typename T>
+	MboSpan<T> TypedSection(MboSectionType type)const;
+	// Decodes the encoded twin of a section into buffer and returns it as a span.
+	template<typename T>
+	bool DecodeSection(MboSectionType type, std::vector<std::uint8_t>& buffer, MboSpan<T>& span);
+	bool ValidString(const MboString& str, size_t charSize)const;
+	bool ValidMeshlets()const;
+	bool ValidLods()const;
+	bool ValidClusterDags()const;
+
+	MappedFile mFile;
+	const MboHeader* mHeader = nullptr;
+	MboSpan<MboSection> mSections;
+	MboSpan<MboPart> mParts;
+	MboSpan<VertexPosNormalTex> mVertices;
+	MboSpan<VertexPosNormalTexQuantized> mQuantizedVertices;
+	MboSpan<QuantizationBounds> mBounds;
+	MboSpan<WORD> mIndices16;
+	MboSpan<DWORD> mIndices32;
+	MboSpan<char> mStrings;
+	MboSpan<MboMeshletRange> mMeshletRanges;
+	MboMeshlets mMeshlets;
+	MboSpan<MboLodRange> mLodRanges;
+	MboSpan<MboLod> mLods;
+	MboSpan<MboClusterDagRange> mClusterDagRanges;
+	MboClusterDags mClusterDags;
+
+	// Backing store of decoded sections; empty for uncompressed files.
+	std::vector<std::uint8_t> mDecodedVertices;
+	std::vector<std::uint8_t> mDecodedQuantizedVertices;
+	std::vector<std::uint8_t> mDecodedIndices16;
+	std::vector<std::uint8_t> mDecodedIndices32;
+};
+
+// Collects sections and writes them as an MBO v2 file.
+class MboWriter
+{
+public:
+	// Copies the bytes into the Strings section and returns their range.
+	MboString AddString(const void* data, size_t bytes);
+	void AddSection(MboSectionType type, std::uint32_t stride, const void* data, size_t bytes);
+
+	// Stores the vertex and index sections as MeshCodec streams.  This trades the
+	// zero-copy load for a much smaller file.
+	void SetCompression(bool compress) { mCompress = compress; }
+
+	bool Write(const wchar_t* mboFileName, const DirectX::XMFLOAT3& vMin, const DirectX::XMFLOAT3& vMax)const;
+
+private:
+	struct PendingSection
+	{
+		MboSectionType type;
+		std::uint32_t stride;
+		std::vector<std::uint8_t> data;
+	};
+	std::vector<PendingSection> mSections;
+	std::vector<std::uint8_t> mStrings;
+	bool mCompress = false;
+};
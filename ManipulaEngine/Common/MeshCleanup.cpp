@@ -0,0 +1,257 @@
+#include "MeshCleanup.h"
+#include "FlatHashMap.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct CellHash
+	{
+		size_t operator()(std::uint64_t key)const
+		{
+			key *= 0x9E3779B97F4A7C15ull;
+			return (size_t)(key ^ (key >> 29));
+		}
+	};
+
+	// Corners rotated so the smallest comes first, which keeps the winding.
+	struct TriangleKey
+	{
+		std::uint32_t a, b, c;
+		bool operator==(const TriangleKey& rhs)const { return a == rhs.a && b == rhs.b && c == rhs.c; }
+	};
+
+	struct TriangleKeyHash
+	{
+		size_t operator()(const TriangleKey& key)const
+		{
+			std::uint64_t h = key.a * 0x9E3779B97F4A7C15ull;
+			h = (h ^ key.b) * 0xC2B2AE3D27D4EB4Full;
+			h = (h ^ key.c) * 0x165667B19E3779F9ull;
+			return (size_t)(h ^ (h >> 29));
+		}
+	};
+
+	TriangleKey MakeTriangleKey(std::uint32_t a, std::uint32_t b, std::uint32_t c)
+	{
+		if (b < a && b < c)
+			return { b, c, a };
+		if (c < a && c < b)
+			return { c, a, b };
+		return { a, b, c };
+	}
+
+	// 21 bits per axis; cells further apart than that only share a hash bucket.
+	std::uint64_t CellKey(std::int32_t x, std::int32_t y, std::int32_t z)
+	{
+		const std::uint64_t mask = (1u << 21) - 1;
+		return ((std::uint64_t)x & mask) | (((std::uint64_t)y & mask) << 21) | (((std::uint64_t)z & mask) << 42);
+	}
+
+	template<typename Index>
+	MeshCleanupStatistics CleanImpl(void* vertices, size_t vertexCount, size_t vertexStride, Index* indices,
+		size_t indexCount, const float* attributes, size_t attributeCount, float weldTolerance,
+		float attributeTolerance, std::uint32_t* remap)
+	{
+		const std::uint32_t Removed = MeshCleanup::Removed;
+		std::uint8_t* bytes = static_cast<std::uint8_t*>(vertices);
+		auto position = [&](size_t v) -> const XMFLOAT3& {
+			return *reinterpret_cast<const XMFLOAT3*>(bytes + v * vertexStride);
+		};
+		auto attributesMatch = [&](size_t u, size_t v) {
+			const float* a = reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(attributes) + u * vertexStride);
+			const float* b = reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(attributes) + v * vertexStride);
+			for (size_t k = 0; k < attributeCount; ++k)
+			{
+				if (!(std::abs(a[k] - b[k]) <= attributeTolerance))
+					return false;
+			}
+			return true;
+		};
+
+		MeshCleanupStatistics stats;
+		size_t triangleCount = indexCount / 3;
+		stats.VerticesBefore = vertexCount;
+		stats.TrianglesBefore = triangleCount;
+		if (!attributes)
+			attributeCount = 0;
+
+		//
+		// Weld vertices through a hash grid of the vertices kept so far.
+		//
+
+		XMVECTOR lo = g_XMInfinity, hi = g_XMNegInfinity;
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			XMVECTOR p = XMLoadFloat3(&position(v));
+			lo = XMVectorMin(lo, p);
+			hi = XMVectorMax(hi, p);
+		}
+		XMFLOAT3 origin, size;
+		XMStoreFloat3(&origin, lo);
+		XMStoreFloat3(&size, XMVectorSubtract(hi, lo));
+		float extent = vertexCount ? std::max({ size.x, size.y, size.z }) : 0.0f;
+		float distance = std::max(weldTolerance, 0.0f) * extent;
+		float distanceSq = distance * distance;
+		// Cells at least as wide as the weld distance, so a weld sphere overlaps at most two
+		// per axis, but not so narrow that a tolerance of 0 puts the coordinates out of range.
+		float cellSize = std::max(distance, extent * 1e-6f);
+		float invCell = cellSize > 0.0f ? 1.0f / cellSize : 0.0f;
+		auto cell = [&](float x, float o) { return (std::int32_t)std::floor((x - o) * invCell); };
+
+		std::vector<std::uint32_t> weld(vertexCount);
+		// Kept vertices of one cell chained from the newest.
+		std::vector<std::uint32_t> next(vertexCount, Removed);
+		FlatHashMap<std::uint64_t, std::uint32_t, CellHash> cells;
+		cells.Reserve(vertexCount);
+		for (std::uint32_t v = 0; v < vertexCount; ++v)
+		{
+			const XMFLOAT3& p = position(v);
+			std::uint32_t best = Removed;
+			float bestSq = distanceSq;
+			std::int32_t x1 = cell(p.x + distance, origin.x), y1 = cell(p.y + distance, origin.y), z1 = cell(p.z + distance, origin.z);
+			for (std::int32_t z = cell(p.z - distance, origin.z); z <= z1; ++z)
+			{
+				for (std::int32_t y = cell(p.y - distance, origin.y); y <= y1; ++y)
+				{
+					for (std::int32_t x = cell(p.x - distance, origin.x); x <= x1; ++x)
+					{
+						const std::uint32_t* head = cells.Find(CellKey(x, y, z));
+						for (std::uint32_t u = head ? *head : Removed; u != Removed; u = next[u])
+						{
+							const XMFLOAT3& q = position(u);
+							float dx = q.x - p.x, dy = q.y - p.y, dz = q.z - p.z;
+							float dSq = dx * dx + dy * dy + dz * dz;
+							if (dSq > bestSq || (best != Removed && dSq == bestSq) || !attributesMatch(u, v))
+								continue;
+							best = u;
+							bestSq = dSq;
+						}
+					}
+				}
+			}
+
+			if (best != Removed)
+			{
+				weld[v] = best;
+				++stats.WeldedVertices;
+			}
+			else
+			{
+				weld[v] = v;
+				auto res = cells.Insert(CellKey(cell(p.x, origin.x), cell(p.y, origin.y), cell(p.z, origin.z)), v);
+				if (!res.second)
+				{
+					next[v] = *res.first;
+					*res.first = v;
+				}
+			}
+		}
+
+		//
+		// Remap the triangles and strip the degenerate and repeated ones.
+		//
+
+		FlatHashMap<TriangleKey, std::uint32_t, TriangleKeyHash> seen;
+		seen.Reserve(triangleCount);
+		size_t kept = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			std::uint32_t a = weld[indices[t * 3 + 0]], b = weld[indices[t * 3 + 1]], c = weld[indices[t * 3 + 2]];
+			if (a == b || b == c || c == a)
+			{
+				++stats.DegenerateTriangles;
+				continue;
+			}
+
+			// Twice the area over the longest edge is the height above it.
+			XMVECTOR pa = XMLoadFloat3(&position(a));
+			XMVECTOR ab = XMVectorSubtract(XMLoadFloat3(&position(b)), pa);
+			XMVECTOR ac = XMVectorSubtract(XMLoadFloat3(&position(c)), pa);
+			XMVECTOR bc = XMVectorSubtract(ac, ab);
+			float area = XMVectorGetX(XMVector3Length(XMVector3Cross(ab, ac)));
+			float longest = std::sqrt(std::max({ XMVectorGetX(XMVector3LengthSq(ab)), XMVectorGetX(XMVector3LengthSq(ac)),
+				XMVectorGetX(XMVector3LengthSq(bc)) }));
+			if (area <= distance * longest)
+			{
+				++stats.DegenerateTriangles;
+				continue;
+			}
+
+			if (!seen.Insert(MakeTriangleKey(a, b, c), (std::uint32_t)t).second)
+			{
+				++stats.DuplicateTriangles;
+				continue;
+			}
+
+			indices[kept * 3 + 0] = (Index)a;
+			indices[kept * 3 + 1] = (Index)b;
+			indices[kept * 3 + 2] = (Index)c;
+			++kept;
+		}
+
+		//
+		// Compact the vertices still in use, keeping their order.
+		//
+
+		std::vector<std::uint32_t> renumber(vertexCount, Removed);
+		for (size_t i = 0; i < kept * 3; ++i)
+			renumber[indices[i]] = 0;
+		std::uint32_t count = 0;
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			if (renumber[v] == Removed)
+				continue;
+			if (count != v)
+				std::memcpy(bytes + count * vertexStride, bytes + v * vertexStride, vertexStride);
+			renumber[v] = count++;
+		}
+		for (size_t i = 0; i < kept * 3; ++i)
+			indices[i] = (Index)renumber[indices[i]];
+
+		if (remap)
+		{
+			for (size_t v = 0; v < vertexCount; ++v)
+				remap[v] = renumber[weld[v]];
+		}
+
+		stats.VerticesAfter = count;
+		stats.TrianglesAfter = kept;
+		stats.UnusedVertices = vertexCount - stats.WeldedVertices - count;
+		return stats;
+	}
+}
+
+MeshCleanupStatistics& MeshCleanupStatistics::operator+=(const MeshCleanupStatistics& rhs)
+{
+	VerticesBefore += rhs.VerticesBefore;
+	VerticesAfter += rhs.VerticesAfter;
+	TrianglesBefore += rhs.TrianglesBefore;
+	TrianglesAfter += rhs.TrianglesAfter;
+	WeldedVertices += rhs.WeldedVertices;
+	UnusedVertices += rhs.UnusedVertices;
+	DegenerateTriangles += rhs.DegenerateTriangles;
+	DuplicateTriangles += rhs.DuplicateTriangles;
+	return *this;
+}
+
+MeshCleanupStatistics MeshCleanup::Clean(void* vertices, size_t vertexCount, size_t vertexStride,
+	std::uint16_t* indices, size_t indexCount, const float* attributes, size_t attributeCount,
+	float weldTolerance, float attributeTolerance, std::uint32_t* remap)
+{
+	return CleanImpl(vertices, vertexCount, vertexStride, indices, indexCount, attributes, attributeCount,
+		weldTolerance, attributeTolerance, remap);
+}
+
+MeshCleanupStatistics MeshCleanup::Clean(void* vertices, size_t vertexCount, size_t vertexStride,
+	std::uint32_t* indices, size_t indexCount, const float* attributes, size_t attributeCount,
+	float weldTolerance, float attributeTolerance, std::uint32_t* remap)
+{
+	return CleanImpl(vertices, vertexCount, vertexStride, indices, indexCount, attributes, attributeCount,
+		weldTolerance, attributeTolerance, remap);
+}
@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// vertex welding and degenerate triangle removal
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstdint>
+
+struct MeshCleanupStatistics
+{
+	size_t VerticesBefore = 0;
+	size_t VerticesAfter = 0;
+	size_t TrianglesBefore = 0;
+	size_t TrianglesAfter = 0;
+	// Vertices merged into a nearby one, and vertices no triangle used afterwards.
+	size_t WeldedVertices = 0;
+	size_t UnusedVertices = 0;
+	// Triangles with two corners on one vertex or thinner than the weld distance, and
+	// triangles with the same corners and winding as an earlier one.
+	size_t DegenerateTriangles = 0;
+	size_t DuplicateTriangles = 0;
+
+	MeshCleanupStatistics& operator+=(const MeshCleanupStatistics& rhs);
+};
+
+// Vertices are bucketed in a hash grid keyed on their position quantized to the weld
+// distance, so each vertex is only compared with the vertices of the cells its weld
+// sphere overlaps.  A vertex merges into the nearest earlier kept vertex within the weld
+// distance whose attributes all match within attributeTolerance; a kept vertex does not
+// move, so welds never chain.  Triangles are then remapped and stripped, and the vertices
+// still in use are compacted in their original order.  Triangle order and winding are
+// kept, so this can run before MeshOptimizer::Cook.
+class MeshCleanup
+{
+public:
+	// Weld distance as a fraction of the largest extent of the mesh bounds.
+	static constexpr float DefaultWeldTolerance = 1e-5f;
+	// Largest difference of any attribute component, e.g. of a normal or UV.
+	static constexpr float DefaultAttributeTolerance = 1e-3f;
+	static constexpr std::uint32_t Removed = ~0u;
+
+	// vertices holds vertexCount vertices vertexStride bytes apart, each starting with an
+	// XMFLOAT3 position; attributes, if given, is attributeCount floats at the same stride.
+	// Vertices and indices are rewritten in place; the statistics give the new counts.
+	// remap, if given, receives vertexCount entries: the new number of each old vertex, or
+	// of the vertex it was welded into, or Removed if no triangle uses it any more.
+	static MeshCleanupStatistics Clean(void* vertices, size_t vertexCount, size_t vertexStride,
+		std::uint16_t* indices, size_t indexCount, const float* attributes = nullptr, size_t attributeCount = 0,
+		float weldTolerance = DefaultWeldTolerance, float attributeTolerance = DefaultAttributeTolerance,
+		std::uint32_t* remap = nullptr);
+	static MeshCleanupStatistics Clean(void* vertices, size_t vertexCount, size_t vertexStride,
+		std::uint32_t* indices, size_t indexCount, const float* attributes = nullptr, size_t attributeCount = 0,
+		float weldTolerance = DefaultWeldTolerance, float attributeTolerance = DefaultAttributeTolerance,
+		std::uint32_t* remap = nullptr);
+};
@@ -0,0 +1,573 @@
+#include "MeshCodec.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MESH_CODEC_SSE2 1
+#endif
+
+namespace
+{
+	// [element count]8 [element size]4 [elements per block]4, then the blocks
+	const size_t HeaderSize = 16;
+
+	const size_t MinMatch = 4;
+	const size_t MaxOffset = 65535;
+	const int HashBits = 16;
+
+	void WriteHeader(std::vector<std::uint8_t>& out, std::uint64_t count, std::uint32_t elementSize, std::uint32_t blockSize)
+	{
+		std::uint8_t header[HeaderSize];
+		std::memcpy(header, &count, 8);
+		std::memcpy(header + 8, &elementSize, 4);
+		std::memcpy(header + 12, &blockSize, 4);
+		out.insert(out.end(), header, header + HeaderSize);
+	}
+
+	std::uint32_t Read32(const std::uint8_t* p)
+	{
+		std::uint32_t v;
+		std::memcpy(&v, p, 4);
+		return v;
+	}
+
+	std::uint64_t Read64(const std::uint8_t* p)
+	{
+		std::uint64_t v;
+		std::memcpy(&v, p, 8);
+		return v;
+	}
+
+	std::uint32_t HashOf(const std::uint8_t* p)
+	{
+		return (Read32(p) * 2654435761u) >> (32 - HashBits);
+	}
+
+	// LZ4 style length: 15 in the token nibble means "add the following bytes until one is < 255".
+	void WriteLength(std::vector<std::uint8_t>& out, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			out.push_back(255);
+		out.push_back((std::uint8_t)length);
+	}
+
+	bool ReadLength(const std::uint8_t*& ip, const std::uint8_t* iend, size_t& length)
+	{
+		std::uint8_t b;
+		do
+		{
+			if (ip == iend)
+				return false;
+			b = *ip++;
+			length += b;
+		} while (b == 255);
+		return true;
+	}
+
+	void EmitSequence(std::vector<std::uint8_t>& out, const std::uint8_t* literals, size_t literalCount,
+		size_t offset, size_t matchLength)
+	{
+		size_t matchCode = matchLength ? matchLength - MinMatch : 0;
+		out.push_back((std::uint8_t)((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+		if (literalCount >= 15)
+			WriteLength(out, literalCount - 15);
+		out.insert(out.end(), literals, literals + literalCount);
+		if (matchLength == 0)
+			return;
+
+		out.push_back((std::uint8_t)offset);
+		out.push_back((std::uint8_t)(offset >> 8));
+		if (matchCode >= 15)
+			WriteLength(out, matchCode - 15);
+	}
+
+	bool ReadVarint(const std::uint8_t*& p, const std::uint8_t* end, std::uint64_t& value)
+	{
+		value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (p == end)
+				return false;
+			std::uint8_t b = *p++;
+			value |= (std::uint64_t)(b & 0x7F) << shift;
+			if (!(b & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	// Streams are cut into blocks that are compressed on their own, so the decoder
+	// works on a cache-sized buffer instead of a full-size intermediate copy.
+	const std::uint32_t IndexBlockSize = 16384;
+
+	std::uint32_t VertexBlockSize(size_t stride)
+	{
+		// About 64KB of planes, in whole groups of 16 vertices.
+		return (std::uint32_t)std::max<size_t>(16, 65536 / stride / 16 * 16);
+	}
+
+	// [size before LZ]4 [size after LZ]4 [LZ data]
+	void WriteBlock(std::vector<std::uint8_t>& out, const std::vector<std::uint8_t>& raw)
+	{
+		size_t headerPos = out.size();
+		out.resize(headerPos + 8);
+		MeshCodec::LzCompress(raw.data(), raw.size(), out);
+		std::uint32_t rawSize = (std::uint32_t)raw.size();
+		std::uint32_t packedSize = (std::uint32_t)(out.size() - headerPos - 8);
+		std::memcpy(out.data() + headerPos, &rawSize, 4);
+		std::memcpy(out.data() + headerPos + 4, &packedSize, 4);
+	}
+
+	bool ReadBlock(const std::uint8_t*& ip, const std::uint8_t* iend, std::uint8_t* dst, size_t dstCapacity, size_t& rawSize)
+	{
+		if (iend - ip < 8)
+			return false;
+		rawSize = Read32(ip);
+		size_t packedSize = Read32(ip + 4);
+		ip += 8;
+		if (rawSize > dstCapacity || packedSize > (size_t)(iend - ip))
+			return false;
+		if (!MeshCodec::LzDecompress(ip, packedSize, dst, rawSize))
+			return false;
+		ip += packedSize;
+		return true;
+	}
+
+#ifdef MESH_CODEC_SSE2
+	// Adds 16 signed byte deltas to index in turn and stores the 16 running values: the
+	// deltas are widened to the index width and prefix summed within each register.
+	void StoreDeltaRun(__m128i delta, std::int64_t& index, std::uint16_t* out)
+	{
+		__m128i base = _mm_set1_epi16((short)index);
+		for (int half = 0; half < 2; ++half)
+		{
+			__m128i bytes = half ? _mm_unpackhi_epi8(delta, delta) : _mm_unpacklo_epi8(delta, delta);
+			__m128i run = _mm_srai_epi16(bytes, 8);
+			run = _mm_add_epi16(run, _mm_slli_si128(run, 2));
+			run = _mm_add_epi16(run, _mm_slli_si128(run, 4));
+			run = _mm_add_epi16(run, _mm_slli_si128(run, 8));
+			run = _mm_add_epi16(run, base);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + half * 8), run);
+			run = _mm_shufflehi_epi16(run, 0xFF);
+			base = _mm_unpackhi_epi64(run, run);
+		}
+		// Only the bits that reach the output matter.
+		index = out[15];
+	}
+
+	void StoreDeltaRun(__m128i delta, std::int64_t& index, std::uint32_t* out)
+	{
+		__m128i base = _mm_set1_epi32((int)index);
+		__m128i words[2] = {
+			_mm_srai_epi16(_mm_unpacklo_epi8(delta, delta), 8),
+			_mm_srai_epi16(_mm_unpackhi_epi8(delta, delta), 8) };
+		for (int quarter = 0; quarter < 4; ++quarter)
+		{
+			__m128i word = words[quarter / 2];
+			__m128i pairs = quarter % 2 ? _mm_unpackhi_epi16(word, word) : _mm_unpacklo_epi16(word, word);
+			__m128i run = _mm_srai_epi32(pairs, 16);
+			run = _mm_add_epi32(run, _mm_slli_si128(run, 4));
+			run = _mm_add_epi32(run, _mm_slli_si128(run, 8));
+			run = _mm_add_epi32(run, base);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + quarter * 4), run);
+			base = _mm_shuffle_epi32(run, 0xFF);
+		}
+		index = out[15];
+	}
+#endif
+
+	// Decodes exactly n indices from one block of zigzag varints.
+	template<typename T>
+	bool DecodeIndexBlock(const std::uint8_t* p, size_t size, T* out, size_t n, std::int64_t& index)
+	{
+		const std::uint8_t* end = p + size;
+		for (size_t i = 0; i < n;)
+		{
+#ifdef MESH_CODEC_SSE2
+			// Runs of 16 one-byte varints, the common case, are decoded together.
+			if (n - i >= 16 && end - p >= 16)
+			{
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				if (_mm_movemask_epi8(bytes) == 0)
+				{
+					__m128i half = _mm_and_si128(_mm_srli_epi16(bytes, 1), _mm_set1_epi8(0x7F));
+					__m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(bytes, _mm_set1_epi8(1)));
+					StoreDeltaRun(_mm_xor_si128(half, sign), index, out + i);
+					p += 16;
+					i += 16;
+					continue;
+				}
+			}
+#endif
+			std::uint64_t zigzag;
+			// Most deltas fit in one byte.
+			if (p != end && *p < 0x80)
+				zigzag = *p++;
+			else if (!ReadVarint(p, end, zigzag))
+				return false;
+			index += (std::int64_t)(zigzag >> 1) ^ -(std::int64_t)(zigzag & 1);
+			out[i++] = (T)index;
+		}
+		return p == end;
+	}
+
+#ifdef MESH_CODEC_SSE2
+	// Row k of out interleaves rows 2k and 2k + 1 of in (low halves in out[k], high
+	// halves in out[k + 8]).
+	void InterleaveBytes(const __m128i (&in)[16], __m128i (&out)[16])
+	{
+		out[0] = _mm_unpacklo_epi8(in[0], in[1]);
+		out[1] = _mm_unpacklo_epi8(in[2], in[3]);
+		out[2] = _mm_unpacklo_epi8(in[4], in[5]);
+		out[3] = _mm_unpacklo_epi8(in[6], in[7]);
+		out[4] = _mm_unpacklo_epi8(in[8], in[9]);
+		out[5] = _mm_unpacklo_epi8(in[10], in[11]);
+		out[6] = _mm_unpacklo_epi8(in[12], in[13]);
+		out[7] = _mm_unpacklo_epi8(in[14], in[15]);
+		out[8] = _mm_unpackhi_epi8(in[0], in[1]);
+		out[9] = _mm_unpackhi_epi8(in[2], in[3]);
+		out[10] = _mm_unpackhi_epi8(in[4], in[5]);
+		out[11] = _mm_unpackhi_epi8(in[6], in[7]);
+		out[12] = _mm_unpackhi_epi8(in[8], in[9]);
+		out[13] = _mm_unpackhi_epi8(in[10], in[11]);
+		out[14] = _mm_unpackhi_epi8(in[12], in[13]);
+		out[15] = _mm_unpackhi_epi8(in[14], in[15]);
+	}
+#endif
+
+	// Turns n vertices of byte-plane deltas back into interleaved vertices, carrying the
+	// per-byte running sums from block to block.
+	void UndoPlaneDeltas(const std::uint8_t* planes, size_t n, size_t stride, std::uint8_t* sums, std::uint8_t* out)
+	{
+		size_t first = 0;
+
+#ifdef MESH_CODEC_SSE2
+		// 16 vertices x 16 planes at a time: four rounds of byte interleaving transpose
+		// the block (rows come out in bit-reversed order), then each vertex row is added
+		// to the running sum and stored whole.  The rows are named one by one so that
+		// they stay in registers instead of going through memory between the rounds.
+		if (stride % 16 == 0)
+		{
+			for (size_t g = 0; g < stride / 16; ++g)
+			{
+				const std::uint8_t* groupPlanes = planes + g * 16 * n;
+				std::uint8_t* groupOut = out + g * 16;
+				__m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sums + g * 16));
+				for (first = 0; first + 16 <= n; first += 16)
+				{
+					auto load = [&](size_t k) {
+						return _mm_loadu_si128(reinterpret_cast<const __m128i*>(groupPlanes + k * n + first));
+					};
+					auto store = [&](size_t j, __m128i row) {
+						sum = _mm_add_epi8(sum, row);
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(groupOut + (first + j) * stride), sum);
+					};
+
+					__m128i rows[16] = {
+						load(0), load(8), load(4), load(12), load(2), load(10), load(6), load(14),
+						load(1), load(9), load(5), load(13), load(3), load(11), load(7), load(15) };
+					__m128i next[16];
+					InterleaveBytes(rows, next);
+					InterleaveBytes(next, rows);
+					InterleaveBytes(rows, next);
+					InterleaveBytes(next, rows);
+
+					store(0, rows[0]);
+					store(1, rows[8]);
+					store(2, rows[4]);
+					store(3, rows[12]);
+					store(4, rows[2]);
+					store(5, rows[10]);
+					store(6, rows[6]);
+					store(7, rows[14]);
+					store(8, rows[1]);
+					store(9, rows[9]);
+					store(10, rows[5]);
+					store(11, rows[13]);
+					store(12, rows[3]);
+					store(13, rows[11]);
+					store(14, rows[7]);
+					store(15, rows[15]);
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(sums + g * 16), sum);
+			}
+		}
+#endif
+
+		for (size_t k = 0; k < stride; ++k)
+		{
+			const std::uint8_t* plane = planes + k * n;
+			std::uint8_t sum = sums[k];
+			for (size_t i = first; i < n; ++i)
+			{
+				sum += plane[i];
+				out[i * stride + k] = sum;
+			}
+			sums[k] = sum;
+		}
+	}
+}
+
+void MeshCodec::LzCompress(const std::uint8_t* src, size_t size, std::vector<std::uint8_t>& out)
+{
+	std::vector<std::uint32_t> table((size_t)1 << HashBits, 0);
+
+	const std::uint8_t* ip = src;
+	const std::uint8_t* anchor = src;
+	const std::uint8_t* end = src + size;
+	// Positions from which a MinMatch-byte read stays in bounds.
+	const std::uint8_t* matchLimit = size >= MinMatch ? end - MinMatch : src;
+
+	size_t misses = 0;
+	while (ip < matchLimit)
+	{
+		std::uint32_t h = HashOf(ip);
+		const std::uint8_t* candidate = src + table[h];
+		table[h] = (std::uint32_t)(ip - src);
+
+		if (candidate >= ip || (size_t)(ip - candidate) > MaxOffset || Read32(candidate) != Read32(ip))
+		{
+			// Skip ahead faster through data that does not compress.
+			ip += 1 + (misses++ >> 5);
+			continue;
+		}
+		misses = 0;
+
+		// Extend the match backwards over pending literals and forwards to the end.
+		while (ip > anchor && candidate > src && ip[-1] == candidate[-1])
+		{
+			--ip;
+			--candidate;
+		}
+		size_t length = MinMatch;
+		while (ip + length < end && ip[length] == candidate[length])
+			++length;
+
+		EmitSequence(out, anchor, ip - anchor, ip - candidate, length);
+		ip += length;
+		anchor = ip;
+
+		// Seed the table inside the match so that the next search can find it.
+		if (ip < matchLimit)
+			table[HashOf(ip - 2)] = (std::uint32_t)(ip - 2 - src);
+	}
+
+	// Final literals-only sequence, always present so the decoder knows where to stop.
+	EmitSequence(out, anchor, end - anchor, 0, 0);
+}
+
+bool MeshCodec::LzDecompress(const std::uint8_t* src, size_t size, std::uint8_t* dst, size_t dstSize)
+{
+	const std::uint8_t* ip = src;
+	const std::uint8_t* iend = src + size;
+	std::uint8_t* op = dst;
+	std::uint8_t* oend = dst + dstSize;
+
+	while (ip < iend)
+	{
+		std::uint8_t token = *ip++;
+
+		// Short literal runs and matches are copied as whole 16-byte blocks while both
+		// buffers have room for the overrun; the tail of the buffers takes the exact path.
+		size_t literalCount = token >> 4;
+		if (literalCount < 15 && iend - ip >= 16 && oend - op >= 16)
+		{
+			std::memcpy(op, ip, 16);
+		}
+		else
+		{
+			if (literalCount == 15 && !ReadLength(ip, iend, literalCount))
+				return false;
+			if (literalCount > (size_t)(iend - ip) || literalCount > (size_t)(oend - op))
+				return false;
+			std::memcpy(op, ip, literalCount);
+		}
+		ip += literalCount;
+		op += literalCount;
+
+		// The last sequence has no match.
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return false;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		size_t length = token & 15;
+		if (length == 15 && !ReadLength(ip, iend, length))
+			return false;
+		length += MinMatch;
+		if (offset == 0 || offset > (size_t)(op - dst) || length > (size_t)(oend - op))
+			return false;
+
+		const std::uint8_t* match = op - offset;
+		if (offset >= 16 && (size_t)(oend - op) >= length + 16)
+		{
+			for (size_t copied = 0; copied < length; copied += 16)
+				std::memcpy(op + copied, match + copied, 16);
+			op += length;
+		}
+		else if ((size_t)(oend - op) >= length + 16)
+		{
+			// A short offset repeats a pattern of offset bytes.  Copying the first 16 bytes
+			// one by one lays the pattern out; it is then stored 16 bytes at a time, at a
+			// step that is a whole number of periods.
+			static const std::uint8_t patternSteps[16] = { 0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15 };
+			for (size_t i = 0; i < 16; ++i)
+				op[i] = match[i];
+			std::uint8_t pattern[16];
+			std::memcpy(pattern, op, 16);
+			size_t step = patternSteps[offset];
+			for (size_t copied = step; copied < length; copied += step)
+				std::memcpy(op + copied, pattern, 16);
+			op += length;
+		}
+		else if (offset >= length)
+		{
+			std::memcpy(op, match, length);
+			op += length;
+		}
+		else
+		{
+			// Overlapping copy of a repeating pattern: every copy doubles the source
+			// span, and the span stays a whole number of periods.
+			for (size_t remaining = length; remaining;)
+			{
+				size_t n = std::min<size_t>(remaining, op - match);
+				std::memcpy(op, match, n);
+				op += n;
+				remaining -= n;
+			}
+		}
+	}
+
+	return op == oend;
+}
+
+void MeshCodec::EncodeIndices(const void* indices, size_t count, size_t indexSize, std::vector<std::uint8_t>& out)
+{
+	WriteHeader(out, count, (std::uint32_t)indexSize, IndexBlockSize);
+
+	std::vector<std::uint8_t> varints;
+	std::int64_t prev = 0;
+	for (size_t first = 0; first < count; first += IndexBlockSize)
+	{
+		size_t last = std::min(first + IndexBlockSize, count);
+		varints.clear();
+		for (size_t i = first; i < last; ++i)
+		{
+			std::int64_t index;
+			if (indexSize == 2)
+			{
+				std::uint16_t v;
+				std::memcpy(&v, static_cast<const std::uint8_t*>(indices) + i * 2, 2);
+				index = v;
+			}
+			else
+			{
+				std::uint32_t v;
+				std::memcpy(&v, static_cast<const std::uint8_t*>(indices) + i * 4, 4);
+				index = v;
+			}
+
+			std::int64_t delta = index - prev;
+			std::uint64_t zigzag = ((std::uint64_t)delta << 1) ^ (std::uint64_t)(delta >> 63);
+			while (zigzag >= 0x80)
+			{
+				varints.push_back((std::uint8_t)(zigzag | 0x80));
+				zigzag >>= 7;
+			}
+			varints.push_back((std::uint8_t)zigzag);
+			prev = index;
+		}
+		WriteBlock(out, varints);
+	}
+}
+
+void MeshCodec::EncodeVertices(const void* vertices, size_t count, size_t stride, std::vector<std::uint8_t>& out)
+{
+	size_t blockSize = VertexBlockSize(stride);
+	WriteHeader(out, count, (std::uint32_t)stride, (std::uint32_t)blockSize);
+
+	// planes[k * n + i] = byte k of vertex i - byte k of the vertex before it
+	const std::uint8_t* src = static_cast<const std::uint8_t*>(vertices);
+	std::vector<std::uint8_t> planes;
+	std::vector<std::uint8_t> prev(stride, 0);
+	for (size_t first = 0; first < count; first += blockSize)
+	{
+		size_t n = std::min(blockSize, count - first);
+		planes.resize(n * stride);
+		for (size_t k = 0; k < stride; ++k)
+		{
+			std::uint8_t* plane = planes.data() + k * n;
+			for (size_t i = 0; i < n; ++i)
+			{
+				std::uint8_t b = src[(first + i) * stride + k];
+				plane[i] = (std::uint8_t)(b - prev[k]);
+				prev[k] = b;
+			}
+		}
+		WriteBlock(out, planes);
+	}
+}
+
+bool MeshCodec::PeekHeader(const std::uint8_t* data, size_t size, size_t& count, size_t& elementSize)
+{
+	if (size < HeaderSize)
+		return false;
+	count = (size_t)Read64(data);
+	elementSize = Read32(data + 8);
+	return true;
+}
+
+bool MeshCodec::DecodeIndices(const std::uint8_t* data, size_t size, void* dst)
+{
+	size_t count, indexSize;
+	if (!PeekHeader(data, size, count, indexSize) || (indexSize != 2 && indexSize != 4) ||
+		Read32(data + 12) != IndexBlockSize)
+		return false;
+
+	const std::uint8_t* ip = data + HeaderSize;
+	const std::uint8_t* iend = data + size;
+	// A varint takes at most 10 bytes.
+	std::vector<std::uint8_t> varints(IndexBlockSize * 10);
+	std::int64_t index = 0;
+	for (size_t first = 0; first < count; first += IndexBlockSize)
+	{
+		size_t varintBytes;
+		if (!ReadBlock(ip, iend, varints.data(), varints.size(), varintBytes))
+			return false;
+
+		size_t last = std::min(first + IndexBlockSize, count);
+		bool status = indexSize == 2 ?
+			DecodeIndexBlock(varints.data(), varintBytes, static_cast<std::uint16_t*>(dst) + first, last - first, index) :
+			DecodeIndexBlock(varints.data(), varintBytes, static_cast<std::uint32_t*>(dst) + first, last - first, index);
+		if (!status)
+			return false;
+	}
+	return ip == iend;
+}
+
+bool MeshCodec::DecodeVertices(const std::uint8_t* data, size_t size, void* dst)
+{
+	size_t count, stride;
+	if (!PeekHeader(data, size, count, stride) || stride == 0 || Read32(data + 12) != VertexBlockSize(stride))
+		return false;
+
+	const std::uint8_t* ip = data + HeaderSize;
+	const std::uint8_t* iend = data + size;
+	std::uint8_t* out = static_cast<std::uint8_t*>(dst);
+	size_t blockSize = VertexBlockSize(stride);
+	std::vector<std::uint8_t> planes(blockSize * stride);
+	std::vector<std::uint8_t> sums(stride, 0);
+	for (size_t first = 0; first < count; first += blockSize)
+	{
+		size_t n = std::min(blockSize, count - first);
+		size_t planeBytes;
+		if (!ReadBlock(ip, iend, planes.data(), n * stride, planeBytes) || planeBytes != n * stride)
+			return false;
+		UndoPlaneDeltas(planes.data(), n, stride, sums.data(), out + first * stride);
+	}
+	return ip == iend;
+}
@@ -0,0 +1,36 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// lossless vertex/index buffer compression
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index buffers are coded as zigzag varints of the difference to the previous index,
+// vertex buffers as byte planes (byte k of every vertex together) holding the
+// difference to the previous vertex.  Both are then packed by a small LZ77 back end
+// whose decoder only does bounds checks and memcpy, so it runs at memory speed.
+//
+// Every stream starts with the element count and size, so decoding only needs the
+// destination buffer.
+class MeshCodec
+{
+public:
+	static void EncodeIndices(const void* indices, size_t count, size_t indexSize, std::vector<std::uint8_t>& out);
+	static void EncodeVertices(const void* vertices, size_t count, size_t stride, std::vector<std::uint8_t>& out);
+
+	// Reads the element count and size of an encoded stream; false if it is too short.
+	static bool PeekHeader(const std::uint8_t* data, size_t size, size_t& count, size_t& elementSize);
+
+	// dst must hold count * elementSize bytes as reported by PeekHeader.
+	// Returns false on malformed input without writing past dst.
+	static bool DecodeIndices(const std::uint8_t* data, size_t size, void* dst);
+	static bool DecodeVertices(const std::uint8_t* data, size_t size, void* dst);
+
+	// The LZ back end on its own.
+	static void LzCompress(const std::uint8_t* src, size_t size, std::vector<std::uint8_t>& out);
+	static bool LzDecompress(const std::uint8_t* src, size_t size, std::uint8_t* dst, size_t dstSize);
+};
@@ -0,0 +1,354 @@
+#include "MeshNormals.h"
+#include "ParallelFor.h"
+#include "PositionWeld.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// A triangle whose edges enclose an angle with a sine below this has no usable plane.
+	const float DegenerateSine = 1e-6f;
+	// A face tangent within this sine of a vertex normal has no usable projection.
+	const float ProjectedTangentLength = 1e-3f;
+
+	template<typename T>
+	T& Member(T* base, size_t stride, size_t i)
+	{
+		return *reinterpret_cast<T*>(reinterpret_cast<std::uint8_t*>(base) + i * stride);
+	}
+
+	template<typename T>
+	const T& Member(const T* base, size_t stride, size_t i)
+	{
+		return *reinterpret_cast<const T*>(reinterpret_cast<const std::uint8_t*>(base) + i * stride);
+	}
+
+	// The corners of each vertex set, in corner order: Corners[Offsets[s]] up to
+	// Corners[Offsets[s + 1]].  sets maps vertices to sets, or is null for one per vertex.
+	struct CornerLists
+	{
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Corners;
+
+		template<typename Index>
+		void Build(const Index* indices, size_t indexCount, size_t vertexCount, const std::uint32_t* sets)
+		{
+			Offsets.assign(vertexCount + 1, 0);
+			for (size_t c = 0; c < indexCount; ++c)
+				++Offsets[(sets ? sets[indices[c]] : indices[c]) + 1];
+			for (size_t s = 0; s < vertexCount; ++s)
+				Offsets[s + 1] += Offsets[s];
+
+			std::vector<std::uint32_t> next(Offsets.begin(), Offsets.end() - 1);
+			Corners.resize(indexCount);
+			for (size_t c = 0; c < indexCount; ++c)
+				Corners[next[sets ? sets[indices[c]] : indices[c]]++] = (std::uint32_t)c;
+		}
+	};
+
+	// Removes the part of v along the unit vector n.
+	XMVECTOR Project(FXMVECTOR v, FXMVECTOR n)
+	{
+		return XMVectorSubtract(v, XMVectorMultiply(XMVector3Dot(n, v), n));
+	}
+
+	// Angle between two vectors given their dot product and lengths; 90 degrees when
+	// either is zero.
+	XMVECTOR Angle(FXMVECTOR dot, FXMVECTOR length1, FXMVECTOR length2)
+	{
+		XMVECTOR lengths = XMVectorMax(XMVectorMultiply(length1, length2), XMVectorReplicate(FLT_MIN));
+		return XMVectorACos(XMVectorClamp(XMVectorDivide(dot, lengths), g_XMNegativeOne, g_XMOne));
+	}
+
+	// A triangle's share of the normals of its corners: Normal times Angles[corner] for
+	// angle weighting, Normal alone otherwise.
+	struct FaceNormal
+	{
+		XMFLOAT3 Normal;
+		float Angles[3];
+	};
+
+	// Four triangles at a time, one per lane.
+	template<typename Index>
+	void ComputeFaceNormals(const XMFLOAT3* positions, size_t vertexStride, const Index* indices,
+		size_t triangleCount, MeshNormalWeighting weighting, size_t first, size_t last, FaceNormal* faces)
+	{
+		for (size_t batch = first; batch < last; ++batch)
+		{
+			// Corner k of the batch's triangles, by coordinate; short batches repeat the last.
+			XMFLOAT4 x[3], y[3], z[3];
+			for (size_t i = 0; i < 4; ++i)
+			{
+				size_t t = std::min(batch * 4 + i, triangleCount - 1);
+				for (size_t k = 0; k < 3; ++k)
+				{
+					const XMFLOAT3& p = Member(positions, vertexStride, indices[t * 3 + k]);
+					(&x[k].x)[i] = p.x;
+					(&y[k].x)[i] = p.y;
+					(&z[k].x)[i] = p.z;
+				}
+			}
+
+			XMVECTOR x0 = XMLoadFloat4(&x[0]), y0 = XMLoadFloat4(&y[0]), z0 = XMLoadFloat4(&z[0]);
+			XMVECTOR ax = XMVectorSubtract(XMLoadFloat4(&x[1]), x0);
+			XMVECTOR ay = XMVectorSubtract(XMLoadFloat4(&y[1]), y0);
+			XMVECTOR az = XMVectorSubtract(XMLoadFloat4(&z[1]), z0);
+			XMVECTOR bx = XMVectorSubtract(XMLoadFloat4(&x[2]), x0);
+			XMVECTOR by = XMVectorSubtract(XMLoadFloat4(&y[2]), y0);
+			XMVECTOR bz = XMVectorSubtract(XMLoadFloat4(&z[2]), z0);
+
+			// Twice the area along the front face normal.
+			XMVECTOR nx = XMVectorNegativeMultiplySubtract(az, by, XMVectorMultiply(ay, bz));
+			XMVECTOR ny = XMVectorNegativeMultiplySubtract(ax, bz, XMVectorMultiply(az, bx));
+			XMVECTOR nz = XMVectorNegativeMultiplySubtract(ay, bx, XMVectorMultiply(ax, by));
+
+			XMFLOAT4 angles[3];
+			if (weighting != MeshNormalWeighting::Area)
+			{
+				// Edges a = p1 - p0, b = p2 - p0 and c = p2 - p1.
+				XMVECTOR cx = XMVectorSubtract(bx, ax), cy = XMVectorSubtract(by, ay), cz = XMVectorSubtract(bz, az);
+				XMVECTOR ab = XMVectorMultiplyAdd(ax, bx, XMVectorMultiplyAdd(ay, by, XMVectorMultiply(az, bz)));
+				XMVECTOR ac = XMVectorMultiplyAdd(ax, cx, XMVectorMultiplyAdd(ay, cy, XMVectorMultiply(az, cz)));
+				XMVECTOR bc = XMVectorMultiplyAdd(bx, cx, XMVectorMultiplyAdd(by, cy, XMVectorMultiply(bz, cz)));
+				XMVECTOR la = XMVectorSqrt(XMVectorMultiplyAdd(ax, ax, XMVectorMultiplyAdd(ay, ay, XMVectorMultiply(az, az))));
+				XMVECTOR lb = XMVectorSqrt(XMVectorMultiplyAdd(bx, bx, XMVectorMultiplyAdd(by, by, XMVectorMultiply(bz, bz))));
+				XMVECTOR lc = XMVectorSqrt(XMVectorMultiplyAdd(cx, cx, XMVectorMultiplyAdd(cy, cy, XMVectorMultiply(cz, cz))));
+				XMStoreFloat4(&angles[0], Angle(ab, la, lb));
+				XMStoreFloat4(&angles[1], Angle(XMVectorNegate(ac), la, lc));
+				XMStoreFloat4(&angles[2], Angle(bc, lb, lc));
+
+				if (weighting == MeshNormalWeighting::Angle)
+				{
+					XMVECTOR lengthSq = XMVectorMultiplyAdd(nx, nx, XMVectorMultiplyAdd(ny, ny, XMVectorMultiply(nz, nz)));
+					XMVECTOR scale = XMVectorSelect(XMVectorReciprocalSqrt(lengthSq), XMVectorZero(),
+						XMVectorLessOrEqual(lengthSq, XMVectorReplicate(FLT_MIN)));
+					nx = XMVectorMultiply(nx, scale);
+					ny = XMVectorMultiply(ny, scale);
+					nz = XMVectorMultiply(nz, scale);
+				}
+			}
+
+			XMFLOAT4 fx, fy, fz;
+			XMStoreFloat4(&fx, nx);
+			XMStoreFloat4(&fy, ny);
+			XMStoreFloat4(&fz, nz);
+			for (size_t i = 0; i < 4 && batch * 4 + i < triangleCount; ++i)
+			{
+				FaceNormal& face = faces[batch * 4 + i];
+				face.Normal = XMFLOAT3((&fx.x)[i], (&fy.x)[i], (&fz.x)[i]);
+				for (size_t k = 0; k < 3; ++k)
+					face.Angles[k] = weighting != MeshNormalWeighting::Area ? (&angles[k].x)[i] : 1.0f;
+			}
+		}
+	}
+
+	template<typename Index>
+	void GenerateNormalsImpl(const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+		const Index* indices, size_t indexCount, XMFLOAT3* normals, size_t normalStride,
+		const std::uint32_t* smoothKeys, MeshNormalWeighting weighting, UINT numThreads)
+	{
+		size_t triangleCount = indexCount / 3;
+		indexCount = triangleCount * 3;
+		if (vertexCount == 0 || triangleCount == 0)
+			return;
+
+		std::vector<std::uint32_t> welded;
+		if (!smoothKeys)
+		{
+			welded.resize(vertexCount);
+			WeldPositions(positions, vertexCount, vertexStride, welded.data());
+			smoothKeys = welded.data();
+		}
+
+		std::vector<FaceNormal> faces(triangleCount);
+		ParallelFor((triangleCount + 3) / 4, numThreads, [&](size_t first, size_t last) {
+			ComputeFaceNormals(positions, vertexStride, indices, triangleCount, weighting, first, last, faces.data());
+		});
+
+		CornerLists lists;
+		lists.Build(indices, indexCount, vertexCount, smoothKeys);
+
+		// Each set's normal, kept at the vertex that names the set.
+		std::vector<XMFLOAT3> setNormals(vertexCount);
+		ParallelFor(vertexCount, numThreads, [&](size_t first, size_t last) {
+			for (size_t s = first; s < last; ++s)
+			{
+				if (lists.Offsets[s] == lists.Offsets[s + 1])
+					continue;
+
+				XMVECTOR sum = XMVectorZero();
+				for (std::uint32_t i = lists.Offsets[s]; i < lists.Offsets[s + 1]; ++i)
+				{
+					std::uint32_t c = lists.Corners[i];
+					const FaceNormal& face = faces[c / 3];
+					sum = XMVectorMultiplyAdd(XMLoadFloat3(&face.Normal), XMVectorReplicate(face.Angles[c % 3]), sum);
+				}
+
+				if (XMVectorGetX(XMVector3LengthSq(sum)) > FLT_MIN)
+					XMStoreFloat3(&setNormals[s], XMVector3Normalize(sum));
+				else
+					setNormals[s] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			}
+		});
+
+		ParallelFor(vertexCount, numThreads, [&](size_t first, size_t last) {
+			for (size_t v = first; v < last; ++v)
+			{
+				std::uint32_t s = smoothKeys[v];
+				if (lists.Offsets[s] != lists.Offsets[s + 1])
+					Member(normals, normalStride, v) = setNormals[s];
+			}
+		});
+	}
+
+	// The direction of +u over a triangle, and whether the UVs are mirrored.
+	struct FaceTangent
+	{
+		XMFLOAT3 Direction;
+		// +1 or -1, 0 for a triangle without UV area.
+		float Sign;
+		// p1 - p0 and p2 - p0, for the corner angles.
+		XMFLOAT3 Edges[2];
+	};
+
+	template<typename Index>
+	void GenerateTangentsImpl(const XMFLOAT3* positions, const XMFLOAT3* normals, const XMFLOAT2* texCoords,
+		size_t vertexCount, size_t vertexStride, const Index* indices, size_t indexCount, XMFLOAT4* tangents,
+		UINT numThreads)
+	{
+		size_t triangleCount = indexCount / 3;
+		indexCount = triangleCount * 3;
+		if (vertexCount == 0 || triangleCount == 0)
+			return;
+
+		std::vector<FaceTangent> faceTangents(triangleCount);
+		ParallelFor(triangleCount, numThreads, [&](size_t first, size_t last) {
+			for (size_t t = first; t < last; ++t)
+			{
+				Index i0 = indices[t * 3 + 0], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+				XMVECTOR p0 = XMLoadFloat3(&Member(positions, vertexStride, i0));
+				XMVECTOR d1 = XMVectorSubtract(XMLoadFloat3(&Member(positions, vertexStride, i1)), p0);
+				XMVECTOR d2 = XMVectorSubtract(XMLoadFloat3(&Member(positions, vertexStride, i2)), p0);
+				const XMFLOAT2& uv0 = Member(texCoords, vertexStride, i0);
+				const XMFLOAT2& uv1 = Member(texCoords, vertexStride, i1);
+				const XMFLOAT2& uv2 = Member(texCoords, vertexStride, i2);
+				float s1 = uv1.x - uv0.x, t1 = uv1.y - uv0.y;
+				float s2 = uv2.x - uv0.x, t2 = uv2.y - uv0.y;
+
+				// Twice the signed UV area, and +u scaled by it.
+				float area = s1 * t2 - t1 * s2;
+				XMVECTOR direction = XMVectorSubtract(XMVectorScale(d1, t2), XMVectorScale(d2, t1));
+				FaceTangent& face = faceTangents[t];
+				XMStoreFloat3(&face.Edges[0], d1);
+				XMStoreFloat3(&face.Edges[1], d2);
+				// Collinear positions give a direction, but not one in the triangle's plane.
+				float crossSq = XMVectorGetX(XMVector3LengthSq(XMVector3Cross(d1, d2)));
+				float edgesSq = XMVectorGetX(XMVector3LengthSq(d1)) * XMVectorGetX(XMVector3LengthSq(d2));
+				bool degenerate = crossSq <= DegenerateSine * DegenerateSine * edgesSq;
+				if (!degenerate && std::abs(area) > FLT_MIN && XMVectorGetX(XMVector3LengthSq(direction)) > FLT_MIN)
+				{
+					face.Sign = area > 0.0f ? 1.0f : -1.0f;
+					XMStoreFloat3(&face.Direction, XMVectorScale(XMVector3Normalize(direction), face.Sign));
+				}
+				else
+				{
+					face.Direction = XMFLOAT3(0.0f, 0.0f, 0.0f);
+					face.Sign = 0.0f;
+				}
+			}
+		});
+
+		CornerLists lists;
+		lists.Build(indices, indexCount, vertexCount, nullptr);
+
+		ParallelFor(vertexCount, numThreads, [&](size_t first, size_t last) {
+			for (size_t v = first; v < last; ++v)
+			{
+				if (lists.Offsets[v] == lists.Offsets[v + 1])
+					continue;
+
+				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&Member(normals, vertexStride, v)));
+				// Unmirrored triangles in slot 0, mirrored ones in slot 1.
+				XMVECTOR sum[2] = { XMVectorZero(), XMVectorZero() };
+				float angles[2] = { 0.0f, 0.0f };
+				for (std::uint32_t i = lists.Offsets[v]; i < lists.Offsets[v + 1]; ++i)
+				{
+					std::uint32_t c = lists.Corners[i];
+					size_t t = c / 3, k = c % 3;
+					const FaceTangent& face = faceTangents[t];
+					if (face.Sign == 0.0f)
+						continue;
+
+					// The edges leaving the corner, projected like the tangent.
+					XMVECTOR d1 = XMLoadFloat3(&face.Edges[0]);
+					XMVECTOR d2 = XMLoadFloat3(&face.Edges[1]);
+					XMVECTOR e1 = k == 0 ? d1 : k == 1 ? XMVectorSubtract(d2, d1) : XMVectorNegate(d2);
+					XMVECTOR e2 = k == 0 ? d2 : k == 1 ? XMVectorNegate(d1) : XMVectorSubtract(d1, d2);
+					e1 = Project(e1, n);
+					e2 = Project(e2, n);
+					// Direction is unit length; one along the normal would normalize noise.
+					XMVECTOR direction = Project(XMLoadFloat3(&face.Direction), n);
+					if (XMVectorGetX(XMVector3LengthSq(direction)) < ProjectedTangentLength * ProjectedTangentLength)
+						continue;
+					direction = XMVector3Normalize(direction);
+					XMVECTOR angle = Angle(XMVector3Dot(e1, e2), XMVector3Length(e1), XMVector3Length(e2));
+
+					int side = face.Sign > 0.0f ? 0 : 1;
+					sum[side] = XMVectorMultiplyAdd(direction, angle, sum[side]);
+					angles[side] += XMVectorGetX(angle);
+				}
+
+				int side = angles[1] > angles[0] ? 1 : 0;
+				XMVECTOR tangent;
+				if (XMVectorGetX(XMVector3LengthSq(sum[side])) > FLT_MIN)
+				{
+					tangent = XMVector3Normalize(sum[side]);
+				}
+				else
+				{
+					// Any direction in the normal's plane.
+					XMVECTOR axis = std::abs(XMVectorGetX(n)) < 0.9f ? g_XMIdentityR0 : g_XMIdentityR1;
+					tangent = XMVector3Normalize(Project(axis, n));
+					side = 0;
+				}
+				XMStoreFloat4(&tangents[v], XMVectorSetW(tangent, side ? -1.0f : 1.0f));
+			}
+		});
+	}
+}
+
+void MeshNormals::GenerateNormals(const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+	const std::uint16_t* indices, size_t indexCount, XMFLOAT3* normals, size_t normalStride,
+	const std::uint32_t* smoothKeys, MeshNormalWeighting weighting, UINT numThreads)
+{
+	GenerateNormalsImpl(positions, vertexCount, vertexStride, indices, indexCount, normals, normalStride,
+		smoothKeys, weighting, numThreads);
+}
+
+void MeshNormals::GenerateNormals(const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+	const std::uint32_t* indices, size_t indexCount, XMFLOAT3* normals, size_t normalStride,
+	const std::uint32_t* smoothKeys, MeshNormalWeighting weighting, UINT numThreads)
+{
+	GenerateNormalsImpl(positions, vertexCount, vertexStride, indices, indexCount, normals, normalStride,
+		smoothKeys, weighting, numThreads);
+}
+
+void MeshNormals::GenerateTangents(const XMFLOAT3* positions, const XMFLOAT3* normals, const XMFLOAT2* texCoords,
+	size_t vertexCount, size_t vertexStride, const std::uint16_t* indices, size_t indexCount, XMFLOAT4* tangents,
+	UINT numThreads)
+{
+	GenerateTangentsImpl(positions, normals, texCoords, vertexCount, vertexStride, indices, indexCount, tangents,
+		numThreads);
+}
+
+void MeshNormals::GenerateTangents(const XMFLOAT3* positions, const XMFLOAT3* normals, const XMFLOAT2* texCoords,
+	size_t vertexCount, size_t vertexStride, const std::uint32_t* indices, size_t indexCount, XMFLOAT4* tangents,
+	UINT numThreads)
+{
+	GenerateTangentsImpl(positions, normals, texCoords, vertexCount, vertexStride, indices, indexCount, tangents,
+		numThreads);
+}
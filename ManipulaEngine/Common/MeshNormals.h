@@ -0,0 +1,57 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// vertex normal and tangent generation
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "d3dUtil.h"
+#include <cstdint>
+
+// How much each triangle counts towards the normal of a vertex.
+enum class MeshNormalWeighting
+{
+	Area,		// twice the triangle's area, good for scans with even triangles
+	Angle,		// the triangle's angle at the vertex, independent of how faces are split
+	AreaAngle	// both
+};
+
+// Both generators work in parallel over an indexed triangle list: per-triangle terms are
+// computed first (face normals and corner angles four triangles to a SIMD vector), then
+// each vertex gathers the terms of the corners that use it in a fixed order, so the
+// result does not depend on numThreads (0 uses every hardware thread).  Vertex inputs
+// point at the member of vertex 0 and the next vertex is vertexStride bytes on, so they
+// can read straight from a VertexPosNormalTex array.  Vertices no triangle uses are left
+// alone.
+class MeshNormals
+{
+public:
+	// Writes one unit normal per vertex at normals, normalStride bytes apart.  Vertices
+	// with the same smoothKeys entry share one normal made from all their triangles; an
+	// entry is the number of a vertex in the same set, e.g. its first one.  Without keys,
+	// vertices at bit-identical positions are smoothed together, so UV seams stay smooth.
+	// A vertex that only touches zero-area triangles gets +y.
+	static void GenerateNormals(const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+		const std::uint16_t* indices, size_t indexCount, DirectX::XMFLOAT3* normals, size_t normalStride,
+		const std::uint32_t* smoothKeys = nullptr, MeshNormalWeighting weighting = MeshNormalWeighting::Angle,
+		UINT numThreads = 1);
+	static void GenerateNormals(const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t vertexStride,
+		const std::uint32_t* indices, size_t indexCount, DirectX::XMFLOAT3* normals, size_t normalStride,
+		const std::uint32_t* smoothKeys = nullptr, MeshNormalWeighting weighting = MeshNormalWeighting::Angle,
+		UINT numThreads = 1);
+
+	// Writes one tangent per vertex to tangents, packed: xyz is the unit tangent along +u,
+	// w is +1 or -1 so that the bitangent is w * cross(normal, tangent), pointing along +v.
+	// Follows MikkTSpace: each triangle's direction of +u is projected onto the vertex
+	// normal and weighted by the triangle's angle at the vertex, also measured in the
+	// normal's plane, and triangles with no UV area are skipped.  Vertices are not split:
+	// where mirrored and unmirrored triangles share a vertex, the side with the larger
+	// angle sum decides it.  A vertex without usable UVs gets a tangent perpendicular to
+	// its normal.
+	static void GenerateTangents(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+		const DirectX::XMFLOAT2* texCoords, size_t vertexCount, size_t vertexStride,
+		const std::uint16_t* indices, size_t indexCount, DirectX::XMFLOAT4* tangents, UINT numThreads = 1);
+	static void GenerateTangents(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+		const DirectX::XMFLOAT2* texCoords, size_t vertexCount, size_t vertexStride,
+		const std::uint32_t* indices, size_t indexCount, DirectX::XMFLOAT4* tangents, UINT numThreads = 1);
+};
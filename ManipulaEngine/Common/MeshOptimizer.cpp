@@ -0,0 +1,466 @@
+#include "MeshOptimizer.h"
+#include "ClusterDag.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+using namespace DirectX;
+
+namespace
+{
+	template<typename Index>
+	void TipsifyImpl(Index* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+	{
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0 || vertexCount == 0)
+			return;
+
+		// Triangles of each vertex, as offsets into one array.  live counts the corners
+		// of a vertex that have not been emitted yet.
+		std::vector<std::uint32_t> live(vertexCount, 0);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			++live[indices[i]];
+		std::vector<std::uint32_t> firstTriangle(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			firstTriangle[v + 1] = firstTriangle[v] + live[v];
+		std::vector<std::uint32_t> adjacency(triangleCount * 3);
+		std::vector<std::uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+			adjacency[fill[indices[i]]++] = (std::uint32_t)(i / 3);
+
+		// A vertex is in the simulated cache while time - cacheTime < cacheSize.
+		std::vector<size_t> cacheTime(vertexCount, 0);
+		size_t time = cacheSize + 1;
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<std::uint32_t> deadEnd;
+		deadEnd.reserve(indexCount);
+		std::vector<std::uint32_t> candidates;
+
+		std::vector<Index> output;
+		output.reserve(triangleCount * 3);
+
+		size_t nextVertex = 0;
+		auto skipDeadEnd = [&]() -> size_t {
+			// Most recently referenced vertices first, then the input order.
+			while (!deadEnd.empty())
+			{
+				std::uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					return v;
+			}
+			for (; nextVertex < vertexCount; ++nextVertex)
+			{
+				if (live[nextVertex] > 0)
+					return nextVertex++;
+			}
+			return vertexCount;
+		};
+
+		size_t fanning = skipDeadEnd();
+		while (fanning < vertexCount)
+		{
+			candidates.clear();
+			for (std::uint32_t a = firstTriangle[fanning]; a < firstTriangle[fanning + 1]; ++a)
+			{
+				std::uint32_t t = adjacency[a];
+				if (emitted[t])
+					continue;
+				emitted[t] = true;
+
+				for (size_t c = 0; c < 3; ++c)
+				{
+					Index v = indices[t * 3 + c];
+					output.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					--live[v];
+					if (time - cacheTime[v] > cacheSize)
+						cacheTime[v] = time++;
+				}
+			}
+
+			// Fan next around the candidate that will still be cached after its remaining
+			// triangles are emitted and has been in the cache the longest.
+			size_t best = vertexCount;
+			size_t bestPriority = 0;
+			for (std::uint32_t v : candidates)
+			{
+				if (live[v] == 0)
+					continue;
+				size_t priority = 0;
+				if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+					priority = time - cacheTime[v];
+				if (best == vertexCount || priority > bestPriority)
+				{
+					best = v;
+					bestPriority = priority;
+				}
+			}
+			fanning = best < vertexCount ? best : skipDeadEnd();
+		}
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	template<typename Index>
+	VertexCacheStatistics AnalyzeImpl(const Index* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+	{
+		VertexCacheStatistics stats;
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0 || vertexCount == 0)
+			return stats;
+
+		// FIFO: a vertex hits while fewer than cacheSize misses happened since it was loaded.
+		std::vector<size_t> loadedAt(vertexCount, 0);
+		std::vector<bool> referenced(vertexCount, false);
+		size_t misses = 0, uniqueVertices = 0;
+		for (size_t i = 0; i < triangleCount * 3; ++i)
+		{
+			Index v = indices[i];
+			if (!referenced[v])
+			{
+				referenced[v] = true;
+				++uniqueVertices;
+			}
+			else if (misses - loadedAt[v] < cacheSize)
+			{
+				continue;
+			}
+			loadedAt[v] = misses++;
+		}
+
+		stats.VerticesTransformed = misses;
+		stats.Acmr = (float)misses / triangleCount;
+		stats.Atvr = (float)misses / uniqueVertices;
+		return stats;
+	}
+
+	template<typename Index>
+	VertexCacheReport OptimizeAndReport(std::vector<Index>& indices, size_t vertexCount, size_t cacheSize)
+	{
+		VertexCacheReport report;
+		report.Before = AnalyzeImpl(indices.data(), indices.size(), vertexCount, cacheSize);
+		TipsifyImpl(indices.data(), indices.size(), vertexCount, cacheSize);
+		report.After = AnalyzeImpl(indices.data(), indices.size(), vertexCount, cacheSize);
+		return report;
+	}
+
+	template<typename Index>
+	void OverdrawImpl(Index* indices, size_t indexCount, const XMFLOAT3* positions, size_t vertexCount,
+		size_t positionStride, float threshold, size_t cacheSize)
+	{
+		size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0 || vertexCount == 0)
+			return;
+
+		auto position = [&](Index v) {
+			return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(
+				reinterpret_cast<const std::uint8_t*>(positions) + v * positionStride));
+		};
+
+		// FIFO simulation as in AnalyzeImpl.  Advancing misses by cacheSize empties the cache.
+		std::vector<size_t> loadedAt(vertexCount, 0);
+		size_t misses = cacheSize;
+		auto triangleMisses = [&](size_t t) {
+			size_t count = 0;
+			for (size_t c = 0; c < 3; ++c)
+			{
+				Index v = indices[t * 3 + c];
+				if (misses - loadedAt[v] >= cacheSize)
+				{
+					loadedAt[v] = misses++;
+					++count;
+				}
+			}
+			return count;
+		};
+
+		// Hard boundaries: the order jumps to a triangle none of whose vertices are cached.
+		std::vector<size_t> hardStarts;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			if (triangleMisses(t) == 3)
+				hardStarts.push_back(t);
+		}
+		if (hardStarts.empty() || hardStarts[0] != 0)
+			hardStarts.insert(hardStarts.begin(), 0);
+		hardStarts.push_back(triangleCount);
+
+		// Soft boundaries: within a hard cluster, split as soon as the ACMR since the last split
+		// is within threshold of the ACMR of the whole hard cluster.
+		std::vector<size_t> clusterStarts;
+		for (size_t h = 0; h + 1 < hardStarts.size(); ++h)
+		{
+			size_t begin = hardStarts[h], end = hardStarts[h + 1];
+
+			misses += cacheSize;
+			size_t clusterMisses = 0;
+			for (size_t t = begin; t < end; ++t)
+				clusterMisses += triangleMisses(t);
+			float limit = threshold * clusterMisses / (end - begin);
+
+			misses += cacheSize;
+			clusterStarts.push_back(begin);
+			size_t runMisses = 0, runTriangles = 0;
+			for (size_t t = begin; t < end; ++t)
+			{
+				runMisses += triangleMisses(t);
+				++runTriangles;
+				if (t + 1 < end && (float)runMisses <= limit * runTriangles)
+				{
+					clusterStarts.push_back(t + 1);
+					runMisses = runTriangles = 0;
+					misses += cacheSize;
+				}
+			}
+		}
+		clusterStarts.push_back(triangleCount);
+		size_t clusterCount = clusterStarts.size() - 1;
+
+		// Area weighted centroids; the sum of the triangle cross products is the cluster's
+		// normal scaled by twice its area.
+		std::vector<XMFLOAT3> centroids(clusterCount), normals(clusterCount);
+		XMVECTOR meshCentroid = XMVectorZero();
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			XMVECTOR centroid = XMVectorZero(), normal = XMVectorZero();
+			float area = 0.0f;
+			for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t)
+			{
+				XMVECTOR p0 = position(indices[t * 3]);
+				XMVECTOR p1 = position(indices[t * 3 + 1]);
+				XMVECTOR p2 = position(indices[t * 3 + 2]);
+				XMVECTOR cross = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+				float triangleArea = XMVectorGetX(XMVector3Length(cross));
+				centroid = XMVectorAdd(centroid, XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), triangleArea / 3.0f));
+				normal = XMVectorAdd(normal, cross);
+				area += triangleArea;
+			}
+			meshCentroid = XMVectorAdd(meshCentroid, centroid);
+			meshArea += area;
+			XMStoreFloat3(&centroids[c], area > 0.0f ? XMVectorScale(centroid, 1.0f / area) : XMVectorZero());
+			XMStoreFloat3(&normals[c], XMVector3Normalize(normal));
+		}
+		if (meshArea > 0.0f)
+			meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+		std::vector<float> sortKeys(clusterCount);
+		std::vector<std::uint32_t> order(clusterCount);
+		for (size_t c = 0; c < clusterCount; ++c)
+		{
+			XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&centroids[c]), meshCentroid);
+			sortKeys[c] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[c])));
+			order[c] = (std::uint32_t)c;
+		}
+		std::stable_sort(order.begin(), order.end(),
+			[&](std::uint32_t a, std::uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<Index> output;
+		output.reserve(triangleCount * 3);
+		for (std::uint32_t c : order)
+			output.insert(output.end(), indices + clusterStarts[c] * 3, indices + clusterStarts[c + 1] * 3);
+		std::copy(output.begin(), output.end(), indices);
+	}
+
+	template<typename Index>
+	size_t FetchImpl(void* vertices, size_t vertexCount, size_t vertexStride, Index* indices, size_t indexCount)
+	{
+		const std::uint32_t unused = ~0u;
+		std::vector<std::uint32_t> remap(vertexCount, unused);
+		std::uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			std::uint32_t& slot = remap[indices[i]];
+			if (slot == unused)
+				slot = next++;
+			indices[i] = (Index)slot;
+		}
+
+		std::uint8_t* bytes = static_cast<std::uint8_t*>(vertices);
+		std::vector<std::uint8_t> reordered((size_t)next * vertexStride);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			if (remap[v] != unused)
+				std::memcpy(reordered.data() + remap[v] * vertexStride, bytes + v * vertexStride, vertexStride);
+		}
+		if (next)
+			std::memcpy(bytes, reordered.data(), reordered.size());
+		return next;
+	}
+
+	template<typename Index>
+	VertexFetchStatistics AnalyzeFetchImpl(const Index* indices, size_t indexCount, size_t vertexCount,
+		size_t vertexStride)
+	{
+		VertexFetchStatistics stats;
+		if (indexCount == 0 || vertexCount == 0)
+			return stats;
+
+		const size_t lineSize = MeshOptimizer::FetchCacheLineSize;
+		const size_t cacheLines = MeshOptimizer::FetchCacheLines;
+		std::vector<size_t> loadedAt((vertexCount * vertexStride + lineSize - 1) / lineSize, 0);
+		std::vector<bool> referenced(vertexCount, false);
+		size_t misses = cacheLines, uniqueVertices = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			Index v = indices[i];
+			if (!referenced[v])
+			{
+				referenced[v] = true;
+				++uniqueVertices;
+			}
+			size_t firstLine = v * vertexStride / lineSize;
+			size_t lastLine = ((size_t)v * vertexStride + vertexStride - 1) / lineSize;
+			for (size_t line = firstLine; line <= lastLine; ++line)
+			{
+				if (misses - loadedAt[line] >= cacheLines)
+					loadedAt[line] = misses++;
+			}
+		}
+
+		stats.BytesFetched = (misses - cacheLines) * lineSize;
+		stats.Overfetch = (float)stats.BytesFetched / (uniqueVertices * vertexStride);
+		return stats;
+	}
+
+	template<typename Index>
+	MeshCookReport CookImpl(std::vector<VertexPosNormalTex>& vertices, std::vector<Index>& indices, MeshletData& meshlets,
+		std::uint32_t flags)
+	{
+		const size_t stride = sizeof(VertexPosNormalTex);
+		MeshCookReport report;
+		report.CacheBefore = AnalyzeImpl(indices.data(), indices.size(), vertices.size(), MeshOptimizer::DefaultCacheSize);
+		report.FetchBefore = AnalyzeFetchImpl(indices.data(), indices.size(), vertices.size(), stride);
+
+		if (flags & MeshCookVertexCache)
+			TipsifyImpl(indices.data(), indices.size(), vertices.size(), MeshOptimizer::DefaultCacheSize);
+		if ((flags & MeshCookOverdraw) && !vertices.empty())
+		{
+			OverdrawImpl(indices.data(), indices.size(), &vertices[0].pos, vertices.size(), stride,
+				MeshOptimizer::DefaultOverdrawThreshold, MeshOptimizer::DefaultCacheSize);
+		}
+		if (flags & MeshCookVertexFetch)
+		{
+			vertices.resize(FetchImpl(vertices.data(), vertices.size(), stride, indices.data(), indices.size()));
+			// The meshlet vertex lists hold the old vertex numbers.
+			meshlets.clear();
+		}
+		if ((flags & MeshCookMeshlets) && !vertices.empty())
+		{
+			// DWORD is not std::uint32_t on Windows, but has the same representation.
+			using FixedIndex = std::conditional_t<sizeof(Index) == 2, std::uint16_t, std::uint32_t>;
+			MeshletBuilder::Build(&vertices[0].pos, vertices.size(), stride,
+				reinterpret_cast<const FixedIndex*>(indices.data()), indices.size(), meshlets);
+		}
+
+		report.CacheAfter = AnalyzeImpl(indices.data(), indices.size(), vertices.size(), MeshOptimizer::DefaultCacheSize);
+		report.FetchAfter = AnalyzeFetchImpl(indices.data(), indices.size(), vertices.size(), stride);
+		return report;
+	}
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::uint16_t* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+	TipsifyImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::uint32_t* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+	TipsifyImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const std::uint16_t* indices, size_t indexCount,
+	size_t vertexCount, size_t cacheSize)
+{
+	return AnalyzeImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+VertexCacheStatistics MeshOptimizer::AnalyzeVertexCache(const std::uint32_t* indices, size_t indexCount,
+	size_t vertexCount, size_t cacheSize)
+{
+	return AnalyzeImpl(indices, indexCount, vertexCount, cacheSize);
+}
+
+VertexCacheReport MeshOptimizer::OptimizeVertexCache(ObjReader::ObjPart& part, size_t cacheSize)
+{
+	if (!part.indices32.empty())
+		return OptimizeAndReport(part.indices32, part.vertices.size(), cacheSize);
+	return OptimizeAndReport(part.indices16, part.vertices.size(), cacheSize);
+}
+
+VertexCacheReport MeshOptimizer::OptimizeVertexCache(GeometryGenerator::MeshData& mesh, size_t cacheSize)
+{
+	return OptimizeAndReport(mesh.Indices32, mesh.Vertices.size(), cacheSize);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::uint16_t* indices, size_t indexCount, const XMFLOAT3* positions,
+	size_t vertexCount, size_t positionStride, float threshold, size_t cacheSize)
+{
+	OverdrawImpl(indices, indexCount, positions, vertexCount, positionStride, threshold, cacheSize);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::uint32_t* indices, size_t indexCount, const XMFLOAT3* positions,
+	size_t vertexCount, size_t positionStride, float threshold, size_t cacheSize)
+{
+	OverdrawImpl(indices, indexCount, positions, vertexCount, positionStride, threshold, cacheSize);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride,
+	std::uint16_t* indices, size_t indexCount)
+{
+	return FetchImpl(vertices, vertexCount, vertexStride, indices, indexCount);
+}
+
+size_t MeshOptimizer::OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride,
+	std::uint32_t* indices, size_t indexCount)
+{
+	return FetchImpl(vertices, vertexCount, vertexStride, indices, indexCount);
+}
+
+VertexFetchStatistics MeshOptimizer::AnalyzeVertexFetch(const std::uint16_t* indices, size_t indexCount,
+	size_t vertexCount, size_t vertexStride)
+{
+	return AnalyzeFetchImpl(indices, indexCount, vertexCount, vertexStride);
+}
+
+VertexFetchStatistics MeshOptimizer::AnalyzeVertexFetch(const std::uint32_t* indices, size_t indexCount,
+	size_t vertexCount, size_t vertexStride)
+{
+	return AnalyzeFetchImpl(indices, indexCount, vertexCount, vertexStride);
+}
+
+MeshCookReport MeshOptimizer::Cook(ObjReader::ObjPart& part, std::uint32_t flags)
+{
+	MeshCookReport report = !part.indices32.empty() ?
+		CookImpl(part.vertices, part.indices32, part.meshlets, flags) :
+		CookImpl(part.vertices, part.indices16, part.meshlets, flags);
+	// The vertex fetch step renumbers the vertices under any chain built before; CookImpl
+	// has already dropped the meshlets for the same reason.
+	if (flags & MeshCookVertexFetch)
+	{
+		part.lods.clear();
+		part.clusterDag.clear();
+		part.tangents.clear();
+	}
+	if (flags & MeshCookLods)
+		MeshSimplifier::BuildLodChain(part);
+	if ((flags & MeshCookClusterDag) && !part.vertices.empty())
+	{
+		const VertexPosNormalTex* vertices = part.vertices.data();
+		if (!part.indices32.empty())
+		{
+			ClusterDagBuilder::Build(&vertices[0].pos, part.vertices.size(), sizeof(VertexPosNormalTex),
+				reinterpret_cast<const std::uint32_t*>(part.indices32.data()), part.indices32.size(), part.clusterDag,
+				&vertices[0].normal.x, 5);
+		}
+		else
+		{
+			ClusterDagBuilder::Build(&vertices[0].pos, part.vertices.size(), sizeof(VertexPosNormalTex),
+				part.indices16.data(), part.indices16.size(), part.clusterDag, &vertices[0].normal.x, 5);
+		}
+	}
+	return report;
+}
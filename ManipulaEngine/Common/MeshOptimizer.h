@@ -0,0 +1,121 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// triangle reordering for the post-transform vertex cache
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "ObjReader.h"
+
+// Post-transform cache efficiency of an index buffer, measured on a FIFO cache.
+//   Acmr  vertices transformed per triangle; 0.5 is the ideal for large grids, 3 the worst
+//   Atvr  vertices transformed per referenced vertex; 1 is the ideal
+struct VertexCacheStatistics
+{
+	size_t VerticesTransformed = 0;
+	float Acmr = 0.0f;
+	float Atvr = 0.0f;
+};
+
+struct VertexCacheReport
+{
+	VertexCacheStatistics Before;
+	VertexCacheStatistics After;
+};
+
+// Vertex fetch efficiency of an index buffer, measured on a FIFO cache of
+// FetchCacheLines lines of FetchCacheLineSize bytes.
+//   Overfetch  bytes fetched per byte of referenced vertices; 1 is the ideal
+struct VertexFetchStatistics
+{
+	size_t BytesFetched = 0;
+	float Overfetch = 0.0f;
+};
+
+// Steps of MeshOptimizer::Cook, run in the order listed.
+enum MeshCookFlags : std::uint32_t
+{
+	MeshCookVertexCache = 0x1,
+	MeshCookOverdraw = 0x2,
+	// Renumbers the vertices, so it clears the meshlets, lods, clusterDag and tangents
+	// built before; ask for the later steps to build them again.
+	MeshCookVertexFetch = 0x4,
+	// Fills ObjPart::meshlets from the final order, see MeshletBuilder.
+	MeshCookMeshlets = 0x8,
+	// Fills ObjPart::lods with MeshSimplifier::BuildLodChain's default chain.
+	MeshCookLods = 0x10,
+	// Fills ObjPart::clusterDag, see ClusterDagBuilder.
+	MeshCookClusterDag = 0x20,
+	// Grows with every new step, so pass the steps you need where cost matters.
+	MeshCookAll = 0x3F,
+};
+
+struct MeshCookReport
+{
+	VertexCacheStatistics CacheBefore;
+	VertexCacheStatistics CacheAfter;
+	VertexFetchStatistics FetchBefore;
+	VertexFetchStatistics FetchAfter;
+};
+
+// Triangles are reordered with Tipsify (Sander, Nehab and Barczak, "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw"), which runs in linear time.
+// Reordering never changes a triangle's corners or winding.
+class MeshOptimizer
+{
+public:
+	// The default matches the FIFO size the algorithm was tuned against; GPUs differ,
+	// but the order is not sensitive to the exact value.
+	static constexpr size_t DefaultCacheSize = 16;
+	// OptimizeOverdraw ends a cluster once its ACMR is within this factor of the ACMR of the
+	// surrounding run; larger values give smaller clusters at some cost in cache hits.
+	static constexpr float DefaultOverdrawThreshold = 1.05f;
+	static constexpr size_t FetchCacheLineSize = 64;
+	static constexpr size_t FetchCacheLines = 256;
+
+	static void OptimizeVertexCache(std::uint16_t* indices, size_t indexCount, size_t vertexCount,
+		size_t cacheSize = DefaultCacheSize);
+	static void OptimizeVertexCache(std::uint32_t* indices, size_t indexCount, size_t vertexCount,
+		size_t cacheSize = DefaultCacheSize);
+
+	// Simulates a FIFO cache of cacheSize entries over the triangle list.
+	static VertexCacheStatistics AnalyzeVertexCache(const std::uint16_t* indices, size_t indexCount, size_t vertexCount,
+		size_t cacheSize = DefaultCacheSize);
+	static VertexCacheStatistics AnalyzeVertexCache(const std::uint32_t* indices, size_t indexCount, size_t vertexCount,
+		size_t cacheSize = DefaultCacheSize);
+
+	// Splits the current triangle order into clusters and draws those likely to occlude the
+	// rest first: clusters are sorted by the dot product of their centroid's offset from the
+	// mesh centroid with their average normal, which does not depend on the view.  Clusters
+	// break where the order already jumps (all three vertices miss the cache) and wherever
+	// the ACMR allows, so run it on the output of OptimizeVertexCache.
+	// positions points at the position of vertex 0, the next one is positionStride bytes on.
+	static void OptimizeOverdraw(std::uint16_t* indices, size_t indexCount, const DirectX::XMFLOAT3* positions,
+		size_t vertexCount, size_t positionStride, float threshold = DefaultOverdrawThreshold,
+		size_t cacheSize = DefaultCacheSize);
+	static void OptimizeOverdraw(std::uint32_t* indices, size_t indexCount, const DirectX::XMFLOAT3* positions,
+		size_t vertexCount, size_t positionStride, float threshold = DefaultOverdrawThreshold,
+		size_t cacheSize = DefaultCacheSize);
+
+	// Renumbers the vertices in the order the indices first reference them and moves them
+	// to match, so fetches walk the vertex buffer forwards.  Unreferenced vertices are
+	// dropped; returns the new vertex count.
+	static size_t OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride,
+		std::uint16_t* indices, size_t indexCount);
+	static size_t OptimizeVertexFetch(void* vertices, size_t vertexCount, size_t vertexStride,
+		std::uint32_t* indices, size_t indexCount);
+
+	static VertexFetchStatistics AnalyzeVertexFetch(const std::uint16_t* indices, size_t indexCount,
+		size_t vertexCount, size_t vertexStride);
+	static VertexFetchStatistics AnalyzeVertexFetch(const std::uint32_t* indices, size_t indexCount,
+		size_t vertexCount, size_t vertexStride);
+
+	// Runs the MeshCookFlags steps on whichever index buffer the part uses.
+	static MeshCookReport Cook(ObjReader::ObjPart& part, std::uint32_t flags);
+
+	// Reorders whichever index buffer the part uses.
+	static VertexCacheReport OptimizeVertexCache(ObjReader::ObjPart& part, size_t cacheSize = DefaultCacheSize);
+	// Reorders Indices32; call it before the first GetIndices16(), which caches its result.
+	static VertexCacheReport OptimizeVertexCache(GeometryGenerator::MeshData& mesh, size_t cacheSize = DefaultCacheSize);
+};
@@ -0,0 +1,726 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "PositionWeld.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <type_traits>
+
+using namespace DirectX;
+
+namespace
+{
+	const std::uint32_t None = ~0u;
+
+	// Q(p) = p'Ap + 2b'p + c over planes added with a weight; A is symmetric.
+	struct Quadric
+	{
+		float a00, a11, a22, a01, a02, a12;
+		float b0, b1, b2;
+		float c;
+		float weight;
+	};
+
+	void AddPlane(Quadric& q, const XMFLOAT3& n, float d, float weight)
+	{
+		q.a00 += weight * n.x * n.x;
+		q.a11 += weight * n.y * n.y;
+		q.a22 += weight * n.z * n.z;
+		q.a01 += weight * n.x * n.y;
+		q.a02 += weight * n.x * n.z;
+		q.a12 += weight * n.y * n.z;
+		q.b0 += weight * n.x * d;
+		q.b1 += weight * n.y * d;
+		q.b2 += weight * n.z * d;
+		q.c += weight * d * d;
+		q.weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& r)
+	{
+		q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+		q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+		q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+		q.c += r.c;
+		q.weight += r.weight;
+	}
+
+	// Weighted mean squared distance of p from the planes of q and r, which ranks the
+	// collapses; it is not a bound on the distance.
+	float Evaluate(const Quadric& q, const Quadric& r, const XMFLOAT3& p)
+	{
+		Quadric s = q;
+		AddQuadric(s, r);
+		float x = s.a00 * p.x + s.a01 * p.y + s.a02 * p.z + 2.0f * s.b0;
+		float y = s.a01 * p.x + s.a11 * p.y + s.a12 * p.z + 2.0f * s.b1;
+		float z = s.a02 * p.x + s.a12 * p.y + s.a22 * p.z + 2.0f * s.b2;
+		float error = std::fabs(p.x * x + p.y * y + p.z * z + s.c);
+		return s.weight > 0.0f ? error / s.weight : error;
+	}
+
+	XMFLOAT3 Subtract(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	// Squared distance from p to the triangle abc, after Ericson, "Real-Time Collision
+	// Detection" 5.1.5: the closest point is found by the Voronoi region p falls in.
+	float TriangleDistanceSquared(const XMFLOAT3& p, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+	{
+		auto squared = [&](float u, float v) {
+			// The closest point is a + u * ab + v * ac.
+			XMFLOAT3 q(a.x + u * (b.x - a.x) + v * (c.x - a.x), a.y + u * (b.y - a.y) + v * (c.y - a.y),
+				a.z + u * (b.z - a.z) + v * (c.z - a.z));
+			XMFLOAT3 d = Subtract(p, q);
+			return Dot(d, d);
+		};
+		XMFLOAT3 ab = Subtract(b, a), ac = Subtract(c, a), ap = Subtract(p, a);
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return squared(0.0f, 0.0f);
+		XMFLOAT3 bp = Subtract(p, b);
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return squared(1.0f, 0.0f);
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return squared(d1 / (d1 - d3), 0.0f);
+		XMFLOAT3 cp = Subtract(p, c);
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return squared(0.0f, 1.0f);
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return squared(0.0f, d2 / (d2 - d6));
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		{
+			float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			return squared(1.0f - w, w);
+		}
+		float sum = va + vb + vc;
+		if (sum <= 0.0f)
+			return squared(0.0f, 0.0f);
+		return squared(vb / sum, vc / sum);
+	}
+
+	enum class VertexKind : std::uint8_t
+	{
+		Manifold,  // interior, may collapse onto any neighbour
+		Border,    // on open edges, may collapse along one
+		Locked,    // never moves, but others may collapse onto it
+	};
+
+	struct Collapse
+	{
+		float error;
+		std::uint32_t vertex;
+		std::uint32_t target;
+		std::uint32_t version;
+
+		bool operator>(const Collapse& rhs)const { return error > rhs.error; }
+	};
+
+	// The mesh is held as a corner table: corner c is vertex c % 3 of triangle c / 3, and
+	// the corners of each vertex are linked into a list, which is the vertex's fan of
+	// half-edges.  Topology uses one vertex per position; Wedge maps a vertex to it.
+	class Simplifier
+	{
+	public:
+		template<typename Index>
+		size_t Run(Index* destination, const Index* indices, size_t indexCount, const XMFLOAT3* positions,
+			size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError, std::uint32_t flags,
+			float* resultError, const float* attributes, size_t attributeCount, float attributeWeight)
+		{
+			mAttributes = attributes;
+			mAttributeCount = attributes ? attributeCount : 0;
+			mAttributeWeight = attributeWeight * attributeWeight;
+			mStride = vertexStride;
+
+			if (!LoadPositions(positions, vertexCount, indices, indexCount))
+			{
+				if (resultError)
+					*resultError = 0.0f;
+				std::copy(indices, indices + indexCount, destination);
+				return indexCount;
+			}
+			LoadTriangles(indices, indexCount, vertexCount);
+			ClassifyVertices(flags);
+
+			// Errors are compared squared and in the normalized space.
+			float limit = targetError / mScale;
+			limit = targetError >= FLT_MAX || limit >= 1e18f ? FLT_MAX : limit * limit;
+			for (std::uint32_t v = 0; v < mWedge.size(); ++v)
+			{
+				if (mWedge[v] == v)
+					Rank(v, limit, false);
+			}
+
+			while (mLiveTriangles * 3 > targetIndexCount && !mHeap.empty())
+			{
+				Collapse collapse = mHeap.top();
+				mHeap.pop();
+				if (collapse.version != mVersion[collapse.vertex])
+					continue;
+				if (collapse.error > limit)
+					break;
+
+				if (!MapWedges(collapse.vertex, collapse.target) || !KeepsShape(collapse.vertex, collapse.target))
+				{
+					Rank(collapse.vertex, limit, true);
+					continue;
+				}
+				Apply(collapse.vertex, collapse.target);
+
+				// Every vertex whose fan or candidate targets changed is next to the target now.
+				mVersion[collapse.vertex]++;
+				Rank(collapse.target, limit, false);
+				Gather(collapse.target, mUpdate);
+				mUpdate.erase(std::unique(mUpdate.begin(), mUpdate.end()), mUpdate.end());
+				for (std::uint32_t n : mUpdate)
+					Rank(n, limit, false);
+			}
+
+			if (resultError)
+				*resultError = std::sqrt(MeasureError()) * mScale;
+
+			size_t count = 0;
+			for (size_t t = 0; t < mAlive.size(); ++t)
+			{
+				if (!mAlive[t])
+					continue;
+				destination[count++] = (Index)mCorners[t * 3];
+				destination[count++] = (Index)mCorners[t * 3 + 1];
+				destination[count++] = (Index)mCorners[t * 3 + 2];
+			}
+			return count;
+		}
+
+	private:
+		// Normalizes the positions to the unit cube so the quadrics keep their precision
+		// in floats.  Fails if no triangle references a vertex.
+		template<typename Index>
+		bool LoadPositions(const XMFLOAT3* positions, size_t vertexCount, const Index* indices, size_t indexCount)
+		{
+			const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(positions);
+			XMFLOAT3 vMin(FLT_MAX, FLT_MAX, FLT_MAX), vMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (size_t i = 0; i < indexCount - indexCount % 3; ++i)
+			{
+				const XMFLOAT3& p = *reinterpret_cast<const XMFLOAT3*>(bytes + indices[i] * mStride);
+				vMin = XMFLOAT3(std::min(vMin.x, p.x), std::min(vMin.y, p.y), std::min(vMin.z, p.z));
+				vMax = XMFLOAT3(std::max(vMax.x, p.x), std::max(vMax.y, p.y), std::max(vMax.z, p.z));
+			}
+			if (vMin.x > vMax.x)
+				return false;
+
+			mScale = std::max(std::max(vMax.x - vMin.x, vMax.y - vMin.y), vMax.z - vMin.z);
+			if (mScale <= 0.0f)
+				mScale = 1.0f;
+			float invScale = 1.0f / mScale;
+
+			mPositions.resize(vertexCount);
+			for (std::uint32_t v = 0; v < vertexCount; ++v)
+			{
+				const XMFLOAT3& p = *reinterpret_cast<const XMFLOAT3*>(bytes + v * mStride);
+				mPositions[v] = XMFLOAT3((p.x - vMin.x) * invScale, (p.y - vMin.y) * invScale, (p.z - vMin.z) * invScale);
+			}
+			mWedge.resize(vertexCount);
+			WeldPositions(positions, vertexCount, mStride, mWedge.data());
+			mSeam.assign(vertexCount, 0);
+			for (std::uint32_t v = 0; v < vertexCount; ++v)
+			{
+				if (mWedge[v] != v)
+					mSeam[v] = mSeam[mWedge[v]] = 1;
+			}
+			return true;
+		}
+
+		template<typename Index>
+		void LoadTriangles(const Index* indices, size_t indexCount, size_t vertexCount)
+		{
+			size_t triangleCount = indexCount / 3;
+			mCorners.reserve(triangleCount * 3);
+			mQuadrics.assign(vertexCount, Quadric());
+			for (size_t t = 0; t < triangleCount; ++t)
+			{
+				std::uint32_t a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+				// Triangles with two corners at one position are dropped up front.
+				if (mWedge[a] == mWedge[b] || mWedge[b] == mWedge[c] || mWedge[a] == mWedge[c])
+					continue;
+				mCorners.push_back(a);
+				mCorners.push_back(b);
+				mCorners.push_back(c);
+
+				XMFLOAT3 normal = Cross(Subtract(mPositions[b], mPositions[a]), Subtract(mPositions[c], mPositions[a]));
+				float length = std::sqrt(Dot(normal, normal));
+				if (length > 0.0f)
+				{
+					normal = XMFLOAT3(normal.x / length, normal.y / length, normal.z / length);
+					float d = -Dot(normal, mPositions[a]);
+					for (std::uint32_t v : { a, b, c })
+						AddPlane(mQuadrics[mWedge[v]], normal, d, 0.5f * length);
+				}
+			}
+
+			mAlive.assign(mCorners.size() / 3, 1);
+			mLiveTriangles = mAlive.size();
+			mFirst.assign(vertexCount, None);
+			mNext.resize(mCorners.size());
+			for (std::uint32_t c = 0; c < mCorners.size(); ++c)
+			{
+				std::uint32_t v = mWedge[mCorners[c]];
+				mNext[c] = mFirst[v];
+				mFirst[v] = c;
+			}
+			mVersion.assign(vertexCount, 0);
+			mCollapsedTo.assign(vertexCount, None);
+		}
+
+		void ClassifyVertices(std::uint32_t flags)
+		{
+			size_t vertexCount = mWedge.size();
+			mKind.assign(vertexCount, VertexKind::Manifold);
+
+			// Triangle count and first corner of each edge between positions.
+			struct EdgeUse
+			{
+				std::uint32_t uses;
+				std::uint32_t corner;
+			};
+			FlatHashMap<std::uint64_t, EdgeUse, EdgeHash> edges;
+			edges.Reserve(mCorners.size());
+			for (std::uint32_t c = 0; c < mCorners.size(); ++c)
+			{
+				EdgeUse first = { 0, c };
+				edges.Insert(EdgeKey(mWedge[mCorners[c]], mWedge[mCorners[Corner(c, 1)]]), first).first->uses++;
+			}
+
+			std::vector<std::uint8_t> borderEdges(vertexCount, 0);
+			for (std::uint32_t c = 0; c < mCorners.size(); ++c)
+			{
+				std::uint32_t i0 = mCorners[c], i1 = mCorners[Corner(c, 1)];
+				std::uint32_t a = mWedge[i0], b = mWedge[i1];
+				const EdgeUse& edge = *edges.Find(EdgeKey(a, b));
+				if (edge.uses > 2)
+				{
+					mKind[a] = mKind[b] = VertexKind::Locked;
+				}
+				else if (edge.uses == 1)
+				{
+					borderEdges[a] = (std::uint8_t)std::min(borderEdges[a] + 1, 3);
+					borderEdges[b] = (std::uint8_t)std::min(borderEdges[b] + 1, 3);
+					AddEdgePlane(c);
+				}
+				else if (edge.corner != c)
+				{
+					// The two triangles of a seam edge use different vertices for its ends.
+					std::uint32_t j0 = mCorners[edge.corner], j1 = mCorners[Corner(edge.corner, 1)];
+					if (!(i0 == j1 && i1 == j0) && !(i0 == j0 && i1 == j1))
+						AddEdgePlane(c);
+				}
+			}
+
+			for (std::uint32_t v = 0; v < vertexCount; ++v)
+			{
+				if (mWedge[v] != v || mKind[v] == VertexKind::Locked || borderEdges[v] == 0)
+					continue;
+				mKind[v] = (flags & MeshSimplifyLockBorder) || borderEdges[v] != 2 ? VertexKind::Locked : VertexKind::Border;
+			}
+		}
+
+		// Adds a plane through the edge from corner c at right angles to its triangle to
+		// both ends, which keeps a sliding border or seam from pulling away from its line.
+		void AddEdgePlane(std::uint32_t c)
+		{
+			const XMFLOAT3& p0 = mPositions[mCorners[c]];
+			const XMFLOAT3& p1 = mPositions[mCorners[Corner(c, 1)]];
+			const XMFLOAT3& p2 = mPositions[mCorners[Corner(c, 2)]];
+			XMFLOAT3 edge = Subtract(p1, p0);
+			XMFLOAT3 side = Cross(edge, Cross(edge, Subtract(p2, p0)));
+			float length = std::sqrt(Dot(side, side));
+			if (length <= 0.0f)
+				return;
+			side = XMFLOAT3(side.x / length, side.y / length, side.z / length);
+			float d = -Dot(side, p0);
+			float weight = EdgeWeight * Dot(edge, edge);
+			AddPlane(mQuadrics[mWedge[mCorners[c]]], side, d, weight);
+			AddPlane(mQuadrics[mWedge[mCorners[Corner(c, 1)]]], side, d, weight);
+		}
+
+		// The corner k steps on from c in its triangle.
+		std::uint32_t Corner(std::uint32_t c, std::uint32_t k)const
+		{
+			return c - c % 3 + (c + k) % 3;
+		}
+
+		// Calls fn on each live corner of v's fan and unlinks dead ones on the way.
+		template<typename Fn>
+		void ForEachCorner(std::uint32_t v, Fn fn)
+		{
+			std::uint32_t prev = None;
+			for (std::uint32_t c = mFirst[v]; c != None;)
+			{
+				std::uint32_t next = mNext[c];
+				if (!mAlive[c / 3])
+				{
+					if (prev == None)
+						mFirst[v] = next;
+					else
+						mNext[prev] = next;
+				}
+				else
+				{
+					fn(c);
+					prev = c;
+				}
+				c = next;
+			}
+		}
+
+		// Topological neighbours of v, with one entry per triangle they share with it.
+		void Gather(std::uint32_t v, std::vector<std::uint32_t>& ring)
+		{
+			ring.clear();
+			ForEachCorner(v, [&](std::uint32_t c) {
+				ring.push_back(mWedge[mCorners[Corner(c, 1)]]);
+				ring.push_back(mWedge[mCorners[Corner(c, 2)]]);
+			});
+			std::sort(ring.begin(), ring.end());
+		}
+
+		float AttributeError(std::uint32_t a, std::uint32_t b)const
+		{
+			if (mAttributeCount == 0)
+				return 0.0f;
+			const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(mAttributes);
+			const float* x = reinterpret_cast<const float*>(bytes + a * mStride);
+			const float* y = reinterpret_cast<const float*>(bytes + b * mStride);
+			float sum = 0.0f;
+			for (size_t i = 0; i < mAttributeCount; ++i)
+				sum += (x[i] - y[i]) * (x[i] - y[i]);
+			return mAttributeWeight * sum;
+		}
+
+		// Pairs each vertex of v's fan with the vertex of target that takes its place in
+		// mMap, read off the triangles on their edge.  Fails if v has a vertex with no such
+		// triangle, as it would lose its attributes; this is what keeps seams in place.
+		bool MapWedges(std::uint32_t v, std::uint32_t target)
+		{
+			mMap.clear();
+			if (!mSeam[v] && !mSeam[target])
+			{
+				mMap.push_back({ v, target });
+				return true;
+			}
+
+			size_t shared = 0;
+			bool valid = true;
+			ForEachCorner(v, [&](std::uint32_t c) {
+				std::uint32_t i1 = mCorners[Corner(c, 1)], i2 = mCorners[Corner(c, 2)];
+				if (mWedge[i1] != target && mWedge[i2] != target)
+					return;
+				std::uint32_t to = mWedge[i1] == target ? i1 : i2;
+				++shared;
+				for (const auto& pair : mMap)
+				{
+					if (pair.first == mCorners[c])
+					{
+						valid = valid && pair.second == to;
+						return;
+					}
+				}
+				mMap.push_back({ mCorners[c], to });
+			});
+			if (!valid || shared != (mKind[v] == VertexKind::Border ? 1u : 2u))
+				return false;
+
+			ForEachCorner(v, [&](std::uint32_t c) {
+				valid = valid && std::any_of(mMap.begin(), mMap.end(),
+					[&](const auto& pair) { return pair.first == mCorners[c]; });
+			});
+			return valid;
+		}
+
+		// Whether moving v onto target keeps the surface a manifold and keeps its triangles
+		// from folding over or turning into slivers.
+		bool KeepsShape(std::uint32_t v, std::uint32_t target)
+		{
+			bool valid = true;
+			size_t shared = 0;
+			const XMFLOAT3& to = mPositions[target];
+			ForEachCorner(v, [&](std::uint32_t c) {
+				std::uint32_t i0 = mCorners[c], i1 = mCorners[Corner(c, 1)], i2 = mCorners[Corner(c, 2)];
+				if (mWedge[i1] == target || mWedge[i2] == target)
+				{
+					++shared;
+					return;
+				}
+				if (!valid)
+					return;
+				const XMFLOAT3& from = mPositions[i0];
+				XMFLOAT3 before = Cross(Subtract(mPositions[i1], from), Subtract(mPositions[i2], from));
+				XMFLOAT3 after = Cross(Subtract(mPositions[i1], to), Subtract(mPositions[i2], to));
+				// Turning a triangle by more than about 75 degrees folds or nearly folds it.
+				float d = Dot(before, after);
+				valid = d > 0.0f && d * d > MinFaceTurnCos * MinFaceTurnCos * Dot(before, before) * Dot(after, after);
+				// Nor may a collapse leave a sliver, unless the triangle was one already.
+				float qualityAfter = Quality(after, mPositions[i1], mPositions[i2], to);
+				valid = valid && (qualityAfter >= MinQuality || qualityAfter >= Quality(before, mPositions[i1], mPositions[i2], from));
+			});
+			if (!valid || shared != (mKind[v] == VertexKind::Border ? 1u : 2u))
+				return false;
+
+			// Link condition: v and target may only share the neighbours opposite their edge.
+			Gather(v, mRing);
+			Gather(target, mTargetRing);
+			mRing.erase(std::unique(mRing.begin(), mRing.end()), mRing.end());
+			mTargetRing.erase(std::unique(mTargetRing.begin(), mTargetRing.end()), mTargetRing.end());
+			size_t common = 0;
+			for (size_t i = 0, j = 0; i < mRing.size() && j < mTargetRing.size();)
+			{
+				if (mRing[i] < mTargetRing[j])
+					++i;
+				else if (mRing[i] > mTargetRing[j])
+					++j;
+				else
+					++common, ++i, ++j;
+			}
+			return common == shared;
+		}
+
+		// 1 for an equilateral triangle, falling to 0 as it degenerates; normal is the cross
+		// product of two of its edges.
+		static float Quality(const XMFLOAT3& normal, const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+		{
+			XMFLOAT3 e0 = Subtract(p1, p0), e1 = Subtract(p2, p1), e2 = Subtract(p0, p2);
+			float lengths = Dot(e0, e0) + Dot(e1, e1) + Dot(e2, e2);
+			return lengths > 0.0f ? 2.0f * std::sqrt(3.0f) * std::sqrt(Dot(normal, normal)) / lengths : 0.0f;
+		}
+
+		// Pushes the cheapest collapse of v within limit, if any.  Checking the shape is
+		// the expensive part and most entries are replaced before they reach the top of the
+		// heap, so unless validate is set it is left until the entry is popped.
+		void Rank(std::uint32_t v, float limit, bool validate)
+		{
+			mVersion[v]++;
+			if (mKind[v] == VertexKind::Locked || mFirst[v] == None)
+				return;
+
+			Gather(v, mRing);
+			mCandidates.clear();
+			for (size_t i = 0; i < mRing.size();)
+			{
+				std::uint32_t n = mRing[i];
+				size_t uses = 0;
+				for (; i < mRing.size() && mRing[i] == n; ++i)
+					++uses;
+				// Interior edges have two triangles; border vertices slide along border edges.
+				if (uses != (mKind[v] == VertexKind::Border ? 1u : 2u))
+					continue;
+				if (mKind[v] == VertexKind::Border && mKind[n] == VertexKind::Manifold)
+					continue;
+				if (!MapWedges(v, n))
+					continue;
+				float error = Evaluate(mQuadrics[v], mQuadrics[n], mPositions[n]);
+				for (const auto& pair : mMap)
+					error += AttributeError(pair.first, pair.second);
+				if (error <= limit)
+					mCandidates.push_back({ error, v, n, mVersion[v] });
+			}
+			if (mCandidates.empty())
+				return;
+
+			if (!validate)
+			{
+				mHeap.push(*std::min_element(mCandidates.begin(), mCandidates.end(),
+					[](const Collapse& a, const Collapse& b) { return a.error < b.error; }));
+				return;
+			}
+			std::sort(mCandidates.begin(), mCandidates.end(),
+				[](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+			for (const Collapse& candidate : mCandidates)
+			{
+				if (KeepsShape(v, candidate.target))
+				{
+					mHeap.push(candidate);
+					return;
+				}
+			}
+		}
+
+		// The ranking cost is a weighted mean over many planes and runs well below the
+		// distance the surface actually moved, so the error reported is measured instead:
+		// the largest squared distance of a collapsed vertex from the triangles around the
+		// vertex it ended up on.  The nearest point of the whole surface can only be closer.
+		float MeasureError()
+		{
+			float maxError = 0.0f;
+			for (std::uint32_t v = 0; v < mCollapsedTo.size(); ++v)
+			{
+				if (mCollapsedTo[v] == None)
+					continue;
+				std::uint32_t r = mCollapsedTo[v];
+				while (mCollapsedTo[r] != None)
+					r = mCollapsedTo[r];
+				// Later vertices of the same chain skip straight to its end.
+				for (std::uint32_t n = v; mCollapsedTo[n] != r && n != r;)
+				{
+					std::uint32_t next = mCollapsedTo[n];
+					mCollapsedTo[n] = r;
+					n = next;
+				}
+
+				const XMFLOAT3& p = mPositions[v];
+				XMFLOAT3 d = Subtract(p, mPositions[r]);
+				float error = Dot(d, d);
+				ForEachCorner(r, [&](std::uint32_t c) {
+					error = std::min(error, TriangleDistanceSquared(p, mPositions[mCorners[c]],
+						mPositions[mCorners[Corner(c, 1)]], mPositions[mCorners[Corner(c, 2)]]));
+				});
+				maxError = std::max(maxError, error);
+			}
+			return maxError;
+		}
+
+		// Moves v onto target as planned by the last MapWedges.
+		void Apply(std::uint32_t v, std::uint32_t target)
+		{
+			std::uint32_t tail = None;
+			ForEachCorner(v, [&](std::uint32_t c) {
+				std::uint32_t t = c / 3;
+				if (mWedge[mCorners[Corner(c, 1)]] == target || mWedge[mCorners[Corner(c, 2)]] == target)
+				{
+					mAlive[t] = 0;
+					--mLiveTriangles;
+				}
+				else
+				{
+					for (const auto& pair : mMap)
+					{
+						if (pair.first == mCorners[c])
+							mCorners[c] = pair.second;
+					}
+				}
+				tail = c;
+			});
+
+			// v's fan joins the target's; dead corners are unlinked by later walks.
+			if (tail != None)
+			{
+				mNext[tail] = mFirst[target];
+				mFirst[target] = mFirst[v];
+			}
+			mFirst[v] = None;
+			mCollapsedTo[v] = target;
+			AddQuadric(mQuadrics[target], mQuadrics[v]);
+		}
+
+		// Scales the quadric of edge planes against that of the triangle planes.
+		static constexpr float EdgeWeight = 10.0f;
+		static constexpr float MinFaceTurnCos = 0.25f;
+		static constexpr float MinQuality = 0.1f;
+
+		const float* mAttributes = nullptr;
+		size_t mAttributeCount = 0;
+		float mAttributeWeight = 0.0f;
+		size_t mStride = 0;
+		float mScale = 1.0f;
+
+		std::vector<XMFLOAT3> mPositions;
+		std::vector<std::uint32_t> mWedge;
+		// Set on every vertex that shares its position with another.
+		std::vector<std::uint8_t> mSeam;
+		std::vector<Quadric> mQuadrics;
+		std::vector<VertexKind> mKind;
+		std::vector<std::uint32_t> mVersion;
+		// The vertex each collapsed one moved onto, None for those still in the mesh.
+		std::vector<std::uint32_t> mCollapsedTo;
+
+		std::vector<std::uint32_t> mCorners;
+		std::vector<std::uint32_t> mNext;
+		std::vector<std::uint32_t> mFirst;
+		std::vector<std::uint8_t> mAlive;
+		size_t mLiveTriangles = 0;
+
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> mHeap;
+		std::vector<Collapse> mCandidates;
+		std::vector<std::uint32_t> mRing;
+		std::vector<std::uint32_t> mTargetRing;
+		std::vector<std::uint32_t> mUpdate;
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> mMap;
+	};
+
+	template<typename Index>
+	void BuildLodChainImpl(ObjReader::ObjPart& part, std::vector<Index>& baseIndices, const float* ratios,
+		size_t levelCount, std::vector<Index> ObjReader::ObjLod::* lodIndices)
+	{
+		using FixedIndex = std::conditional_t<sizeof(Index) == 2, std::uint16_t, std::uint32_t>;
+		part.lods.clear();
+		if (part.vertices.empty())
+			return;
+
+		// previous points into the chain, so it must not reallocate.
+		part.lods.reserve(levelCount);
+		const VertexPosNormalTex* vertices = part.vertices.data();
+		const std::vector<Index>* previous = &baseIndices;
+		float error = 0.0f;
+		for (size_t level = 0; level < levelCount; ++level)
+		{
+			size_t target = (size_t)(baseIndices.size() / 3 * ratios[level]) * 3;
+			std::vector<Index> indices(previous->size());
+			float levelError = 0.0f;
+			indices.resize(MeshSimplifier::Simplify(reinterpret_cast<FixedIndex*>(indices.data()),
+				reinterpret_cast<const FixedIndex*>(previous->data()), previous->size(), &vertices[0].pos,
+				part.vertices.size(), sizeof(VertexPosNormalTex), target, FLT_MAX, MeshSimplifyLockBorder, &levelError,
+				&vertices[0].normal.x, 5));
+			if (indices.empty() || indices.size() * 10 > previous->size() * 9)
+				break;
+
+			MeshOptimizer::OptimizeVertexCache(reinterpret_cast<FixedIndex*>(indices.data()), indices.size(),
+				part.vertices.size());
+			// Each level starts from the one before, so its distance from the base is at most
+			// the sum of the steps.
+			error += levelError;
+			part.lods.emplace_back();
+			part.lods.back().error = error;
+			part.lods.back().*lodIndices = std::move(indices);
+			previous = &(part.lods.back().*lodIndices);
+		}
+	}
+}
+
+size_t MeshSimplifier::Simplify(std::uint16_t* destination, const std::uint16_t* indices, size_t indexCount,
+	const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError,
+	std::uint32_t flags, float* resultError, const float* attributes, size_t attributeCount, float attributeWeight)
+{
+	Simplifier simplifier;
+	return simplifier.Run(destination, indices, indexCount, positions, vertexCount, vertexStride, targetIndexCount,
+		targetError, flags, resultError, attributes, attributeCount, attributeWeight);
+}
+
+size_t MeshSimplifier::Simplify(std::uint32_t* destination, const std::uint32_t* indices, size_t indexCount,
+	const XMFLOAT3* positions, size_t vertexCount, size_t vertexStride, size_t targetIndexCount, float targetError,
+	std::uint32_t flags, float* resultError, const float* attributes, size_t attributeCount, float attributeWeight)
+{
+	Simplifier simplifier;
+	return simplifier.Run(destination, indices, indexCount, positions, vertexCount, vertexStride, targetIndexCount,
+		targetError, flags, resultError, attributes, attributeCount, attributeWeight);
+}
+
+void MeshSimplifier::BuildLodChain(ObjReader::ObjPart& part, const float* ratios, size_t levelCount)
+{
+	if (!part.indices32.empty())
+		BuildLodChainImpl(part, part.indices32, ratios, levelCount, &ObjReader::ObjLod::indices32);
+	else
+		BuildLodChainImpl(part, part.indices16, ratios, levelCount, &ObjReader::ObjLod::indices16);
+}
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// quadric edge collapse simplification and LOD chains
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "ObjReader.h"
+#include <cfloat>
+#include <cstdint>
+
+enum MeshSimplifyFlags : std::uint32_t
+{
+	// Keeps every vertex on an open edge where it is.  Without it border vertices may
+	// still collapse, but only along the border.
+	MeshSimplifyLockBorder = 0x1,
+};
+
+// Edge collapses are ranked by the quadric error metric (Garland and Heckbert, "Surface
+// Simplification Using Quadric Error Metrics") plus the squared change of the optional
+// attributes.  Each collapse moves a vertex onto a neighbour, so the result indexes a
+// subset of the input vertices and can share their vertex buffer.  Topology is taken
+// over positions, so vertices split by a normal or UV seam move together and only along
+// the seam; vertices on non-manifold edges never move.  Candidates are kept in a heap
+// and re-ranked as the mesh around them changes.
+class MeshSimplifier
+{
+public:
+	// One unit of attribute difference costs as much as this fraction of the mesh extent
+	// in position error.
+	static constexpr float DefaultAttributeWeight = 0.05f;
+	// Fractions of the base triangle count for BuildLodChain.
+	static constexpr float DefaultLodRatios[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+
+	// Collapses edges until at most targetIndexCount indices remain or the cost of the
+	// next collapse, the root mean square distance from the planes it merges, would exceed
+	// targetError in model units.  destination has room for indexCount indices and may be
+	// indices itself; returns the number written.  positions points at the position of
+	// vertex 0, the next one is vertexStride bytes on; attributes, if given, is
+	// attributeCount floats at the same stride.  resultError receives the measured
+	// deviation in model units: the largest distance of a removed vertex from the
+	// simplified triangles around it, which the cost can underestimate several times over.
+	static size_t Simplify(std::uint16_t* destination, const std::uint16_t* indices, size_t indexCount,
+		const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t vertexStride, size_t targetIndexCount,
+		float targetError = FLT_MAX, std::uint32_t flags = 0, float* resultError = nullptr,
+		const float* attributes = nullptr, size_t attributeCount = 0, float attributeWeight = DefaultAttributeWeight);
+	static size_t Simplify(std::uint32_t* destination, const std::uint32_t* indices, size_t indexCount,
+		const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t vertexStride, size_t targetIndexCount,
+		float targetError = FLT_MAX, std::uint32_t flags = 0, float* resultError = nullptr,
+		const float* attributes = nullptr, size_t attributeCount = 0, float attributeWeight = DefaultAttributeWeight);
+
+	// Replaces part.lods with one level per ratio, each simplified from the level before
+	// with normals and UVs as attributes and borders locked, so parts that meet along an
+	// open edge stay closed at any mix of levels.  The chain stops early at a level that
+	// keeps more than 90% of the triangles of the one before.  Levels are reordered for
+	// the vertex cache.
+	static void BuildLodChain(ObjReader::ObjPart& part, const float* ratios = DefaultLodRatios,
+		size_t levelCount = _countof(DefaultLodRatios));
+};
@@ -0,0 +1,236 @@
+#include "Meshlet.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	XMVECTOR LoadPosition(const XMFLOAT3* positions, size_t positionStride, std::uint32_t v)
+	{
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(
+			reinterpret_cast<const std::uint8_t*>(positions) + v * positionStride));
+	}
+
+	// Fills the bounds of the last meshlet from its vertices and triangles.
+	void ComputeBounds(const XMFLOAT3* positions, size_t positionStride, MeshletData& meshlets)
+	{
+		const Meshlet& meshlet = meshlets.Meshlets.back();
+		const std::uint32_t* vertices = meshlets.Vertices.data() + meshlet.VertexOffset;
+		const std::uint32_t* triangles = meshlets.Triangles.data() + meshlet.TriangleOffset;
+
+		XMVECTOR vecMin = g_XMInfinity, vecMax = g_XMNegInfinity;
+		for (size_t i = 0; i < meshlet.VertexCount; ++i)
+		{
+			XMVECTOR pos = LoadPosition(positions, positionStride, vertices[i]);
+			vecMin = XMVectorMin(vecMin, pos);
+			vecMax = XMVectorMax(vecMax, pos);
+		}
+		XMVECTOR center = XMVectorScale(XMVectorAdd(vecMin, vecMax), 0.5f);
+		float radius = 0.0f;
+		for (size_t i = 0; i < meshlet.VertexCount; ++i)
+		{
+			XMVECTOR pos = LoadPosition(positions, positionStride, vertices[i]);
+			radius = std::max(radius, XMVectorGetX(XMVector3Length(XMVectorSubtract(pos, center))));
+		}
+
+		XMFLOAT4 sphere;
+		XMStoreFloat4(&sphere, XMVectorSetW(center, radius));
+		meshlets.Spheres.push_back(sphere);
+		XMFLOAT3 boxCenter, boxExtents;
+		XMStoreFloat3(&boxCenter, center);
+		XMStoreFloat3(&boxExtents, XMVectorScale(XMVectorSubtract(vecMax, vecMin), 0.5f));
+		meshlets.BoxCenters.push_back(boxCenter);
+		meshlets.BoxExtents.push_back(boxExtents);
+
+		// The cone axis is the mean of the unit normals; the cone must hold all of them.
+		XMVECTOR normals[MeshletBuilder::MaxTriangles];
+		XMVECTOR corners[MeshletBuilder::MaxTriangles];
+		size_t normalCount = 0;
+		XMVECTOR axis = XMVectorZero();
+		for (size_t t = 0; t < meshlet.TriangleCount; ++t)
+		{
+			std::uint32_t packed = triangles[t];
+			XMVECTOR p0 = LoadPosition(positions, positionStride, vertices[packed & 0xFF]);
+			XMVECTOR p1 = LoadPosition(positions, positionStride, vertices[(packed >> 8) & 0xFF]);
+			XMVECTOR p2 = LoadPosition(positions, positionStride, vertices[(packed >> 16) & 0xFF]);
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			// Degenerate triangles are never visible and do not constrain the cone.
+			if (XMVectorGetX(XMVector3LengthSq(normal)) <= 0.0f)
+				continue;
+			normal = XMVector3Normalize(normal);
+			normals[normalCount] = normal;
+			corners[normalCount++] = p0;
+			axis = XMVectorAdd(axis, normal);
+		}
+
+		XMFLOAT3 apex = boxCenter;
+		XMFLOAT4 coneAxis(0.0f, 0.0f, 0.0f, 1.0f);
+		if (normalCount > 0 && XMVectorGetX(XMVector3LengthSq(axis)) > 0.0f)
+		{
+			axis = XMVector3Normalize(axis);
+			float minDot = 1.0f;
+			for (size_t i = 0; i < normalCount; ++i)
+				minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, normals[i])));
+
+			// Past about 84 degrees of spread the cone rejects almost nothing.
+			if (minDot > 0.1f)
+			{
+				// Move the apex back along the axis until it is behind every triangle plane, so
+				// a camera that sees it from the front of the cone sees every plane from behind.
+				float maxT = 0.0f;
+				for (size_t i = 0; i < normalCount; ++i)
+				{
+					float dc = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, corners[i]), normals[i]));
+					float dn = XMVectorGetX(XMVector3Dot(axis, normals[i]));
+					maxT = std::max(maxT, dc / dn);
+				}
+				XMStoreFloat3(&apex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+				XMStoreFloat4(&coneAxis, XMVectorSetW(axis, std::sqrt(1.0f - minDot * minDot)));
+			}
+		}
+		meshlets.ConeApexes.push_back(apex);
+		meshlets.ConeAxes.push_back(coneAxis);
+	}
+
+	template<typename Index>
+	void BuildImpl(const XMFLOAT3* positions, size_t vertexCount, size_t positionStride, const Index* indices,
+		size_t indexCount, MeshletData& meshlets, size_t maxVertices, size_t maxTriangles)
+	{
+		meshlets.clear();
+		maxVertices = std::min(std::max<size_t>(maxVertices, 3), MeshletBuilder::MaxVertices);
+		maxTriangles = std::min(std::max<size_t>(maxTriangles, 1), MeshletBuilder::MaxTriangles);
+
+		size_t triangleCount = indexCount / 3;
+		meshlets.Triangles.reserve(triangleCount);
+		meshlets.Vertices.reserve(vertexCount);
+
+		// Meshlet vertex number of each mesh vertex in the open meshlet, or ~0.
+		const std::uint32_t unused = ~0u;
+		std::vector<std::uint32_t> local(vertexCount, unused);
+		Meshlet open = {};
+
+		auto close = [&]() {
+			if (open.TriangleCount == 0)
+				return;
+			for (size_t i = 0; i < open.VertexCount; ++i)
+				local[meshlets.Vertices[open.VertexOffset + i]] = unused;
+			meshlets.Meshlets.push_back(open);
+			ComputeBounds(positions, positionStride, meshlets);
+			open.VertexOffset = (std::uint32_t)meshlets.Vertices.size();
+			open.TriangleOffset = (std::uint32_t)meshlets.Triangles.size();
+			open.VertexCount = open.TriangleCount = 0;
+		};
+
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			Index a = indices[t * 3], b = indices[t * 3 + 1], c = indices[t * 3 + 2];
+			size_t newVertices = (local[a] == unused) + (local[b] == unused && b != a) +
+				(local[c] == unused && c != a && c != b);
+			if (open.VertexCount + newVertices > maxVertices || open.TriangleCount + 1 > maxTriangles)
+				close();
+
+			std::uint32_t packed = 0;
+			const Index corners[3] = { a, b, c };
+			for (size_t k = 0; k < 3; ++k)
+			{
+				std::uint32_t& slot = local[corners[k]];
+				if (slot == unused)
+				{
+					slot = open.VertexCount++;
+					meshlets.Vertices.push_back(corners[k]);
+				}
+				packed |= slot << (8 * k);
+			}
+			meshlets.Triangles.push_back(packed);
+			++open.TriangleCount;
+		}
+		close();
+	}
+}
+
+void MeshletData::clear()
+{
+	Meshlets.clear();
+	Spheres.clear();
+	BoxCenters.clear();
+	BoxExtents.clear();
+	ConeApexes.clear();
+	ConeAxes.clear();
+	Vertices.clear();
+	Triangles.clear();
+}
+
+void MeshletBuilder::Build(const XMFLOAT3* positions, size_t vertexCount, size_t positionStride,
+	const std::uint16_t* indices, size_t indexCount, MeshletData& meshlets, size_t maxVertices, size_t maxTriangles)
+{
+	BuildImpl(positions, vertexCount, positionStride, indices, indexCount, meshlets, maxVertices, maxTriangles);
+}
+
+void MeshletBuilder::Build(const XMFLOAT3* positions, size_t vertexCount, size_t positionStride,
+	const std::uint32_t* indices, size_t indexCount, MeshletData& meshlets, size_t maxVertices, size_t maxTriangles)
+{
+	BuildImpl(positions, vertexCount, positionStride, indices, indexCount, meshlets, maxVertices, maxTriangles);
+}
+
+void MeshletCuller::ExtractFrustumPlanes(FXMMATRIX viewProj, XMFLOAT4 planes[6])
+{
+	// Row vectors: clip = p * viewProj, so each clip coordinate is p dotted with a column.
+	XMMATRIX columns = XMMatrixTranspose(viewProj);
+	XMVECTOR clip[6] = {
+		XMVectorAdd(columns.r[3], columns.r[0]),
+		XMVectorSubtract(columns.r[3], columns.r[0]),
+		XMVectorAdd(columns.r[3], columns.r[1]),
+		XMVectorSubtract(columns.r[3], columns.r[1]),
+		columns.r[2],
+		XMVectorSubtract(columns.r[3], columns.r[2]),
+	};
+	for (int i = 0; i < 6; ++i)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(clip[i]));
+}
+
+MeshletCullStatistics MeshletCuller::Cull(const MeshletData& meshlets, const XMFLOAT4 planes[6],
+	const XMFLOAT3& cameraPos, std::vector<std::uint32_t>* visible)
+{
+	MeshletCullStatistics stats;
+	stats.Meshlets = meshlets.size();
+	if (visible)
+		visible->clear();
+
+	XMVECTOR camera = XMLoadFloat3(&cameraPos);
+	XMVECTOR planeVectors[6];
+	for (int i = 0; i < 6; ++i)
+		planeVectors[i] = XMLoadFloat4(&planes[i]);
+
+	for (size_t m = 0; m < meshlets.size(); ++m)
+	{
+		size_t triangles = meshlets.Meshlets[m].TriangleCount;
+		stats.Triangles += triangles;
+
+		XMVECTOR sphere = XMLoadFloat4(&meshlets.Spheres[m]);
+		XMVECTOR center = XMVectorSetW(sphere, 1.0f);
+		float radius = XMVectorGetW(sphere);
+		bool outside = false;
+		for (int i = 0; i < 6 && !outside; ++i)
+			outside = XMVectorGetX(XMPlaneDot(planeVectors[i], center)) < -radius;
+		if (outside)
+		{
+			++stats.FrustumCulled;
+			stats.TrianglesRejected += triangles;
+			continue;
+		}
+
+		XMVECTOR cone = XMLoadFloat4(&meshlets.ConeAxes[m]);
+		XMVECTOR view = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&meshlets.ConeApexes[m]), camera));
+		if (XMVectorGetX(XMVector3Dot(view, cone)) >= XMVectorGetW(cone))
+		{
+			++stats.ConeCulled;
+			stats.TrianglesRejected += triangles;
+			continue;
+		}
+
+		if (visible)
+			visible->push_back((std::uint32_t)m);
+	}
+	return stats;
+}
@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// meshlets (small triangle clusters) with culling bounds
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "d3dUtil.h"
+#include <cstdint>
+#include <vector>
+
+// Ranges of one meshlet; the same layout is stored in MBO.
+struct Meshlet
+{
+	std::uint32_t VertexOffset;    // into MeshletData::Vertices
+	std::uint32_t TriangleOffset;  // into MeshletData::Triangles
+	std::uint16_t VertexCount;
+	std::uint16_t TriangleCount;
+};
+
+static_assert(sizeof(Meshlet) == 12, "Meshlet layout");
+
+// The meshlets of one mesh as parallel arrays indexed by meshlet, so a culling pass
+// only touches the bounds it tests.
+struct MeshletData
+{
+	std::vector<Meshlet> Meshlets;
+	// Bounding sphere: center in xyz, radius in w.
+	std::vector<DirectX::XMFLOAT4> Spheres;
+	std::vector<DirectX::XMFLOAT3> BoxCenters;
+	std::vector<DirectX::XMFLOAT3> BoxExtents;
+	// Normal cone: axis in xyz, cutoff in w.  Seen from a camera at C every triangle faces
+	// away when dot(normalize(ConeApex - C), axis) >= cutoff.  Meshlets whose normals
+	// spread too far have a zero axis and a cutoff of 1, which never culls.
+	std::vector<DirectX::XMFLOAT3> ConeApexes;
+	std::vector<DirectX::XMFLOAT4> ConeAxes;
+
+	// Mesh vertex of each meshlet vertex.
+	std::vector<std::uint32_t> Vertices;
+	// Meshlet vertex numbers of the corners, packed as i0 | i1 << 8 | i2 << 16.
+	std::vector<std::uint32_t> Triangles;
+
+	size_t size()const { return Meshlets.size(); }
+	bool empty()const { return Meshlets.empty(); }
+	void clear();
+};
+
+// Splits an index buffer into meshlets in triangle order, so run the vertex cache
+// optimizer first for tight meshlets.
+class MeshletBuilder
+{
+public:
+	// 64/124 keeps a meshlet's vertices and packed triangles within common mesh shader
+	// output sizes; the limits are those of D3D12 mesh shaders.
+	static constexpr size_t DefaultMaxVertices = 64;
+	static constexpr size_t DefaultMaxTriangles = 124;
+	static constexpr size_t MaxVertices = 256;
+	static constexpr size_t MaxTriangles = 256;
+
+	// positions points at the position of vertex 0, the next one is positionStride bytes on.
+	static void Build(const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t positionStride,
+		const std::uint16_t* indices, size_t indexCount, MeshletData& meshlets,
+		size_t maxVertices = DefaultMaxVertices, size_t maxTriangles = DefaultMaxTriangles);
+	static void Build(const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t positionStride,
+		const std::uint32_t* indices, size_t indexCount, MeshletData& meshlets,
+		size_t maxVertices = DefaultMaxVertices, size_t maxTriangles = DefaultMaxTriangles);
+};
+
+struct MeshletCullStatistics
+{
+	size_t Meshlets = 0;
+	size_t FrustumCulled = 0;
+	size_t ConeCulled = 0;
+	size_t Triangles = 0;
+	size_t TrianglesRejected = 0;
+};
+
+// CPU reference for a meshlet culling pass.
+class MeshletCuller
+{
+public:
+	// The six planes (left, right, bottom, top, near, far) of a D3D view-projection
+	// matrix, normalized and facing inwards.
+	static void ExtractFrustumPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6]);
+
+	// Tests the spheres against the planes, then the cones against the camera position,
+	// both in the mesh's space.  visible receives the meshlets that pass, if given.
+	static MeshletCullStatistics Cull(const MeshletData& meshlets, const DirectX::XMFLOAT4 planes[6],
+		const DirectX::XMFLOAT3& cameraPos, std::vector<std::uint32_t>* visible = nullptr);
+};
@@ -1,7 +1,607 @@
 #include "ObjReader.h"
+#include "MappedFile.h"
+#include "MboFile.h"
+#include "MeshNormals.h"
+#include "MeshOptimizer.h"
+#include <cfloat>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <thread>
 
+using namespace DirectX;
 
-bool ObjReader::Read(const wchar_t* mboFileName, const wchar_t* objFileName)
+namespace
+{
+	// Forward-only cursor over the bytes of a mapped OBJ file.  Tokens are views into
+	// the mapping and numbers are converted in place, so no line costs an allocation.
+	struct ObjCursor
+	{
+		const char* cur;
+		const char* end;
+
+		static bool IsBlank(char ch) { return ch == ' ' || ch == '\t' || ch == '\r'; }
+
+		void SkipBlanks()
+		{
+			while (cur < end && IsBlank(*cur))
+				++cur;
+		}
+
+		void SkipLine()
+		{
+			const char* nl = static_cast<const char*>(memchr(cur, '\n', end - cur));
+			cur = nl ? nl + 1 : end;
+		}
+
+		// A # starts a comment that runs to the end of the line.
+		bool AtLineEnd()
+		{
+			SkipBlanks();
+			return cur >= end || *cur == '\n' || *cur == '#';
+		}
+
+		bool Char(char ch)
+		{
+			if (cur < end && *cur == ch)
+			{
+				++cur;
+				return true;
+			}
+			return false;
+		}
+
+		std::string_view Token()
+		{
+			SkipBlanks();
+			const char* beg = cur;
+			while (cur < end && !IsBlank(*cur) && *cur != '\n')
+				++cur;
+			return std::string_view(beg, cur - beg);
+		}
+
+		// The remainder of the line without surrounding blanks; names may contain spaces.
+		std::string_view Rest()
+		{
+			SkipBlanks();
+			const char* beg = cur;
+			const char* nl = static_cast<const char*>(memchr(cur, '\n', end - cur));
+			cur = nl ? nl : end;
+			const char* ed = cur;
+			while (ed > beg && IsBlank(ed[-1]))
+				--ed;
+			return std::string_view(beg, ed - beg);
+		}
+
+		bool Float(float& value)
+		{
+			SkipBlanks();
+			if (cur < end && *cur == '+')
+				++cur;
+			auto res = std::from_chars(cur, end, value);
+			if (res.ec != std::errc())
+				return false;
+			cur = res.ptr;
+			return true;
+		}
+
+		bool Int(int& value)
+		{
+			SkipBlanks();
+			if (cur < end && *cur == '+')
+				++cur;
+			auto res = std::from_chars(cur, end, value);
+			if (res.ec != std::errc())
+				return false;
+			cur = res.ptr;
+			return true;
+		}
+	};
+
+	// File and material names are GBK encoded, matching the "chs" locale of the stream parser.
+	std::wstring GbkToWString(std::string_view str)
+	{
+		if (str.empty())
+			return std::wstring();
+		int len = MultiByteToWideChar(936, 0, str.data(), (int)str.size(), nullptr, 0);
+		std::wstring wstr(len, L'\0');
+		MultiByteToWideChar(936, 0, str.data(), (int)str.size(), &wstr[0], len);
+		return wstr;
+	}
+
+	std::wstring DirectoryOf(const std::wstring& fileName)
+	{
+		size_t pos = fileName.find_last_of(L"/\\");
+		return pos == std::wstring::npos ? std::wstring() : fileName.substr(0, pos + 1);
+	}
+
+	// Face corner indices as written in the file.  0 marks a missing vt/vn.  Relative
+	// (negative) indices are rebased onto the chunk's own attribute counts; the merge
+	// adds the counts of the preceding chunks to those flagged in 'relative'.
+	struct ObjCorner
+	{
+		int vpi, vti, vni;
+		UINT relative;
+	};
+
+	enum : UINT
+	{
+		RelativePos = 1,
+		RelativeTex = 2,
+		RelativeNormal = 4
+	};
+
+	// Smoothing group numbers of faces without vn go into VertexKey::smoothing: 0 until
+	// the first s statement, the group number after one, and after s off or s 0 each face
+	// gets a number of its own with this bit set.
+	const DWORD FlatFace = 0x80000000;
+
+	DWORD ParseSmoothingGroup(std::string_view name)
+	{
+		if (name == "off")
+			return FlatFace;
+		DWORD group = 0;
+		std::from_chars(name.data(), name.data() + name.size(), group);
+		return group == 0 ? FlatFace : group & ~FlatFace;
+	}
+
+	// The corner layouts of the OBJ face grammar.
+	enum class ObjFaceFormat
+	{
+		Unknown,
+		Pos,			// v
+		PosTex,			// v/vt
+		PosNormal,		// v//vn
+		PosTexNormal	// v/vt/vn
+	};
+
+	// Everything whose meaning depends on file order (faces, parts, materials) is
+	// recorded here and replayed serially during the merge.
+	struct ObjStatement
+	{
+		enum Type { Face, Part, UseMtl, MtlLib, Smooth } type;
+		UINT firstCorner;
+		UINT cornerCount;
+		std::string_view name;
+	};
+
+	// The result of parsing one line-aligned byte range of the file.  Attribute
+	// records do not depend on order, so they go straight into the arrays.
+	struct ObjChunk
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<XMFLOAT3> normals;
+		std::vector<XMFLOAT2> texCoords;
+		std::vector<ObjCorner> corners;
+		std::vector<ObjStatement> statements;
+		XMFLOAT3 vMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+		XMFLOAT3 vMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		// Attributes defined by the chunks before this one, filled in by the merge.
+		int posBase = 0, texBase = 0, normalBase = 0;
+	};
+
+	// Looks at the first corner of a face to find which layout the face uses.
+	ObjFaceFormat DetectFaceFormat(const char* p, const char* end)
+	{
+		while (p < end && ObjCursor::IsBlank(*p))
+			++p;
+		while (p < end && (*p == '-' || *p == '+' || (*p >= '0' && *p <= '9')))
+			++p;
+		if (p >= end || *p != '/')
+			return ObjFaceFormat::Pos;
+		if (++p < end && *p == '/')
+			return ObjFaceFormat::PosNormal;
+		while (p < end && (*p == '-' || *p == '+' || (*p >= '0' && *p <= '9')))
+			++p;
+		return (p < end && *p == '/') ? ObjFaceFormat::PosTexNormal : ObjFaceFormat::PosTex;
+	}
+
+	template<ObjFaceFormat Format>
+	bool ParseCorner(ObjCursor& c, ObjCorner& corner)
+	{
+		corner.vti = 0;
+		corner.vni = 0;
+		if (!c.Int(corner.vpi))
+			return false;
+		if constexpr (Format == ObjFaceFormat::PosTex || Format == ObjFaceFormat::PosTexNormal)
+		{
+			if (!c.Char('/') || !c.Int(corner.vti))
+				return false;
+		}
+		if constexpr (Format == ObjFaceFormat::PosNormal)
+		{
+			if (!c.Char('/') || !c.Char('/') || !c.Int(corner.vni))
+				return false;
+		}
+		if constexpr (Format == ObjFaceFormat::PosTexNormal)
+		{
+			if (!c.Char('/') || !c.Int(corner.vni))
+				return false;
+		}
+		// A corner must end at a blank, a comment or the end of the line.
+		return c.cur >= c.end || ObjCursor::IsBlank(*c.cur) || *c.cur == '\n' || *c.cur == '#';
+	}
+
+	// Parses the corners of one face line with the layout fixed at compile time.
+	// Returns false if a corner does not have that layout.
+	template<ObjFaceFormat Format>
+	bool ParseFace(ObjCursor& c, ObjChunk& chunk)
+	{
+		const int posCount = (int)chunk.positions.size();
+		const int texCount = (int)chunk.texCoords.size();
+		const int normalCount = (int)chunk.normals.size();
+
+		while (!c.AtLineEnd())
+		{
+			ObjCorner corner;
+			if (!ParseCorner<Format>(c, corner))
+				return false;
+
+			corner.relative = 0;
+			if (corner.vpi < 0)
+			{
+				corner.vpi += posCount + 1;
+				corner.relative |= RelativePos;
+			}
+			if (corner.vti < 0)
+			{
+				corner.vti += texCount + 1;
+				corner.relative |= RelativeTex;
+			}
+			if (corner.vni < 0)
+			{
+				corner.vni += normalCount + 1;
+				corner.relative |= RelativeNormal;
+			}
+			chunk.corners.push_back(corner);
+		}
+		return true;
+	}
+
+	bool ParseFace(ObjFaceFormat format, ObjCursor& c, ObjChunk& chunk)
+	{
+		switch (format)
+		{
+		case ObjFaceFormat::Pos: return ParseFace<ObjFaceFormat::Pos>(c, chunk);
+		case ObjFaceFormat::PosTex: return ParseFace<ObjFaceFormat::PosTex>(c, chunk);
+		case ObjFaceFormat::PosNormal: return ParseFace<ObjFaceFormat::PosNormal>(c, chunk);
+		case ObjFaceFormat::PosTexNormal: return ParseFace<ObjFaceFormat::PosTexNormal>(c, chunk);
+		default: return false;
+		}
+	}
+
+	// Splits a polygon into triangles, writing corner numbers in [0, n) to tris.  The
+	// triangles have the winding reversed, like every face of the file, because z is
+	// flipped.  Convex polygons become a fan around corner 0; other polygons are ear
+	// clipped against their Newell normal.
+	void TriangulatePolygon(const std::vector<XMFLOAT3>& pos, std::vector<UINT>& tris)
+	{
+		const UINT n = (UINT)pos.size();
+
+		XMVECTOR normal = XMVectorZero();
+		for (UINT i = 0; i < n; ++i)
+		{
+			const XMFLOAT3& a = pos[i];
+			const XMFLOAT3& b = pos[(i + 1) % n];
+			normal += XMVectorSet((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y), 0.0f);
+		}
+
+		auto convex = [&](UINT a, UINT b, UINT c) {
+			XMVECTOR pa = XMLoadFloat3(&pos[a]), pb = XMLoadFloat3(&pos[b]), pc = XMLoadFloat3(&pos[c]);
+			return XMVectorGetX(XMVector3Dot(XMVector3Cross(pb - pa, pc - pb), normal)) >= 0.0f;
+		};
+
+		bool isConvex = true;
+		for (UINT i = 0; i < n && isConvex; ++i)
+			isConvex = convex((i + n - 1) % n, i, (i + 1) % n);
+
+		if (isConvex)
+		{
+			for (UINT i = 1; i + 1 < n; ++i)
+			{
+				tris.push_back(i + 1);
+				tris.push_back(i);
+				tris.push_back(0);
+			}
+			return;
+		}
+
+		std::vector<UINT> ring(n);
+		for (UINT i = 0; i < n; ++i)
+			ring[i] = i;
+
+		auto inside = [&](UINT p, UINT a, UINT b, UINT c) {
+			return convex(a, b, p) && convex(b, c, p) && convex(c, a, p);
+		};
+
+		while (ring.size() > 3)
+		{
+			const UINT m = (UINT)ring.size();
+			UINT ear = m;
+			for (UINT i = 0; i < m && ear == m; ++i)
+			{
+				UINT a = ring[(i + m - 1) % m], b = ring[i], c = ring[(i + 1) % m];
+				if (!convex(a, b, c))
+					continue;
+				bool empty = true;
+				for (UINT j = 0; j < m && empty; ++j)
+				{
+					UINT p = ring[j];
+					if (p != a && p != b && p != c)
+						empty = !inside(p, a, b, c);
+				}
+				if (empty)
+					ear = i;
+			}
+			// Degenerate input: take any corner so the loop always terminates.
+			if (ear == m)
+				ear = 0;
+
+			tris.push_back(ring[(ear + 1) % m]);
+			tris.push_back(ring[ear]);
+			tris.push_back(ring[(ear + m - 1) % m]);
+			ring.erase(ring.begin() + ear);
+		}
+
+		tris.push_back(ring[2]);
+		tris.push_back(ring[1]);
+		tris.push_back(ring[0]);
+	}
+
+	bool ParseObjChunk(const char* beg, const char* end, ObjChunk& chunk)
+	{
+		XMVECTOR vecMin = XMLoadFloat3(&chunk.vMin), vecMax = XMLoadFloat3(&chunk.vMax);
+		ObjFaceFormat format = ObjFaceFormat::Unknown;
+
+		ObjCursor c = { beg, end };
+		for (; c.cur < c.end; c.SkipLine())
+		{
+			std::string_view tok = c.Token();
+			if (tok.empty() || tok[0] == '#')
+				continue;
+
+			if (tok == "v") {
+				XMFLOAT3 pos;
+				if (!c.Float(pos.x) || !c.Float(pos.y) || !c.Float(pos.z))
+					return false;
+				pos.z = -pos.z;
+				chunk.positions.push_back(pos);
+				XMVECTOR vecPos = XMLoadFloat3(&pos);
+				vecMax = XMVectorMax(vecMax, vecPos);
+				vecMin = XMVectorMin(vecMin, vecPos);
+			}
+			else if (tok == "vt") {
+				float u, v = 0.0f;
+				if (!c.Float(u))
+					return false;
+				c.Float(v);
+				chunk.texCoords.emplace_back(XMFLOAT2(u, 1.0f - v));
+			}
+			else if (tok == "vn") {
+				float x, y, z;
+				if (!c.Float(x) || !c.Float(y) || !c.Float(z))
+					return false;
+				chunk.normals.emplace_back(XMFLOAT3(x, y, -z));
+			}
+			else if (tok == "f") {
+				ObjStatement face = { ObjStatement::Face, (UINT)chunk.corners.size() };
+
+				// The layout is detected on the first face of a part and re-detected only
+				// when a face does not match it.
+				const char* lineStart = c.cur;
+				if (format == ObjFaceFormat::Unknown)
+					format = DetectFaceFormat(c.cur, c.end);
+				if (!ParseFace(format, c, chunk))
+				{
+					chunk.corners.resize(face.firstCorner);
+					c.cur = lineStart;
+					format = DetectFaceFormat(c.cur, c.end);
+					if (!ParseFace(format, c, chunk))
+						return false;
+				}
+
+				face.cornerCount = (UINT)chunk.corners.size() - face.firstCorner;
+				if (face.cornerCount < 3)
+					return false;
+				chunk.statements.push_back(face);
+			}
+			else if (tok == "o" || tok == "g") {
+				chunk.statements.push_back({ ObjStatement::Part, 0, 0, c.Rest() });
+				format = ObjFaceFormat::Unknown;
+			}
+			else if (tok == "mtllib") {
+				chunk.statements.push_back({ ObjStatement::MtlLib, 0, 0, c.Rest() });
+			}
+			else if (tok == "usemtl") {
+				chunk.statements.push_back({ ObjStatement::UseMtl, 0, 0, c.Rest() });
+			}
+			else if (tok == "s") {
+				chunk.statements.push_back({ ObjStatement::Smooth, 0, 0, c.Rest() });
+			}
+		}
+
+		XMStoreFloat3(&chunk.vMin, vecMin);
+		XMStoreFloat3(&chunk.vMax, vecMax);
+		return true;
+	}
+}
+
+
+// Replays parsed chunks into objParts in file order.  Every entry point funnels through
+// here, so serial, parallel and streaming reads produce the same parts.
+struct ObjReader::ChunkMerger
+{
+	ChunkMerger(ObjReader& reader, const wchar_t* objFileName, const PartSink* sink) :
+		reader(reader), dir(DirectoryOf(objFileName)), sink(sink) {}
+
+	void Reserve(size_t positionCount, size_t normalCount, size_t texCoordCount)
+	{
+		positions.reserve(positionCount);
+		normals.reserve(normalCount);
+		texCoords.reserve(texCoordCount);
+	}
+
+	bool Merge(ObjChunk& chunk);
+	// Hands the current part to the sink and frees it.
+	bool EndPart();
+	bool Finish();
+
+	ObjReader& reader;
+	std::wstring dir;
+	const PartSink* sink;
+	MtlReader mtlReader;
+
+	std::vector<XMFLOAT3>   positions;
+	std::vector<XMFLOAT3>   normals;
+	std::vector<XMFLOAT2>   texCoords;
+	XMFLOAT3 vMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+	XMFLOAT3 vMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	// The current s statement as ParseSmoothingGroup reads it, and the faces made flat.
+	DWORD smoothing = 0;
+	DWORD flatFaces = 0;
+
+	// Scratch space for one face.
+	std::vector<VertexKey> faceKeys;
+	std::vector<XMFLOAT3> facePositions;
+	std::vector<UINT> faceTris;
+};
+
+bool ObjReader::ChunkMerger::Merge(ObjChunk& chunk)
+{
+	chunk.posBase = (int)positions.size();
+	chunk.texBase = (int)texCoords.size();
+	chunk.normalBase = (int)normals.size();
+	positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+	normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+	texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+	std::vector<XMFLOAT3>().swap(chunk.positions);
+	std::vector<XMFLOAT3>().swap(chunk.normals);
+	std::vector<XMFLOAT2>().swap(chunk.texCoords);
+
+	XMStoreFloat3(&vMin, XMVectorMin(XMLoadFloat3(&vMin), XMLoadFloat3(&chunk.vMin)));
+	XMStoreFloat3(&vMax, XMVectorMax(XMLoadFloat3(&vMax), XMLoadFloat3(&chunk.vMax)));
+
+	std::vector<ObjPart>& objParts = reader.objParts;
+	for (auto& statement : chunk.statements)
+	{
+		switch (statement.type)
+		{
+		case ObjStatement::Face:
+		{
+			if (objParts.empty())
+				reader.BeginPart();
+
+			DWORD faceSmoothing = smoothing == FlatFace ? FlatFace | (flatFaces++ & ~FlatFace) : smoothing;
+			faceKeys.clear();
+			for (UINT i = 0; i < statement.cornerCount; ++i)
+			{
+				const ObjCorner& corner = chunk.corners[statement.firstCorner + i];
+				int vpi = corner.vpi + ((corner.relative & RelativePos) ? chunk.posBase : 0);
+				int vti = corner.vti + ((corner.relative & RelativeTex) ? chunk.texBase : 0);
+				int vni = corner.vni + ((corner.relative & RelativeNormal) ? chunk.normalBase : 0);
+				// vt and vn are optional (0) unless written as a relative index.
+				if (vpi < 1 || (size_t)vpi > positions.size() ||
+					vti < ((corner.relative & RelativeTex) ? 1 : 0) || (size_t)vti > texCoords.size() ||
+					vni < ((corner.relative & RelativeNormal) ? 1 : 0) || (size_t)vni > normals.size())
+					return false;
+
+				faceKeys.push_back({ (DWORD)vpi, (DWORD)vti, (DWORD)vni, vni ? 0 : faceSmoothing });
+			}
+
+			static const UINT triangle[3] = { 2, 1, 0 };
+			const UINT* tris = triangle;
+			size_t triCornerCount = 3;
+			if (statement.cornerCount > 3)
+			{
+				facePositions.clear();
+				for (const VertexKey& key : faceKeys)
+					facePositions.push_back(positions[key.vpi - 1]);
+				faceTris.clear();
+				TriangulatePolygon(facePositions, faceTris);
+				tris = faceTris.data();
+				triCornerCount = faceTris.size();
+			}
+
+			for (size_t t = 0; t < triCornerCount; ++t)
+			{
+				const VertexKey& key = faceKeys[tris[t]];
+				VertexPosNormalTex vertex;
+				vertex.pos = positions[key.vpi - 1];
+				vertex.normal = key.vni ? normals[key.vni - 1] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+				vertex.tex = key.vti ? texCoords[key.vti - 1] : XMFLOAT2(0.0f, 0.0f);
+				reader.AddVertex(vertex, key.vpi, key.vti, key.vni, key.smoothing);
+			}
+			break;
+		}
+		case ObjStatement::Part:
+			if (sink && !EndPart())
+				return false;
+			reader.BeginPart(statement.name);
+			break;
+		case ObjStatement::MtlLib:
+			mtlReader.ReadMtl((dir + GbkToWString(statement.name)).c_str());
+			break;
+		case ObjStatement::Smooth:
+			smoothing = ParseSmoothingGroup(statement.name);
+			break;
+		case ObjStatement::UseMtl:
+		{
+			if (objParts.empty())
+				reader.BeginPart();
+
+			std::wstring mtlName = GbkToWString(statement.name);
+			objParts.back().material = mtlReader.materials[mtlName];
+			objParts.back().texStrDiffuse = mtlReader.mapKdStrs[mtlName];
+			break;
+		}
+		}
+	}
+
+	std::vector<ObjCorner>().swap(chunk.corners);
+	std::vector<ObjStatement>().swap(chunk.statements);
+	return true;
+}
+
+bool ObjReader::ChunkMerger::EndPart()
+{
+	if (reader.objParts.empty())
+		return true;
+
+	reader.FinishPart(reader.objParts.back());
+	bool status = (*sink)(reader.objParts.back());
+	reader.objParts.clear();
+	return status;
+}
+
+bool ObjReader::ChunkMerger::Finish()
+{
+	bool status = true;
+	if (sink)
+	{
+		status = EndPart();
+	}
+	else
+	{
+		for (auto& part : reader.objParts)
+			reader.FinishPart(part);
+	}
+
+	// Files without any position keep the infinite AABB.
+	if (vMin.x <= vMax.x)
+	{
+		reader.vMin = vMin;
+		reader.vMax = vMax;
+	}
+	else
+	{
+		XMStoreFloat3(&reader.vMin, g_XMInfinity);
+		XMStoreFloat3(&reader.vMax, g_XMNegInfinity);
+	}
+	return status;
+}
+
+bool ObjReader::Read(const wchar_t* mboFileName, const wchar_t* objFileName, UINT cookFlags)
 {
 	if (mboFileName && ReadMbo(mboFileName))
 	{
@@ -11,17 +611,158 @@ bool ObjReader::Read(const wchar_t* mboFileName, const wchar_t* objFileName)
 	{
 		bool status = ReadObj(objFileName);
 		if (status && mboFileName)
-			return WriteMbo(mboFileName);
+			return WriteMbo(mboFileName, false, false, cookFlags);
 		return status;
 	}
 
 	return false;
 }
 
-bool ObjReader::ReadObj(const wchar_t* objFileName)
+bool ObjReader::ReadObj(const wchar_t* objFileName, UINT numThreads)
 {
-	objParts.clear();
-	vertexCache.clear();
+	BeginRead(numThreads);
+
+	MappedFile file;
+	if (!file.Open(objFileName))
+		return false;
+
+	//
+	// Split the file at line boundaries and parse the chunks independently.
+	//
+
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	// Chunks smaller than this are not worth a thread.
+	const size_t minChunkBytes = 1 << 20;
+	numThreads = (UINT)std::min<size_t>(numThreads, std::max<size_t>(1, file.Size() / minChunkBytes));
+
+	std::vector<const char*> bounds(numThreads + 1);
+	bounds[0] = file.Data();
+	bounds[numThreads] = file.End();
+	for (UINT i = 1; i < numThreads; ++i)
+	{
+		const char* p = std::max(bounds[i - 1], file.Data() + file.Size() / numThreads * i);
+		const char* nl = static_cast<const char*>(memchr(p, '\n', file.End() - p));
+		bounds[i] = nl ? nl + 1 : file.End();
+	}
+
+	std::vector<ObjChunk> chunks(numThreads);
+	std::unique_ptr<bool[]> status(new bool[numThreads]);
+	if (numThreads == 1)
+	{
+		status[0] = ParseObjChunk(bounds[0], bounds[1], chunks[0]);
+	}
+	else
+	{
+		std::vector<std::thread> workers;
+		for (UINT i = 0; i < numThreads; ++i)
+		{
+			workers.emplace_back([&, i]() {
+				status[i] = ParseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+			});
+		}
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	for (UINT i = 0; i < numThreads; ++i)
+	{
+		if (!status[i])
+			return false;
+	}
+
+	//
+	// Merge in file order so the parts, indices and AABB match a serial parse exactly.
+	//
+
+	ChunkMerger merger(*this, objFileName, nullptr);
+
+	size_t positionCount = 0, normalCount = 0, texCoordCount = 0;
+	size_t partCount = 1;
+	for (auto& chunk : chunks)
+	{
+		positionCount += chunk.positions.size();
+		normalCount += chunk.normals.size();
+		texCoordCount += chunk.texCoords.size();
+		for (auto& statement : chunk.statements)
+			partCount += statement.type == ObjStatement::Part;
+	}
+	merger.Reserve(positionCount, normalCount, texCoordCount);
+	// Size the vertex cache for an average part; larger parts grow it once and keep it.
+	// A shared pool keeps one cache for the whole file.
+	vertexCache.Reserve(std::max({ positionCount, normalCount, texCoordCount }) / (sharedPool ? 1 : partCount));
+
+	for (auto& chunk : chunks)
+	{
+		if (!merger.Merge(chunk))
+			return false;
+	}
+
+	return merger.Finish();
+}
+
+bool ObjReader::ReadObjPooled(const wchar_t* objFileName, UINT numThreads)
+{
+	pool = ObjPool();
+
+	sharedPool = true;
+	bool status = ReadObj(objFileName, numThreads);
+	sharedPool = false;
+	if (!status)
+		return false;
+
+	FinishPool();
+	return true;
+}
+
+void ObjReader::GetDrawArgs(std::unordered_map<std::string, SubmeshGeometry>& drawArgs)const
+{
+	for (size_t i = 0; i < pool.submeshes.size() && i < objParts.size(); ++i)
+	{
+		if (pool.submeshes[i].IndexCount == 0)
+			continue;
+
+		std::string name = objParts[i].name.empty() ? "part" + std::to_string(i) : objParts[i].name;
+		if (drawArgs.count(name))
+			name += "#" + std::to_string(i);
+		drawArgs[name] = pool.submeshes[i];
+	}
+}
+
+bool ObjReader::ReadObjStreaming(const wchar_t* objFileName, const PartSink& sink)
+{
+	BeginRead(1);
+
+	MappedFile file;
+	if (!file.Open(objFileName))
+		return false;
+
+	ChunkMerger merger(*this, objFileName, &sink);
+
+	// Parse a window of whole lines at a time so that at most one window of face
+	// records is buffered, then replay it straight away.
+	const size_t windowBytes = 16 << 20;
+	for (const char* beg = file.Data(); beg < file.End();)
+	{
+		const char* end = beg + std::min<size_t>(windowBytes, file.End() - beg);
+		if (end < file.End())
+		{
+			const char* nl = static_cast<const char*>(memchr(end, '\n', file.End() - end));
+			end = nl ? nl + 1 : file.End();
+		}
+
+		ObjChunk chunk;
+		if (!ParseObjChunk(beg, end, chunk) || !merger.Merge(chunk))
+			return false;
+		beg = end;
+	}
+
+	return merger.Finish();
+}
+
+bool ObjReader::ReadObjStream(const wchar_t* objFileName)
+{
+	BeginRead(1);
 
 	MtlReader mtlReader;
 
@@ -47,17 +788,11 @@ bool ObjReader::ReadObj(const wchar_t* objFileName)
 			while (!wfin.eof() && wfin.get() != '\n')
 				continue;
 		}
-		else if (wstr[0] == L"o" || wstr[0] == L"g") {
+		else if (wstr == L"o" || wstr == L"g") {
 			// 
 			// ()
 			//
-			ObjPart part;
-			part.material.AmbientStrength = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
-			part.material.DiffuseAlbedo = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
-			part.material.SpecularStrength = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-
-			objParts.emplace_back(std::move(part));
-			vertexCache.clear();
+			BeginPart();
 		}
 		else if (wstr == L"v") {
 			//
@@ -152,9 +887,16 @@ bool ObjReader::ReadObj(const wchar_t* objFileName)
 
 			for (int i = 0; i < 3; ++i)
 			{
+				if (vpi[i] < 1 || vpi[i] > positions.size())
+					return false;
+				// Missing or unreadable vt and vn count as absent.
+				if (vti[i] > texCoords.size())
+					vti[i] = 0;
+				if (vni[i] > normals.size())
+					vni[i] = 0;
 				vertex.pos = positions[vpi[i] - 1];
-				vertex.normal = normals[vni[i] - 1];
-				vertex.tex = texCoords[vti[i] - 1];
+				vertex.normal = vni[i] ? normals[vni[i] - 1] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+				vertex.tex = vti[i] ? texCoords[vti[i] - 1] : XMFLOAT2(0.0f, 0.0f);
 				AddVertex(vertex, vpi[i], vti[i], vni[i]);
 			}
 
@@ -167,32 +909,105 @@ bool ObjReader::ReadObj(const wchar_t* objFileName)
 		}
 	}
 
-	// WORDֵĻʹ16λWORD洢
 	for (auto& part : objParts)
+		FinishPart(part);
+
+	XMStoreFloat3(&vMax, vecMax);
+	XMStoreFloat3(&vMin, vecMin);
+
+	return true;
+}
+
+bool ObjReader::ReadMbo(const wchar_t* mboFileName)
+{
+	if (!MboFile::IsMboV2(mboFileName))
+		return ReadMboV1(mboFileName);
+
+	MboFile file;
+	if (!file.Open(mboFileName))
+		return false;
+
+	vMin = file.Header().VMin;
+	vMax = file.Header().VMax;
+
+	BeginRead(1);
+	objParts.resize(file.PartCount());
+	for (UINT i = 0; i < file.PartCount(); ++i)
 	{
-		if (part.vertices.size() < 65535)
+		ObjPart& part = objParts[i];
+		part.name = file.PartName(i);
+		part.texStrDiffuse = file.PartTexture(i);
+		FromMboMaterial(file.Part(i).Material, part.material);
+
+		if (file.IsQuantized())
+		{
+			auto quantized = file.QuantizedVertices(i);
+			part.vertices.resize(quantized.size());
+			VertexQuantization::Decode(quantized.Data, quantized.size(), file.PartBounds(i), part.vertices.data());
+		}
+		else
+		{
+			auto vertices = file.Vertices(i);
+			part.vertices.assign(vertices.begin(), vertices.end());
+		}
+
+		auto indices16 = file.Indices16(i);
+		auto indices32 = file.Indices32(i);
+		part.indices16.assign(indices16.begin(), indices16.end());
+		part.indices32.assign(indices32.begin(), indices32.end());
+
+		if (file.HasMeshlets())
 		{
-			for (auto& i : part.indices32)
+			const MboMeshletRange& range = file.MeshletRange(i);
+			const MboMeshlets& meshlets = file.Meshlets();
+			for (UINT m = range.FirstMeshlet; m < range.FirstMeshlet + range.MeshletCount; ++m)
 			{
-				part.indices16.push_back((WORD)i);
+				Meshlet meshlet = meshlets.Meshlets[m];
+				const std::uint32_t* vertices = meshlets.Vertices.Data + meshlet.VertexOffset;
+				const std::uint32_t* triangles = meshlets.Triangles.Data + meshlet.TriangleOffset;
+				meshlet.VertexOffset = (std::uint32_t)part.meshlets.Vertices.size();
+				meshlet.TriangleOffset = (std::uint32_t)part.meshlets.Triangles.size();
+				part.meshlets.Meshlets.push_back(meshlet);
+				part.meshlets.Vertices.insert(part.meshlets.Vertices.end(), vertices, vertices + meshlet.VertexCount);
+				part.meshlets.Triangles.insert(part.meshlets.Triangles.end(), triangles, triangles + meshlet.TriangleCount);
+				part.meshlets.Spheres.push_back(meshlets.Spheres[m]);
+				part.meshlets.BoxCenters.push_back(meshlets.BoxCenters[m]);
+				part.meshlets.BoxExtents.push_back(meshlets.BoxExtents[m]);
+				part.meshlets.ConeApexes.push_back(meshlets.ConeApexes[m]);
+				part.meshlets.ConeAxes.push_back(meshlets.ConeAxes[m]);
 			}
-			part.indices32.clear();
 		}
-		else {
-			for (auto& i : part.indices32)
+
+		if (file.HasLods())
+		{
+			const MboLodRange& range = file.LodRange(i);
+			part.lods.resize(range.LodCount);
+			for (UINT lod = 0; lod < range.LodCount; ++lod)
 			{
-				part.indices32.push_back((WORD)i);
+				auto lodIndices16 = file.LodIndices16(i, lod);
+				auto lodIndices32 = file.LodIndices32(i, lod);
+				part.lods[lod].error = file.Lod(range.FirstLod + lod).Error;
+				part.lods[lod].indices16.assign(lodIndices16.begin(), lodIndices16.end());
+				part.lods[lod].indices32.assign(lodIndices32.begin(), lodIndices32.end());
 			}
-			part.indices16.clear();
+		}
+
+		if (file.HasClusterDags())
+		{
+			const MboClusterDagRange& range = file.ClusterDagRange(i);
+			const MboClusterDags& dags = file.ClusterDags();
+			ClusterDag& dag = part.clusterDag;
+			dag.Clusters.assign(dags.Clusters.Data + range.FirstCluster, dags.Clusters.Data + range.FirstCluster + range.ClusterCount);
+			dag.Groups.assign(dags.Groups.Data + range.FirstGroup, dags.Groups.Data + range.FirstGroup + range.GroupCount);
+			dag.Children.assign(dags.Children.Data + range.FirstChild, dags.Children.Data + range.FirstChild + range.ChildCount);
+			dag.Indices.assign(dags.Indices.Data + range.FirstIndex, dags.Indices.Data + range.FirstIndex + range.IndexCount);
 		}
 	}
-	XMStoreFloat3(&vMax, vecMax);
-	XMStoreFloat3(&vMin, vecMin);
 
 	return true;
 }
 
-bool ObjReader::ReadMbo(const wchar_t* mboFileName)
+bool ObjReader::ReadMboV1(const wchar_t* mboFileName)
 {
 	// [PartĿ] 4ֽ
 // [AABBжvMax] 12ֽ
@@ -210,7 +1025,8 @@ bool ObjReader::ReadMbo(const wchar_t* mboFileName)
 	if (!fin.is_open())
 		return false;
 
-	UINT parts = (UINT)objParts.size();
+	BeginRead(1);
+	UINT parts = 0;
 	// [PartĿ] 4ֽ
 	fin.read(reinterpret_cast<char*>(&parts), sizeof(UINT));
 	objParts.resize(parts);
@@ -227,8 +1043,16 @@ bool ObjReader::ReadMbo(const wchar_t* mboFileName)
 		// [ļ]520ֽ
 		fin.read(reinterpret_cast<char*>(filePath), MAX_PATH * sizeof(wchar_t));
 		objParts[i].texStrDiffuse = filePath;
-		// []64ֽ
-		fin.read(reinterpret_cast<char*>(&objParts[i].material), sizeof(Material));
+		// []sizeof(Material)ֽ
+		// v1 dumped the whole Material, std::string included; only the shading fields
+		// that follow the name are meaningful.
+		std::vector<char> material(sizeof(Material));
+		fin.read(material.data(), material.size());
+		Material& dst = objParts[i].material;
+		const char* shadingBeg = reinterpret_cast<const char*>(&dst.BaseColor);
+		const char* shadingEnd = reinterpret_cast<const char*>(&dst.MatTransform + 1);
+		size_t shadingOffset = shadingBeg - reinterpret_cast<const char*>(&dst);
+		std::memcpy(&dst.BaseColor, material.data() + shadingOffset, shadingEnd - shadingBeg);
 		UINT vertexCount, indexCount;
 		// []4ֽ
 		fin.read(reinterpret_cast<char*>(&vertexCount), sizeof(UINT));
@@ -252,94 +1076,377 @@ bool ObjReader::ReadMbo(const wchar_t* mboFileName)
 		}
 	}
 
+	bool status = (bool)fin;
 	fin.close();
 
-	return true;
+	return status;
 }
 
-bool ObjReader::WriteMbo(const wchar_t* mboFileName)
+bool ObjReader::WriteMbo(const wchar_t* mboFileName, bool compress, bool quantize, UINT cookFlags)
 {
-	// [PartĿ] 4ֽ
-	// [AABBжvMax] 12ֽ
-	// [AABBжvMin] 12ֽ
-	// [Part
-	//   [ļ]520ֽ
-	//   [ļ]520ֽ
-	//   []64ֽ
-	//   []4ֽ
-	//   []4ֽ
-	//   []32* ֽ
-	//   []2(4)* ֽڣȡڶǷ񲻳65535
-	// ]
-	// ...
-	std::ofstream fout(mboFileName, std::ios::out | std::ios::binary);
-	UINT parts = (UINT)objParts.size();
-	// [PartĿ] 4ֽ
-	fout.write(reinterpret_cast<const char*>(&parts), sizeof(UINT));
+	cookStatistics = CookStatistics();
+	if (cookFlags != 0)
+	{
+		for (ObjPart& objPart : objParts)
+		{
+			MeshCookReport report = MeshOptimizer::Cook(objPart, cookFlags);
+			cookStatistics.Indices += objPart.indices16.size() + objPart.indices32.size();
+			cookStatistics.VerticesTransformedBefore += report.CacheBefore.VerticesTransformed;
+			cookStatistics.VerticesTransformedAfter += report.CacheAfter.VerticesTransformed;
+			cookStatistics.BytesFetchedBefore += report.FetchBefore.BytesFetched;
+			cookStatistics.BytesFetchedAfter += report.FetchAfter.BytesFetched;
+		}
+	}
 
-	// [AABBжvMax] 12ֽ
-	fout.write(reinterpret_cast<const char*>(&vMax), sizeof(XMFLOAT3));
-	// [AABBжvMin] 12ֽ
-	fout.write(reinterpret_cast<const char*>(&vMin), sizeof(XMFLOAT3));
+	// Parts keep their own vertex and index ranges; the indices of each part go to the
+	// 16-bit or the 32-bit section depending on which vector FinishPart filled.
+	MboWriter writer;
+	writer.SetCompression(compress);
+	std::vector<MboPart> parts;
+	std::vector<VertexPosNormalTex> vertices;
+	std::vector<VertexPosNormalTexQuantized> quantizedVertices;
+	std::vector<QuantizationBounds> bounds;
+	std::vector<WORD> indices16;
+	std::vector<DWORD> indices32;
+	std::vector<MboMeshletRange> meshletRanges;
+	MeshletData meshlets;
+	std::vector<MboLodRange> lodRanges;
+	std::vector<MboLod> lods;
+	std::vector<MboClusterDagRange> dagRanges;
+	ClusterDag dags;
 
-	// [Part
-	for (UINT i = 0; i < parts; ++i)
+	for (const ObjPart& objPart : objParts)
 	{
-		wchar_t filePath[MAX_PATH];
-		wcscpy_s(filePath, objParts[i].texStrDiffuse.c_str());
-		// [ļ]520ֽ
-		fout.write(reinterpret_cast<const char*>(filePath), MAX_PATH * sizeof(wchar_t));
-		// []64ֽ
-		fout.write(reinterpret_cast<const char*>(&objParts[i].material), sizeof(Material));
-		UINT vertexCount = (UINT)objParts[i].vertices.size();
-		// []4ֽ
-		fout.write(reinterpret_cast<const char*>(&vertexCount), sizeof(UINT));
+		MboPart part = {};
+		part.Material = ToMboMaterial(objPart.material);
+		part.Name = writer.AddString(objPart.name.data(), objPart.name.size());
+		std::u16string texture(objPart.texStrDiffuse.begin(), objPart.texStrDiffuse.end());
+		part.Texture = writer.AddString(texture.data(), texture.size() * sizeof(char16_t));
 
-		UINT indexCount;
-		if (vertexCount > 65535)
+		part.FirstVertex = (std::uint32_t)(quantize ? quantizedVertices.size() : vertices.size());
+		part.VertexCount = (std::uint32_t)objPart.vertices.size();
+		if (quantize)
 		{
-			indexCount = (UINT)objParts[i].indices32.size();
-			// []4ֽ
-			fout.write(reinterpret_cast<const char*>(&indexCount), sizeof(UINT));
-			// []32* ֽ
-			fout.write(reinterpret_cast<const char*>(objParts[i].vertices.data()), vertexCount * sizeof(VertexPosNormalTex));
-			// []4* ֽ
-			fout.write(reinterpret_cast<const char*>(objParts[i].indices32.data()), indexCount * sizeof(DWORD));
+			bounds.push_back(VertexQuantization::ComputeBounds(objPart.vertices.data(), objPart.vertices.size()));
+			quantizedVertices.resize(quantizedVertices.size() + objPart.vertices.size());
+			VertexQuantization::Encode(objPart.vertices.data(), objPart.vertices.size(), bounds.back(),
+				quantizedVertices.data() + part.FirstVertex);
 		}
 		else
 		{
-			indexCount = (UINT)objParts[i].indices16.size();
-			// []4ֽ
-			fout.write(reinterpret_cast<const char*>(&indexCount), sizeof(UINT));
-			// []32* ֽ
-			fout.write(reinterpret_cast<const char*>(objParts[i].vertices.data()), vertexCount * sizeof(VertexPosNormalTex));
-			// []2* ֽ
-			fout.write(reinterpret_cast<const char*>(objParts[i].indices16.data()), indexCount * sizeof(WORD));
+			vertices.insert(vertices.end(), objPart.vertices.begin(), objPart.vertices.end());
+		}
+
+		if (objPart.indices32.empty())
+		{
+			part.FirstIndex = (std::uint32_t)indices16.size();
+			part.IndexCount = (std::uint32_t)objPart.indices16.size();
+			part.IndexStride = sizeof(WORD);
+			indices16.insert(indices16.end(), objPart.indices16.begin(), objPart.indices16.end());
+		}
+		else
+		{
+			part.FirstIndex = (std::uint32_t)indices32.size();
+			part.IndexCount = (std::uint32_t)objPart.indices32.size();
+			part.IndexStride = sizeof(DWORD);
+			indices32.insert(indices32.end(), objPart.indices32.begin(), objPart.indices32.end());
+		}
+		parts.push_back(part);
+
+		lodRanges.push_back({ (std::uint32_t)lods.size(), (std::uint32_t)objPart.lods.size() });
+		for (const ObjLod& objLod : objPart.lods)
+		{
+			MboLod lod = {};
+			lod.Error = objLod.error;
+			if (part.IndexStride == sizeof(WORD))
+			{
+				lod.FirstIndex = (std::uint32_t)indices16.size();
+				lod.IndexCount = (std::uint32_t)objLod.indices16.size();
+				indices16.insert(indices16.end(), objLod.indices16.begin(), objLod.indices16.end());
+			}
+			else
+			{
+				lod.FirstIndex = (std::uint32_t)indices32.size();
+				lod.IndexCount = (std::uint32_t)objLod.indices32.size();
+				indices32.insert(indices32.end(), objLod.indices32.begin(), objLod.indices32.end());
+			}
+			lods.push_back(lod);
 		}
+
+		const MeshletData& partMeshlets = objPart.meshlets;
+		meshletRanges.push_back({ (std::uint32_t)meshlets.size(), (std::uint32_t)partMeshlets.size() });
+		for (Meshlet meshlet : partMeshlets.Meshlets)
+		{
+			meshlet.VertexOffset += (std::uint32_t)meshlets.Vertices.size();
+			meshlet.TriangleOffset += (std::uint32_t)meshlets.Triangles.size();
+			meshlets.Meshlets.push_back(meshlet);
+		}
+		meshlets.Vertices.insert(meshlets.Vertices.end(), partMeshlets.Vertices.begin(), partMeshlets.Vertices.end());
+		meshlets.Triangles.insert(meshlets.Triangles.end(), partMeshlets.Triangles.begin(), partMeshlets.Triangles.end());
+		meshlets.Spheres.insert(meshlets.Spheres.end(), partMeshlets.Spheres.begin(), partMeshlets.Spheres.end());
+		meshlets.BoxCenters.insert(meshlets.BoxCenters.end(), partMeshlets.BoxCenters.begin(), partMeshlets.BoxCenters.end());
+		meshlets.BoxExtents.insert(meshlets.BoxExtents.end(), partMeshlets.BoxExtents.begin(), partMeshlets.BoxExtents.end());
+		meshlets.ConeApexes.insert(meshlets.ConeApexes.end(), partMeshlets.ConeApexes.begin(), partMeshlets.ConeApexes.end());
+		meshlets.ConeAxes.insert(meshlets.ConeAxes.end(), partMeshlets.ConeAxes.begin(), partMeshlets.ConeAxes.end());
+
+		const ClusterDag& dag = objPart.clusterDag;
+		dagRanges.push_back({ (std::uint32_t)dags.Clusters.size(), (std::uint32_t)dag.Clusters.size(),
+			(std::uint32_t)dags.Groups.size(), (std::uint32_t)dag.Groups.size(),
+			(std::uint32_t)dags.Children.size(), (std::uint32_t)dag.Children.size(),
+			(std::uint32_t)dags.Indices.size(), (std::uint32_t)dag.Indices.size() });
+		dags.Clusters.insert(dags.Clusters.end(), dag.Clusters.begin(), dag.Clusters.end());
+		dags.Groups.insert(dags.Groups.end(), dag.Groups.begin(), dag.Groups.end());
+		dags.Children.insert(dags.Children.end(), dag.Children.begin(), dag.Children.end());
+		dags.Indices.insert(dags.Indices.end(), dag.Indices.begin(), dag.Indices.end());
 	}
-	// ]
-	fout.close();
 
-	return true;
+	writer.AddSection(MboSectionType::Parts, sizeof(MboPart), parts.data(), parts.size() * sizeof(MboPart));
+	if (quantize)
+	{
+		writer.AddSection(MboSectionType::QuantizedVertices, sizeof(VertexPosNormalTexQuantized),
+			quantizedVertices.data(), quantizedVertices.size() * sizeof(VertexPosNormalTexQuantized));
+		writer.AddSection(MboSectionType::QuantizationBounds, sizeof(QuantizationBounds), bounds.data(), bounds.size() * sizeof(QuantizationBounds));
+	}
+	else
+	{
+		writer.AddSection(MboSectionType::Vertices, sizeof(VertexPosNormalTex), vertices.data(), vertices.size() * sizeof(VertexPosNormalTex));
+	}
+	writer.AddSection(MboSectionType::Indices16, sizeof(WORD), indices16.data(), indices16.size() * sizeof(WORD));
+	writer.AddSection(MboSectionType::Indices32, sizeof(DWORD), indices32.data(), indices32.size() * sizeof(DWORD));
+	if (!meshlets.empty())
+	{
+		writer.AddSection(MboSectionType::MeshletRanges, sizeof(MboMeshletRange), meshletRanges.data(), meshletRanges.size() * sizeof(MboMeshletRange));
+		writer.AddSection(MboSectionType::Meshlets, sizeof(Meshlet), meshlets.Meshlets.data(), meshlets.size() * sizeof(Meshlet));
+		writer.AddSection(MboSectionType::MeshletVertices, sizeof(std::uint32_t), meshlets.Vertices.data(), meshlets.Vertices.size() * sizeof(std::uint32_t));
+		writer.AddSection(MboSectionType::MeshletTriangles, sizeof(std::uint32_t), meshlets.Triangles.data(), meshlets.Triangles.size() * sizeof(std::uint32_t));
+		writer.AddSection(MboSectionType::MeshletSpheres, sizeof(XMFLOAT4), meshlets.Spheres.data(), meshlets.size() * sizeof(XMFLOAT4));
+		writer.AddSection(MboSectionType::MeshletBoxCenters, sizeof(XMFLOAT3), meshlets.BoxCenters.data(), meshlets.size() * sizeof(XMFLOAT3));
+		writer.AddSection(MboSectionType::MeshletBoxExtents, sizeof(XMFLOAT3), meshlets.BoxExtents.data(), meshlets.size() * sizeof(XMFLOAT3));
+		writer.AddSection(MboSectionType::MeshletConeApexes, sizeof(XMFLOAT3), meshlets.ConeApexes.data(), meshlets.size() * sizeof(XMFLOAT3));
+		writer.AddSection(MboSectionType::MeshletConeAxes, sizeof(XMFLOAT4), meshlets.ConeAxes.data(), meshlets.size() * sizeof(XMFLOAT4));
+	}
+	if (!lods.empty())
+	{
+		writer.AddSection(MboSectionType::LodRanges, sizeof(MboLodRange), lodRanges.data(), lodRanges.size() * sizeof(MboLodRange));
+		writer.AddSection(MboSectionType::Lods, sizeof(MboLod), lods.data(), lods.size() * sizeof(MboLod));
+	}
+	if (!dags.empty())
+	{
+		writer.AddSection(MboSectionType::ClusterDagRanges, sizeof(MboClusterDagRange), dagRanges.data(), dagRanges.size() * sizeof(MboClusterDagRange));
+		writer.AddSection(MboSectionType::ClusterDagClusters, sizeof(ClusterDagCluster), dags.Clusters.data(), dags.Clusters.size() * sizeof(ClusterDagCluster));
+		writer.AddSection(MboSectionType::ClusterDagGroups, sizeof(ClusterDagGroup), dags.Groups.data(), dags.Groups.size() * sizeof(ClusterDagGroup));
+		writer.AddSection(MboSectionType::ClusterDagChildren, sizeof(std::uint32_t), dags.Children.data(), dags.Children.size() * sizeof(std::uint32_t));
+		writer.AddSection(MboSectionType::ClusterDagIndices, sizeof(std::uint32_t), dags.Indices.data(), dags.Indices.size() * sizeof(std::uint32_t));
+	}
+
+	return writer.Write(mboFileName, vMin, vMax);
 }
 
-void ObjReader::AddVertex(const VertexPosNormalTex& vertex, DWORD vpi, DWORD vti, DWORD vni)
+void ObjReader::BeginPart(std::string_view name)
 {
-	std::wstring idxStr = std::to_wstring(vpi) + L"/" + std::to_wstring(vti) + L"/" + std::to_wstring(vni);
+	ObjPart part;
+	part.name = name;
+	part.material.AmbientColor = XMFLOAT4(0.2f, 0.2f, 0.2f, 1.0f);
+	part.material.DiffuseAlbedo = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
+	part.material.SpecularStrength = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 
-	//
-	auto it = vertexCache.find(idxStr);
-	if (it != vertexCache.end()) {
-		objParts.back().indices32.push_back(it->second);
+	if (!sharedPool && !objParts.empty())
+		FinishVertices(objParts.back().vertices, objParts.back().indices32, true);
+	objParts.emplace_back(std::move(part));
+
+	if (sharedPool)
+	{
+		SubmeshGeometry submesh;
+		submesh.StartIndexLocation = (UINT)pool.indices32.size();
+		pool.submeshes.push_back(submesh);
 	}
-	else {
-		objParts.back().vertices.push_back(vertex);
-		DWORD pos = (DWORD)objParts.back().vertices.size() - 1;
-		vertexCache[idxStr] = pos;
-		objParts.back().indices32.push_back(pos);
+	else
+	{
+		ClearVertexCache();
 	}
 }
 
+void ObjReader::FinishPart(ObjPart& part)
+{
+	// Earlier parts got their normals when the next one began.
+	if (!sharedPool && &part == &objParts.back())
+		FinishVertices(part.vertices, part.indices32, true);
+
+	// WORDֵĻʹ16λWORD洢
+	if (part.vertices.size() <= 65535)
+	{
+		part.indices16.resize(part.indices32.size());
+		for (size_t i = 0; i < part.indices32.size(); ++i)
+			part.indices16[i] = (WORD)part.indices32[i];
+		part.indices32.clear();
+		part.indices32.shrink_to_fit();
+	}
+	else
+	{
+		part.indices16.clear();
+	}
+}
+
+void ObjReader::FinishPool()
+{
+	FinishVertices(pool.vertices, pool.indices32, false);
+
+	for (size_t i = 0; i < pool.submeshes.size(); ++i)
+	{
+		SubmeshGeometry& submesh = pool.submeshes[i];
+		UINT end = i + 1 < pool.submeshes.size() ? pool.submeshes[i + 1].StartIndexLocation : (UINT)pool.indices32.size();
+		submesh.IndexCount = end - submesh.StartIndexLocation;
+		submesh.BaseVertexLocation = 0;
+		if (submesh.IndexCount == 0)
+			continue;
+
+		XMVECTOR vecMin = g_XMInfinity, vecMax = g_XMNegInfinity;
+		for (UINT j = submesh.StartIndexLocation; j < end; ++j)
+		{
+			XMVECTOR pos = XMLoadFloat3(&pool.vertices[pool.indices32[j]].pos);
+			vecMin = XMVectorMin(vecMin, pos);
+			vecMax = XMVectorMax(vecMax, pos);
+		}
+		BoundingBox::CreateFromPoints(submesh.Bounds, vecMin, vecMax);
+	}
+
+	if (pool.vertices.size() <= 65535)
+	{
+		pool.indices16.resize(pool.indices32.size());
+		for (size_t i = 0; i < pool.indices32.size(); ++i)
+			pool.indices16[i] = (WORD)pool.indices32[i];
+		pool.indices32.clear();
+		pool.indices32.shrink_to_fit();
+	}
+}
+
+void ObjReader::AddVertex(const VertexPosNormalTex& vertex, DWORD vpi, DWORD vti, DWORD vni, DWORD smoothing)
+{
+	std::vector<VertexPosNormalTex>& vertices = sharedPool ? pool.vertices : objParts.back().vertices;
+	std::vector<DWORD>& indices = sharedPool ? pool.indices32 : objParts.back().indices32;
+	auto res = vertexCache.Insert({ vpi, vti, vni, smoothing }, (DWORD)vertices.size());
+	if (res.second)
+	{
+		vertices.push_back(vertex);
+		DWORD set = *res.first;
+		if (vni == 0)
+		{
+			// Vertices split by vt still share a normal.
+			set = *smoothingCache.Insert({ vpi, 0, 0, smoothing }, set).first;
+			++missingNormalCount;
+		}
+		normalSets.push_back(set);
+	}
+	indices.push_back(*res.first);
+}
+
+void ObjReader::BeginRead(UINT numThreads)
+{
+	objParts.clear();
+	if (!sharedPool)
+		pool = ObjPool();
+	ClearVertexCache();
+	cleanupStatistics = MeshCleanupStatistics();
+	normalThreads = numThreads;
+}
+
+void ObjReader::ClearVertexCache()
+{
+	vertexCache.Clear();
+	smoothingCache.Clear();
+	normalSets.clear();
+	missingNormalCount = 0;
+}
+
+void ObjReader::FinishVertices(std::vector<VertexPosNormalTex>& vertices, std::vector<DWORD>& indices, bool clean)
+{
+	if (clean && cleanup && !vertices.empty())
+	{
+		// Vertices without vn still have a zero normal, so they weld by position and UV.
+		std::vector<std::uint32_t> remap(vertices.size());
+		MeshCleanupStatistics stats = MeshCleanup::Clean(vertices.data(), vertices.size(), sizeof(VertexPosNormalTex),
+			reinterpret_cast<std::uint32_t*>(indices.data()), indices.size(), &vertices[0].normal.x, 5,
+			MeshCleanup::DefaultWeldTolerance, MeshCleanup::DefaultAttributeTolerance, remap.data());
+		vertices.resize(stats.VerticesAfter);
+		indices.resize(stats.TrianglesAfter * 3);
+		cleanupStatistics += stats;
+
+		// Renumber the smoothing sets; each kept vertex is the first old vertex to map to it.
+		if (normalSets.size() == remap.size())
+		{
+			std::vector<DWORD> firstOfSet(remap.size(), MeshCleanup::Removed);
+			std::vector<DWORD> sets(vertices.size(), MeshCleanup::Removed);
+			missingNormalCount = 0;
+			for (size_t v = 0; v < remap.size(); ++v)
+			{
+				std::uint32_t n = remap[v];
+				if (n == MeshCleanup::Removed || sets[n] != MeshCleanup::Removed)
+					continue;
+				DWORD& first = firstOfSet[normalSets[v]];
+				if (first == MeshCleanup::Removed)
+					first = n;
+				sets[n] = first;
+				const XMFLOAT3& normal = vertices[n].normal;
+				missingNormalCount += normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f;
+			}
+			normalSets.swap(sets);
+		}
+	}
+
+	if (missingNormalCount > 0 && normalSets.size() == vertices.size())
+	{
+		const std::uint32_t* sets = reinterpret_cast<const std::uint32_t*>(normalSets.data());
+		const std::uint32_t* triangles = reinterpret_cast<const std::uint32_t*>(indices.data());
+		if (missingNormalCount == vertices.size())
+		{
+			MeshNormals::GenerateNormals(&vertices[0].pos, vertices.size(), sizeof(VertexPosNormalTex), triangles,
+				indices.size(), &vertices[0].normal, sizeof(VertexPosNormalTex), sets,
+				MeshNormalWeighting::Angle, normalThreads);
+		}
+		else
+		{
+			// Keep the normals that came with the file; the others were added as zero.
+			std::vector<XMFLOAT3> normals(vertices.size());
+			MeshNormals::GenerateNormals(&vertices[0].pos, vertices.size(), sizeof(VertexPosNormalTex), triangles,
+				indices.size(), normals.data(), sizeof(XMFLOAT3), sets, MeshNormalWeighting::Angle, normalThreads);
+			for (size_t i = 0; i < vertices.size(); ++i)
+			{
+				XMFLOAT3& normal = vertices[i].normal;
+				if (normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f)
+					normal = normals[i];
+			}
+		}
+	}
+	normalSets.clear();
+	missingNormalCount = 0;
+}
+
+void ObjReader::GenerateTangents(UINT numThreads)
+{
+	auto generate = [numThreads](const std::vector<VertexPosNormalTex>& vertices, const std::vector<WORD>& indices16,
+		const std::vector<DWORD>& indices32, std::vector<XMFLOAT4>& tangents) {
+		tangents.assign(vertices.size(), XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f));
+		if (vertices.empty())
+			return;
+		if (!indices32.empty())
+		{
+			MeshNormals::GenerateTangents(&vertices[0].pos, &vertices[0].normal, &vertices[0].tex, vertices.size(),
+				sizeof(VertexPosNormalTex), reinterpret_cast<const std::uint32_t*>(indices32.data()), indices32.size(),
+				tangents.data(), numThreads);
+		}
+		else
+		{
+			MeshNormals::GenerateTangents(&vertices[0].pos, &vertices[0].normal, &vertices[0].tex, vertices.size(),
+				sizeof(VertexPosNormalTex), indices16.data(), indices16.size(), tangents.data(), numThreads);
+		}
+	};
+
+	for (auto& part : objParts)
+		generate(part.vertices, part.indices16, part.indices32, part.tangents);
+	if (!pool.vertices.empty())
+		generate(pool.vertices, pool.indices16, pool.indices32, pool.tangents);
+}
+
 bool MtlReader::ReadMtl(const wchar_t* mtlFileName)
 {
 	materials.clear();
@@ -380,7 +1487,7 @@ bool MtlReader::ReadMtl(const wchar_t* mtlFileName)
 			//
 			//	ambient
 			//
-			XMFLOAT4& ambient = materials[currMtl].AmbientStrength;
+			XMFLOAT4& ambient = materials[currMtl].AmbientColor;
 			wfin >> ambient.x >> ambient.y >> ambient.z;
 			if (ambient.w == 0.0f) {
 				ambient.w = 1.0f;
@@ -1,38 +1,183 @@
-#include "d3dUtil.h"
+#pragma once
 
+#include "d3dUtil.h"
+#include "ClusterDag.h"
+#include "FlatHashMap.h"
+#include "MeshCleanup.h"
+#include "Meshlet.h"
+#include <functional>
+#include <map>
+#include <string_view>
 
 class ObjReader
 {
 public:
+	// A simplified copy of a part's index buffer over the part's vertices.  Only the
+	// vector matching the part's index width is filled.
+	struct ObjLod
+	{
+		// Largest position and attribute deviation from the part, in model units
+		float error = 0.0f;
+		std::vector<WORD> indices16;
+		std::vector<DWORD> indices32;
+	};
+
 	struct ObjPart
 	{
 		ObjPart() : material() {}
 		~ObjPart() = default;
 
+		// o/g name as written in the file, empty for the implicit first part
+		std::string name;
 		Material material;
-		std::vector<VertexPos> vertices;
+		std::vector<VertexPosNormalTex> vertices;
 		std::vector<WORD> indices16;
 		std::vector<DWORD> indices32;
 		std::wstring texStrDiffuse;
+		// Vertex numbers are part-local.  Filled by the MeshCookMeshlets step and by ReadMbo.
+		MeshletData meshlets;
+		// Finest first.  Filled by the MeshCookLods step and by ReadMbo.
+		std::vector<ObjLod> lods;
+		// Vertex numbers are part-local.  Filled by the MeshCookClusterDag step and by ReadMbo.
+		ClusterDag clusterDag;
+		// One per vertex, see MeshNormals::GenerateTangents.  Filled by GenerateTangents.
+		std::vector<DirectX::XMFLOAT4> tangents;
+	};
+
+	// Geometry of every part in one vertex/index buffer pair, filled by ReadObjPooled.
+	// Vertices are deduplicated across parts, so indices are absolute and each
+	// submesh has BaseVertexLocation 0.  indices16 is used when the pool fits in WORDs.
+	struct ObjPool
+	{
+		std::vector<VertexPosNormalTex> vertices;
+		std::vector<WORD> indices16;
+		std::vector<DWORD> indices32;
+		// One range per entry of objParts, in the same order.
+		std::vector<SubmeshGeometry> submeshes;
+		// One per vertex, filled by GenerateTangents.
+		std::vector<DirectX::XMFLOAT4> tangents;
+	};
+
+	// v/vt/vnϢ
+	// Key of vertexCache, public so the Benchmarks project can time the caches on it.
+	struct VertexKey
+	{
+		DWORD vpi, vti, vni;
+		// Smoothing group of a vertex without vn, 0 otherwise.
+		DWORD smoothing;
+		bool operator==(const VertexKey& rhs)const
+		{
+			return vpi == rhs.vpi && vti == rhs.vti && vni == rhs.vni && smoothing == rhs.smoothing;
+		}
+	};
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key)const
+		{
+			std::uint64_t h = ((std::uint64_t)key.vpi << 32 | key.vti) * 0x9E3779B97F4A7C15ull;
+			h ^= ((std::uint64_t)key.vni << 32 | key.smoothing) * 0xC2B2AE3D27D4EB4Full;
+			h ^= h >> 29;
+			h *= 0xBF58476D1CE4E5B9ull;
+			return (size_t)(h ^ (h >> 32));
+		}
 	};
 
 	ObjReader() {}
 	~ObjReader() = default;
 
-	bool Read(const wchar_t* mboFileName, const wchar_t* objFileName);
+	// Reads mboFileName if it opens, otherwise objFileName, which is then written out to
+	// mboFileName cooked with cookFlags (see WriteMbo).
+	bool Read(const wchar_t* mboFileName, const wchar_t* objFileName, UINT cookFlags = 0);
 
-	bool ReadObj(const wchar_t* objFileName);
+	// Parses the memory-mapped file bytes directly (no locale, no per-token allocation).
+	// numThreads > 1 splits the file into line-aligned chunks parsed in parallel; 0 uses
+	// every hardware thread.  The result is identical to the single-threaded parse.
+	// Faces without vn get angle weighted normals, smoothed across faces of the same
+	// smoothing group (s); faces before any s statement are smoothed together and faces
+	// after s off or s 0 are flat.
+	bool ReadObj(const wchar_t* objFileName, UINT numThreads = 1);
+	// Like ReadObj, but the geometry goes to pool and objParts only keep the names,
+	// materials and textures, so a whole model is drawn from one buffer binding.
+	bool ReadObjPooled(const wchar_t* objFileName, UINT numThreads = 1);
+	// Adds a DrawArgs entry per non-empty submesh of pool, keyed by part name
+	// ("part<i>" for unnamed parts, "<name>#<i>" for repeated names).
+	void GetDrawArgs(std::unordered_map<std::string, SubmeshGeometry>& drawArgs)const;
+	// Receives each part as soon as its last face has been read.  The part is freed
+	// when the sink returns, so it may be moved from; returning false stops the read.
+	using PartSink = std::function<bool(ObjPart& part)>;
+	// Like ReadObj, but parts are handed to sink one at a time instead of being kept
+	// in objParts.  Faces are parsed a window at a time, so memory holds the v/vt/vn
+	// arrays (faces may reference any of them) plus the part being built.
+	bool ReadObjStreaming(const wchar_t* objFileName, const PartSink& sink);
+	// The original wifstream based parser, kept as a reference for ReadObj.
+	bool ReadObjStream(const wchar_t* objFileName);
+	// Reads MBO v2 (see MboFile.h) or the older headerless v1 layout.  The sections are
+	// copied into objParts on purpose: the parts own their geometry, so they can be cooked,
+	// edited and kept after the file is closed, like the parts of ReadObj.  To draw a file
+	// without that copy, open it with MboFile and upload straight from its spans.
 	bool ReadMbo(const wchar_t* mboFileName);
-	bool WriteMbo(const wchar_t* mboFileName);
+	// Always writes MBO v2.  compress stores vertices and indices as MeshCodec streams;
+	// quantize stores VertexPosNormalTexQuantized relative to each part's AABB.
+	// cookFlags (MeshCookFlags, see MeshOptimizer.h) reorders the geometry of objParts in
+	// place before writing and sums what the steps did into cookStatistics.
+	bool WriteMbo(const wchar_t* mboFileName, bool compress = false, bool quantize = false, UINT cookFlags = 0);
+	// Fills the tangents of every part, and of pool when it has vertices, from the final
+	// vertices and indices.  Tangents are not stored in MBO and MeshCookVertexFetch clears
+	// them, so call this after reading.  numThreads 0 uses every hardware thread.
+	void GenerateTangents(UINT numThreads = 0);
 
 public:
 	std::vector<ObjPart> objParts;
+	ObjPool pool;
 	DirectX::XMFLOAT3 vMin, vMax;
+	// Set before ReadObj, ReadObjStreaming or ReadObjStream to weld each part and strip
+	// its degenerate triangles with MeshCleanup (normals and UVs as attributes) as the part
+	// is finished, before its missing normals are generated.  ReadObjPooled does not clean.
+	bool cleanup = false;
+	// What the last read's cleanup removed, summed over the parts.
+	MeshCleanupStatistics cleanupStatistics;
+	// Vertex cache and fetch cost before and after the last WriteMbo's cookFlags, summed
+	// over the parts from their MeshCookReport.  All zero when nothing was cooked.
+	struct CookStatistics
+	{
+		size_t Indices = 0;
+		size_t VerticesTransformedBefore = 0;
+		size_t VerticesTransformedAfter = 0;
+		size_t BytesFetchedBefore = 0;
+		size_t BytesFetchedAfter = 0;
+
+		// Average cache miss ratio, vertices transformed per triangle.
+		double AcmrBefore()const { return Indices ? 3.0 * VerticesTransformedBefore / Indices : 0.0; }
+		double AcmrAfter()const { return Indices ? 3.0 * VerticesTransformedAfter / Indices : 0.0; }
+	};
+	CookStatistics cookStatistics;
 private:
-	void AddVertex(const VertexPosNormalTex& vertex, DWORD vpi, DWORD vti, DWORD vni);
+	struct ChunkMerger;
+
+	bool ReadMboV1(const wchar_t* mboFileName);
+
+	// Drops what the last read left behind: the parts, the pool unless ReadObjPooled is
+	// filling it, the caches and the cleanup statistics.
+	void BeginRead(UINT numThreads);
+	void BeginPart(std::string_view name = {});
+	void FinishPart(ObjPart& part);
+	void FinishPool();
+	void AddVertex(const VertexPosNormalTex& vertex, DWORD vpi, DWORD vti, DWORD vni, DWORD smoothing = 0);
+	void ClearVertexCache();
+	// Cleans the vertices if clean and cleanup are set, fills the normals of the vertices
+	// added without one, then clears normalSets.
+	void FinishVertices(std::vector<VertexPosNormalTex>& vertices, std::vector<DWORD>& indices, bool clean);
 
-	// v/vt/vnַϢ
-	std::unordered_map<std::wstring, DWORD> vertexCache;
+	FlatHashMap<VertexKey, DWORD, VertexKeyHash> vertexCache;
+	// Set while ReadObjPooled runs: vertices go to pool and the cache spans all parts.
+	bool sharedPool = false;
+	// For each vertex of the current part (or pool), the first vertex with the same vpi
+	// and smoothing group if it has no vn, itself otherwise.
+	std::vector<DWORD> normalSets;
+	// First vertex of each vpi and smoothing group among the vertices without vn.
+	FlatHashMap<VertexKey, DWORD, VertexKeyHash> smoothingCache;
+	size_t missingNormalCount = 0;
+	UINT normalThreads = 1;
 };
 
 
@@ -0,0 +1,37 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// splits a loop into contiguous slices run on std::threads
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Ranges smaller than this are not worth a thread.
+constexpr size_t ParallelForMinItems = 1 << 14;
+
+// Calls body(first, end) on contiguous slices of [0, count), one per thread, with at
+// least minItems items to a thread; numThreads 0 uses every hardware thread.  With one
+// slice body runs on the calling thread.
+template<typename Body>
+void ParallelFor(size_t count, std::uint32_t numThreads, const Body& body, size_t minItems = ParallelForMinItems)
+{
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	size_t threads = std::min<size_t>(numThreads, std::max<size_t>(1, count / std::max<size_t>(minItems, 1)));
+	if (threads <= 1)
+	{
+		body(size_t(0), count);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threads; ++i)
+		workers.emplace_back([&, i]() { body(count * i / threads, count * (i + 1) / threads); });
+	for (auto& worker : workers)
+		worker.join();
+}
@@ -1,64 +1,711 @@
 #include "PlyReader.h"
-#include <iostream>
-#include <fstream>
+#include "MeshNormals.h"
+#include <charconv>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <thread>
+
+namespace
+{
+	typedef PlyReader::PropertyType PropertyType;
+
+	UINT TypeSize(PropertyType type)
+	{
+		switch (type)
+		{
+		case PropertyType::Int8: case PropertyType::UInt8: return 1;
+		case PropertyType::Int16: case PropertyType::UInt16: return 2;
+		case PropertyType::Float64: return 8;
+		default: return 4;
+		}
+	}
+
+	bool ParseType(std::string_view str, PropertyType& type)
+	{
+		static const struct { const char* name; PropertyType type; } types[] = {
+			{ "char", PropertyType::Int8 }, { "int8", PropertyType::Int8 },
+			{ "uchar", PropertyType::UInt8 }, { "uint8", PropertyType::UInt8 },
+			{ "short", PropertyType::Int16 }, { "int16", PropertyType::Int16 },
+			{ "ushort", PropertyType::UInt16 }, { "uint16", PropertyType::UInt16 },
+			{ "int", PropertyType::Int32 }, { "int32", PropertyType::Int32 },
+			{ "uint", PropertyType::UInt32 }, { "uint32", PropertyType::UInt32 },
+			{ "float", PropertyType::Float32 }, { "float32", PropertyType::Float32 },
+			{ "double", PropertyType::Float64 }, { "float64", PropertyType::Float64 },
+		};
+		for (const auto& t : types)
+		{
+			if (str == t.name)
+			{
+				type = t.type;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template<typename T>
+	T LoadAs(const std::uint8_t* src)
+	{
+		T value;
+		std::memcpy(&value, src, sizeof(T));
+		return value;
+	}
+
+	// src holds one native-endian value of the given type.
+	double ToDouble(const std::uint8_t* src, PropertyType type)
+	{
+		switch (type)
+		{
+		case PropertyType::Int8: return LoadAs<std::int8_t>(src);
+		case PropertyType::UInt8: return LoadAs<std::uint8_t>(src);
+		case PropertyType::Int16: return LoadAs<std::int16_t>(src);
+		case PropertyType::UInt16: return LoadAs<std::uint16_t>(src);
+		case PropertyType::Int32: return LoadAs<std::int32_t>(src);
+		case PropertyType::UInt32: return LoadAs<std::uint32_t>(src);
+		case PropertyType::Float32: return LoadAs<float>(src);
+		default: return LoadAs<double>(src);
+		}
+	}
+
+	template<typename T>
+	bool ParseAs(const char*& cur, const char* end, std::uint8_t* dst)
+	{
+		T value;
+		auto res = std::from_chars(cur, end, value);
+		if (res.ec != std::errc())
+			return false;
+		std::memcpy(dst, &value, sizeof(T));
+		cur = res.ptr;
+		return true;
+	}
+
+	// Forward-only cursor over the element data.  Every scalar lands in dst in native
+	// byte order whatever the file format; x86 is little endian.
+	struct PlyCursor
+	{
+		const char* cur;
+		const char* end;
+		PlyReader::Format format;
+
+		bool Scalar(PropertyType type, std::uint8_t* dst)
+		{
+			if (format == PlyReader::Format::Ascii)
+				return AsciiScalar(type, dst);
+
+			UINT size = TypeSize(type);
+			if ((size_t)(end - cur) < size)
+				return false;
+			if (format == PlyReader::Format::BinaryLittleEndian)
+			{
+				std::memcpy(dst, cur, size);
+			}
+			else
+			{
+				for (UINT i = 0; i < size; ++i)
+					dst[i] = (std::uint8_t)cur[size - 1 - i];
+			}
+			cur += size;
+			return true;
+		}
+
+		void SkipSpace()
+		{
+			while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n'))
+				++cur;
+		}
+
+		// A chunk ends right after its last record unless a line held more or less than one record.
+		bool AtEnd()
+		{
+			SkipSpace();
+			return cur == end;
+		}
+
+		bool AsciiScalar(PropertyType type, std::uint8_t* dst)
+		{
+			SkipSpace();
+			if (cur < end && *cur == '+')
+				++cur;
+
+			switch (type)
+			{
+			case PropertyType::Int8: return ParseAs<std::int8_t>(cur, end, dst);
+			case PropertyType::UInt8: return ParseAs<std::uint8_t>(cur, end, dst);
+			case PropertyType::Int16: return ParseAs<std::int16_t>(cur, end, dst);
+			case PropertyType::UInt16: return ParseAs<std::uint16_t>(cur, end, dst);
+			case PropertyType::Int32: return ParseAs<std::int32_t>(cur, end, dst);
+			case PropertyType::UInt32: return ParseAs<std::uint32_t>(cur, end, dst);
+			case PropertyType::Float32: return ParseAs<float>(cur, end, dst);
+			default: return ParseAs<double>(cur, end, dst);
+			}
+		}
+	};
+
+	// Splits the header line at cur into blank separated words.
+	std::vector<std::string_view> HeaderLine(const char*& cur, const char* end)
+	{
+		const char* nl = cur < end ? static_cast<const char*>(memchr(cur, '\n', end - cur)) : nullptr;
+		const char* lineEnd = nl ? nl : end;
+
+		std::vector<std::string_view> words;
+		while (cur < lineEnd)
+		{
+			while (cur < lineEnd && (*cur == ' ' || *cur == '\t' || *cur == '\r'))
+				++cur;
+			const char* beg = cur;
+			while (cur < lineEnd && *cur != ' ' && *cur != '\t' && *cur != '\r')
+				++cur;
+			if (cur > beg)
+				words.emplace_back(beg, cur - beg);
+		}
+		cur = nl ? nl + 1 : end;
+		return words;
+	}
+
+	bool IsFaceIndexList(const PlyReader::Element& element, const PlyReader::Property& property)
+	{
+		return element.Name == "face" && property.IsList &&
+			(property.Name == "vertex_indices" || property.Name == "vertex_index");
+	}
+
+	// ASCII bodies are split at every RecordsPerCheckpoint-th record.
+	const size_t RecordsPerCheckpoint = 1 << 12;
+
+	// Finds the lines of the next count records, which start at cur.  Blank lines do not
+	// count.  checkpoints receives the start of every RecordsPerCheckpoint-th record.
+	bool FindRecords(const char* cur, const char* end, size_t count, std::vector<const char*>& checkpoints,
+		const char*& bodyEnd)
+	{
+		checkpoints.reserve(count / RecordsPerCheckpoint + 1);
+		size_t record = 0;
+		while (record < count && cur < end)
+		{
+			const char* nl = static_cast<const char*>(memchr(cur, '\n', end - cur));
+			const char* lineEnd = nl ? nl : end;
+			const char* p = cur;
+			while (p < lineEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+				++p;
+			if (p < lineEnd)
+			{
+				if (record % RecordsPerCheckpoint == 0)
+					checkpoints.push_back(cur);
+				++record;
+			}
+			cur = nl ? nl + 1 : end;
+		}
+		if (record < count)
+			return false;
+		if (checkpoints.empty())
+			checkpoints.push_back(cur);
+		bodyEnd = cur;
+		return true;
+	}
+
+	// Reads records [first, last) of the element.  Fixed-size records go to records in native
+	// byte order; face index lists are fan triangulated into faces and other lists skipped.
+	bool ParseRecords(const PlyReader::Element& element, PlyCursor& cursor, size_t first, size_t last,
+		std::uint8_t* records, std::vector<std::uint32_t>& faces)
+	{
+		std::uint8_t value[8];
+		std::vector<std::uint32_t> polygon;
+		for (size_t r = first; r < last; ++r)
+		{
+			for (const PlyReader::Property& property : element.Properties)
+			{
+				if (!property.IsList)
+				{
+					if (!cursor.Scalar(property.Type, records ? records + r * element.Stride + property.Offset : value))
+						return false;
+					continue;
+				}
+
+				if (!cursor.Scalar(property.CountType, value))
+					return false;
+				// Float counts and indices are allowed, so reject what does not fit the casts.
+				double count = ToDouble(value, property.CountType);
+				if (!(count >= 0.0 && count < 4294967296.0))
+					return false;
+
+				bool keep = IsFaceIndexList(element, property);
+				polygon.clear();
+				for (size_t i = 0; i < (size_t)count; ++i)
+				{
+					if (!cursor.Scalar(property.Type, value))
+						return false;
+					if (keep)
+					{
+						double index = ToDouble(value, property.Type);
+						if (!(index >= 0.0 && index < 4294967296.0))
+							return false;
+						polygon.push_back((std::uint32_t)index);
+					}
+				}
+
+				for (size_t i = 2; i < polygon.size(); ++i)
+				{
+					faces.push_back(polygon[0]);
+					faces.push_back(polygon[i - 1]);
+					faces.push_back(polygon[i]);
+				}
+			}
+		}
+		return true;
+	}
+}
 
 PlyReader::PlyReader()
 {
 
 }
 
-void PlyReader::ReadFile(const wchar_t* plyFileName)
+const PlyReader::Property* PlyReader::Element::FindProperty(const char* name)const
+{
+	for (const Property& property : Properties)
+	{
+		if (property.Name == name)
+			return &property;
+	}
+	return nullptr;
+}
+
+const PlyReader::Element* PlyReader::FindElement(const char* name)const
+{
+	for (const Element& element : Elements)
+	{
+		if (element.Name == name)
+			return &element;
+	}
+	return nullptr;
+}
+
+bool PlyReader::ReadFile(const wchar_t* plyFileName, UINT numThreads)
 {
-	std::wifstream wfin(plyFileName);
-	if (!wfin.is_open())
-		return;
+	Elements.clear();
+	Vertices.clear();
+	Indices16.clear();
+	Indices32.clear();
+	mRecords.clear();
+	mRecordStorage.clear();
+	mFaceIndices.clear();
 
-	std::wstring wstr;
-	int32_t VertexCount = 0;
-	int32_t FaceCount = 0;
+	if (!mFile.Open(plyFileName))
+		return false;
 
-	while (1) {
-		if(!(wfin >> wstr))
-			break;
-		//header
-		if(wstr == L"ply")
+	const char* cur = mFile.Data();
+	if (!ParseHeader(cur, mFile.End()) || !ReadElements(cur, mFile.End(), numThreads))
+		return false;
+
+	const Element* vertex = FindElement("vertex");
+	if (vertex)
+	{
+		Vertices.resize(vertex->Count);
+		if (!Vertices.empty() && !Gather("vertex", { "x", "y", "z" }, &Vertices[0].pos.x, sizeof(VertexPos)))
+			return false;
+	}
+
+	for (std::uint32_t index : mFaceIndices)
+	{
+		if (index >= Vertices.size())
+			return false;
+	}
+	if (Vertices.size() <= 65535)
+		Indices16.assign(mFaceIndices.begin(), mFaceIndices.end());
+	else
+		Indices32 = std::move(mFaceIndices);
+
+	return true;
+}
+
+bool PlyReader::ParseHeader(const char*& cur, const char* end)
+{
+	std::vector<std::string_view> words = HeaderLine(cur, end);
+	if (words.size() != 1 || words[0] != "ply")
+		return false;
+
+	bool hasFormat = false;
+	while (cur < end)
+	{
+		words = HeaderLine(cur, end);
+		if (words.empty() || words[0] == "comment" || words[0] == "obj_info")
 			continue;
-		else if (wstr == L"format" || wstr == L"comment" || wstr == L"property") {
-			while (!wfin.eof() && wfin.get() != '\n')
+
+		if (words[0] == "end_header")
+			return hasFormat;
+
+		if (words[0] == "format" && words.size() >= 2)
+		{
+			if (words[1] == "ascii")
+				FileFormat = Format::Ascii;
+			else if (words[1] == "binary_little_endian")
+				FileFormat = Format::BinaryLittleEndian;
+			else if (words[1] == "binary_big_endian")
+				FileFormat = Format::BinaryBigEndian;
+			else
+				return false;
+			hasFormat = true;
+		}
+		else if (words[0] == "element" && words.size() == 3)
+		{
+			Element element;
+			element.Name = words[1];
+			if (std::from_chars(words[2].data(), words[2].data() + words[2].size(), element.Count).ec != std::errc())
+				return false;
+			Elements.push_back(std::move(element));
+		}
+		else if (words[0] == "property" && !Elements.empty())
+		{
+			Element& element = Elements.back();
+			Property property;
+			if (words.size() == 5 && words[1] == "list")
+			{
+				if (!ParseType(words[2], property.CountType) || !ParseType(words[3], property.Type))
+					return false;
+				property.IsList = true;
+				property.Name = words[4];
+			}
+			else if (words.size() == 3)
+			{
+				if (!ParseType(words[1], property.Type))
+					return false;
+				property.Name = words[2];
+			}
+			else
+			{
+				return false;
+			}
+
+			// Offsets stay valid only while every property before them has a fixed size.
+			bool fixedSize = element.Properties.empty() || element.Stride != 0;
+			property.Offset = element.Stride;
+			element.Stride = fixedSize && !property.IsList ? element.Stride + TypeSize(property.Type) : 0;
+			element.Properties.push_back(std::move(property));
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+bool PlyReader::ReadElements(const char* cur, const char* end, UINT numThreads)
+{
+	mRecords.resize(Elements.size(), nullptr);
+	mRecordStorage.resize(Elements.size());
+
+	if (numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	PlyCursor cursor = { cur, end, FileFormat };
+	for (size_t e = 0; e < Elements.size(); ++e)
+	{
+		const Element& element = Elements[e];
+		// Every record takes at least a byte; reject corrupt counts before allocating.
+		if (!element.Properties.empty() && element.Count > (size_t)(end - cursor.cur))
+			return false;
+
+		bool isFace = element.Name == "face";
+		if (isFace)
+			mFaceIndices.reserve(mFaceIndices.size() + (size_t)element.Count * 3);
+
+		if (element.Stride != 0 && FileFormat != Format::Ascii)
+		{
+			size_t bytes = (size_t)element.Count * element.Stride;
+			if ((size_t)(end - cursor.cur) < bytes)
+				return false;
+			const std::uint8_t* records = reinterpret_cast<const std::uint8_t*>(cursor.cur);
+			cursor.cur += bytes;
+
+			// Little endian records are used straight from the mapping.
+			if (FileFormat == Format::BinaryLittleEndian)
+			{
+				mRecords[e] = records;
 				continue;
+			}
+
+			std::vector<std::uint8_t>& storage = mRecordStorage[e];
+			storage.resize(bytes);
+			for (size_t r = 0; r < element.Count; ++r)
+			{
+				const std::uint8_t* src = records + r * element.Stride;
+				std::uint8_t* dst = storage.data() + r * element.Stride;
+				for (const Property& property : element.Properties)
+				{
+					UINT size = TypeSize(property.Type);
+					for (UINT i = 0; i < size; ++i)
+						dst[property.Offset + i] = src[property.Offset + size - 1 - i];
+				}
+			}
+			mRecords[e] = storage.data();
+			continue;
 		}
-		else if (wstr == L"element") {
-			wfin >> wstr;
-			if (wstr == L"vertex") {
-				wfin >> VertexCount;
+
+		std::uint8_t* records = nullptr;
+		if (element.Stride != 0)
+		{
+			mRecordStorage[e].resize((size_t)element.Count * element.Stride);
+			records = mRecordStorage[e].data();
+			mRecords[e] = records;
+		}
+
+		// Binary lists can only be walked in order.
+		if (FileFormat != Format::Ascii)
+		{
+			if (!ParseRecords(element, cursor, 0, element.Count, records, mFaceIndices))
+				return false;
+			continue;
+		}
+
+		//
+		// ASCII has one record per line, so the body splits at line boundaries into chunks
+		// whose first record is known.
+		//
+
+		std::vector<const char*> checkpoints;
+		const char* bodyEnd;
+		if (!FindRecords(cursor.cur, end, element.Count, checkpoints, bodyEnd))
+			return false;
+
+		// Chunks smaller than this are not worth a thread.
+		const size_t minChunkBytes = 1 << 20;
+		UINT chunkCount = (UINT)std::min<size_t>({ numThreads, checkpoints.size(),
+			std::max<size_t>(1, (bodyEnd - cursor.cur) / minChunkBytes) });
+
+		std::vector<size_t> firstRecord(chunkCount + 1);
+		std::vector<PlyCursor> cursors(chunkCount);
+		for (UINT i = 0; i < chunkCount; ++i)
+		{
+			size_t checkpoint = checkpoints.size() * i / chunkCount;
+			firstRecord[i] = checkpoint * RecordsPerCheckpoint;
+			cursors[i] = { checkpoints[checkpoint], bodyEnd, FileFormat };
+			if (i > 0)
+				cursors[i - 1].end = cursors[i].cur;
+		}
+		firstRecord[chunkCount] = element.Count;
+
+		std::vector<std::vector<std::uint32_t>> chunkFaces(chunkCount);
+		std::unique_ptr<bool[]> status(new bool[chunkCount]);
+		auto parseChunk = [&](UINT i) {
+			std::vector<std::uint32_t>& faces = i == 0 ? mFaceIndices : chunkFaces[i];
+			if (isFace && i > 0)
+				faces.reserve((firstRecord[i + 1] - firstRecord[i]) * 3);
+			status[i] = ParseRecords(element, cursors[i], firstRecord[i], firstRecord[i + 1], records, faces) &&
+				cursors[i].AtEnd();
+		};
+		if (chunkCount == 1)
+		{
+			parseChunk(0);
+		}
+		else
+		{
+			std::vector<std::thread> workers;
+			for (UINT i = 0; i < chunkCount; ++i)
+				workers.emplace_back(parseChunk, i);
+			for (auto& worker : workers)
+				worker.join();
+		}
+
+		for (UINT i = 0; i < chunkCount; ++i)
+		{
+			if (!status[i])
+				return false;
+			if (i > 0)
+				mFaceIndices.insert(mFaceIndices.end(), chunkFaces[i].begin(), chunkFaces[i].end());
+		}
+		cursor.cur = bodyEnd;
+	}
+	return true;
+}
+
+bool PlyReader::Gather(const char* elementName, std::initializer_list<const char*> properties, float* dst,
+	size_t dstStride)const
+{
+	const Element* element = FindElement(elementName);
+	if (!element || element->Stride == 0)
+		return false;
+	const std::uint8_t* records = mRecords[element - Elements.data()];
+
+	// Consecutive float32 properties that are also adjacent in the record copy as one run.
+	struct Run
+	{
+		UINT srcOffset;
+		UINT dstOffset;
+		UINT count;
+		PropertyType type;
+	};
+	std::vector<Run> runs;
+	UINT dstOffset = 0;
+	for (const char* name : properties)
+	{
+		const Property* property = element->FindProperty(name);
+		if (!property || property->IsList)
+			return false;
+
+		Run* last = runs.empty() ? nullptr : &runs.back();
+		if (last && last->type == PropertyType::Float32 && property->Type == PropertyType::Float32 &&
+			property->Offset == last->srcOffset + last->count * sizeof(float))
+			++last->count;
+		else
+			runs.push_back({ property->Offset, dstOffset, 1, property->Type });
+		dstOffset += sizeof(float);
+	}
+
+	std::uint8_t* dstBytes = reinterpret_cast<std::uint8_t*>(dst);
+	if (runs.size() == 1 && runs[0].type == PropertyType::Float32 && runs[0].srcOffset == 0 &&
+		runs[0].count * sizeof(float) == element->Stride && dstStride == element->Stride)
+	{
+		std::memcpy(dstBytes, records, (size_t)element->Count * element->Stride);
+		return true;
+	}
+
+	for (size_t r = 0; r < element->Count; ++r)
+	{
+		const std::uint8_t* src = records + r * element->Stride;
+		std::uint8_t* out = dstBytes + r * dstStride;
+		for (const Run& run : runs)
+		{
+			if (run.type == PropertyType::Float32)
+			{
+				std::memcpy(out + run.dstOffset, src + run.srcOffset, run.count * sizeof(float));
 			}
-			else if (wstr == L"face") {
-				wfin >> FaceCount;
+			else
+			{
+				float value = (float)ToDouble(src + run.srcOffset, run.type);
+				std::memcpy(out + run.dstOffset, &value, sizeof(float));
 			}
 		}
-		else if (wstr == L"end_header") {
+	}
+	return true;
+}
+
+template<typename Vertex>
+bool PlyReader::GatherVerticesImpl(std::vector<Vertex>& vertices, UINT numThreads)const
+{
+	const Element* vertex = FindElement("vertex");
+	if (!vertex)
+		return false;
+
+	vertices.assign(vertex->Count, Vertex());
+	if (vertices.empty())
+		return true;
+
+	for (Vertex& v : vertices)
+	{
+		v.normal = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+		v.tex = DirectX::XMFLOAT2(0.0f, 0.0f);
+	}
+	if (!Gather("vertex", { "x", "y", "z" }, &vertices[0].pos.x, sizeof(Vertex)))
+		return false;
+
+	static const char* texNames[][2] = { { "u", "v" }, { "s", "t" }, { "texture_u", "texture_v" } };
+	for (const auto& names : texNames)
+	{
+		if (vertex->FindProperty(names[0]))
+		{
+			Gather("vertex", { names[0], names[1] }, &vertices[0].tex.x, sizeof(Vertex));
 			break;
 		}
 	}
 
-	//read vertex and index
-	for (; VertexCount > 0; --VertexCount) {
-		VertexPos v;
-		wfin >> v.pos.x >> v.pos.y >> v.pos.z;
-		Vertices.push_back(v);
+	if (vertex->FindProperty("nx"))
+	{
+		Gather("vertex", { "nx", "ny", "nz" }, &vertices[0].normal.x, sizeof(Vertex));
+	}
+	else if (!Indices32.empty())
+	{
+		MeshNormals::GenerateNormals(&vertices[0].pos, vertices.size(), sizeof(Vertex), Indices32.data(),
+			Indices32.size(), &vertices[0].normal, sizeof(Vertex), nullptr, MeshNormalWeighting::Angle, numThreads);
 	}
-	for (; FaceCount > 0; --FaceCount) {
-		std::uint16_t count,temp;
-		wfin >> count;
+	else
+	{
+		MeshNormals::GenerateNormals(&vertices[0].pos, vertices.size(), sizeof(Vertex), Indices16.data(),
+			Indices16.size(), &vertices[0].normal, sizeof(Vertex), nullptr, MeshNormalWeighting::Angle, numThreads);
+	}
+	return true;
+}
 
-		std::vector<int32_t> idxs;
+bool PlyReader::GatherVertices(std::vector<VertexPosNormalTex>& vertices, UINT numThreads)const
+{
+	return GatherVerticesImpl(vertices, numThreads);
+}
 
-		for (int32_t i = 0; i < count; ++i) {
-			wfin >> temp;
-			Indices.push_back(temp);
-		}
+bool PlyReader::GatherVertices(std::vector<VertexPosNormalTangentTex>& vertices, UINT numThreads)const
+{
+	if (!GatherVerticesImpl(vertices, numThreads))
+		return false;
+	if (vertices.empty())
+		return true;
 
+	std::vector<DirectX::XMFLOAT4> tangents(vertices.size(), DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f));
+	if (!Indices32.empty())
+	{
+		MeshNormals::GenerateTangents(&vertices[0].pos, &vertices[0].normal, &vertices[0].tex, vertices.size(),
+			sizeof(VertexPosNormalTangentTex), Indices32.data(), Indices32.size(), tangents.data(), numThreads);
+	}
+	else
+	{
+		MeshNormals::GenerateTangents(&vertices[0].pos, &vertices[0].normal, &vertices[0].tex, vertices.size(),
+			sizeof(VertexPosNormalTangentTex), Indices16.data(), Indices16.size(), tangents.data(), numThreads);
 	}
+	for (size_t i = 0; i < vertices.size(); ++i)
+		vertices[i].tangent = tangents[i];
+	return true;
+}
+
+MeshCleanupStatistics PlyReader::Clean(std::vector<VertexPosNormalTex>& vertices, float weldTolerance,
+	float attributeTolerance, UINT numThreads)
+{
+	// Without faces every vertex counts as unused; keep point clouds as they are.
+	MeshCleanupStatistics stats;
+	stats.VerticesBefore = stats.VerticesAfter = vertices.size();
+	if (vertices.empty() || (Indices16.empty() && Indices32.empty()))
+		return stats;
+
+	const Element* vertex = FindElement("vertex");
+	bool fileNormals = vertex && vertex->FindProperty("nx");
+	const float* attributes = fileNormals ? &vertices[0].normal.x : &vertices[0].tex.x;
+	size_t attributeCount = fileNormals ? 5 : 2;
 
-	wfin.close();
+	if (!Indices32.empty())
+	{
+		stats = MeshCleanup::Clean(vertices.data(), vertices.size(), sizeof(VertexPosNormalTex), Indices32.data(),
+			Indices32.size(), attributes, attributeCount, weldTolerance, attributeTolerance);
+		Indices32.resize(stats.TrianglesAfter * 3);
+	}
+	else
+	{
+		stats = MeshCleanup::Clean(vertices.data(), vertices.size(), sizeof(VertexPosNormalTex), Indices16.data(),
+			Indices16.size(), attributes, attributeCount, weldTolerance, attributeTolerance);
+		Indices16.resize(stats.TrianglesAfter * 3);
+	}
+	vertices.resize(stats.VerticesAfter);
+
+	Vertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		Vertices[i].pos = vertices[i].pos;
+	if (!Indices32.empty() && vertices.size() <= 65535)
+	{
+		Indices16.assign(Indices32.begin(), Indices32.end());
+		Indices32.clear();
+		Indices32.shrink_to_fit();
+	}
+
+	if (!fileNormals && !vertices.empty())
+	{
+		if (!Indices32.empty())
+		{
+			MeshNormals::GenerateNormals(&vertices[0].pos, vertices.size(), sizeof(VertexPosNormalTex), Indices32.data(),
+				Indices32.size(), &vertices[0].normal, sizeof(VertexPosNormalTex), nullptr, MeshNormalWeighting::Angle,
+				numThreads);
+		}
+		else
+		{
+			MeshNormals::GenerateNormals(&vertices[0].pos, vertices.size(), sizeof(VertexPosNormalTex), Indices16.data(),
+				Indices16.size(), &vertices[0].normal, sizeof(VertexPosNormalTex), nullptr, MeshNormalWeighting::Angle,
+				numThreads);
+		}
+	}
+	return stats;
 }
@@ -1,13 +1,88 @@
 #pragma once
 #include<vector>
+#include <initializer_list>
+#include <string>
 #include "d3dUtil.h"
+#include "MappedFile.h"
+#include "MeshCleanup.h"
 
 
 class PlyReader {
 public:
+	enum class Format { Ascii, BinaryLittleEndian, BinaryBigEndian };
+	enum class PropertyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+	struct Property
+	{
+		std::string Name;
+		PropertyType Type;
+		// List properties store a count of CountType followed by that many Type items.
+		bool IsList = false;
+		PropertyType CountType = PropertyType::UInt8;
+		// Byte offset inside a record of the element; only meaningful without lists.
+		UINT Offset = 0;
+	};
+
+	struct Element
+	{
+		std::string Name;
+		UINT Count = 0;
+		std::vector<Property> Properties;
+		// Record size in bytes; 0 when the element has a list property.
+		UINT Stride = 0;
+
+		const Property* FindProperty(const char* name)const;
+	};
+
 	PlyReader();
-	void ReadFile(const wchar_t* plyFileName);
+	// Parses the header into Elements, then reads every element.  Vertices gets x/y/z and
+	// the "vertex_indices" (or "vertex_index") lists of the faces are fan triangulated into
+	// Indices16, or into Indices32 when there are more than 65535 vertices.
+	// numThreads > 1 parses the ASCII element bodies in parallel line-aligned chunks; 0 uses
+	// every hardware thread.  The result is identical to the single-threaded parse.
+	bool ReadFile(const wchar_t* plyFileName, UINT numThreads = 1);
+
+	const Element* FindElement(const char* name)const;
+	// Copies the named properties of every record of a list-free element into dst as
+	// floats: record i goes to dst + i * dstStride bytes, one float per property.
+	// Runs of float32 properties are memcpy'd; other types are converted.
+	bool Gather(const char* element, std::initializer_list<const char*> properties, float* dst, size_t dstStride)const;
+	// Fills pos, and tex when the file has u/v (or s/t).  normal comes from nx/ny/nz, or
+	// when the file has none is generated from the faces, smoothed across vertices at the
+	// same position.  numThreads as for ReadFile.
+	bool GatherVertices(std::vector<VertexPosNormalTex>& vertices, UINT numThreads = 1)const;
+	// The same, plus tangents generated for normal mapping, see MeshNormals::GenerateTangents.
+	bool GatherVertices(std::vector<VertexPosNormalTangentTex>& vertices, UINT numThreads = 1)const;
+	// Welds and strips vertices from GatherVertices with MeshCleanup and rewrites Vertices
+	// and the indices to match; call it after gathering, which reads the file's records.
+	// Normals from the file and UVs must match for vertices to weld.  Generated normals
+	// are left out of the comparison and generated again on the welded mesh.  A file
+	// without faces is left untouched.
+	MeshCleanupStatistics Clean(std::vector<VertexPosNormalTex>& vertices,
+		float weldTolerance = MeshCleanup::DefaultWeldTolerance,
+		float attributeTolerance = MeshCleanup::DefaultAttributeTolerance, UINT numThreads = 1);
+
+	Format FileFormat = Format::Ascii;
+	std::vector<Element> Elements;
 
 	std::vector<VertexPos> Vertices;
-	std::vector<std::uint16_t> Indices;
-};
\ No newline at end of file
+	// Only one of the two is filled, see IndexFormat().
+	std::vector<std::uint16_t> Indices16;
+	std::vector<std::uint32_t> Indices32;
+
+	DXGI_FORMAT IndexFormat()const { return Indices32.empty() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT; }
+
+private:
+	bool ParseHeader(const char*& cur, const char* end);
+	bool ReadElements(const char* cur, const char* end, UINT numThreads);
+	template<typename Vertex>
+	bool GatherVerticesImpl(std::vector<Vertex>& vertices, UINT numThreads)const;
+
+	MappedFile mFile;
+	// Records of each list-free element in native byte order, parallel to Elements.
+	// They point into the mapping when the file is already native binary.
+	std::vector<const std::uint8_t*> mRecords;
+	std::vector<std::vector<std::uint8_t>> mRecordStorage;
+	// Triangulated face corners.
+	std::vector<std::uint32_t> mFaceIndices;
+};
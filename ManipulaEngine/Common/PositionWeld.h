@@ -0,0 +1,62 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// exact position welding and edge keys for the mesh processing code
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "FlatHashMap.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <cstring>
+
+// The bits of a position, so that only exactly equal positions share a key.
+struct PositionKey
+{
+	std::uint32_t x, y, z;
+	bool operator==(const PositionKey& rhs)const { return x == rhs.x && y == rhs.y && z == rhs.z; }
+};
+
+struct PositionKeyHash
+{
+	size_t operator()(const PositionKey& key)const
+	{
+		std::uint64_t h = key.x * 0x9E3779B97F4A7C15ull;
+		h = (h ^ key.y) * 0xC2B2AE3D27D4EB4Full;
+		h = (h ^ key.z) * 0x165667B19E3779F9ull;
+		return (size_t)(h ^ (h >> 29));
+	}
+};
+
+// Hash of an EdgeKey.
+struct EdgeHash
+{
+	size_t operator()(std::uint64_t key)const
+	{
+		key *= 0x9E3779B97F4A7C15ull;
+		return (size_t)(key ^ (key >> 29));
+	}
+};
+
+// The same key for both directions of the edge between a and b.
+inline std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b)
+{
+	return a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a;
+}
+
+// Sets weld[v] to the first vertex at exactly the position of v, which is v itself for
+// the first one.  positions points at the position of vertex 0, the next one is stride
+// bytes on.
+inline void WeldPositions(const DirectX::XMFLOAT3* positions, size_t vertexCount, size_t stride,
+	std::uint32_t* weld)
+{
+	const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(positions);
+	FlatHashMap<PositionKey, std::uint32_t, PositionKeyHash> first;
+	first.Reserve(vertexCount);
+	for (std::uint32_t v = 0; v < vertexCount; ++v)
+	{
+		PositionKey key;
+		std::memcpy(&key, bytes + v * stride, sizeof(key));
+		weld[v] = *first.Insert(key, v).first;
+	}
+}
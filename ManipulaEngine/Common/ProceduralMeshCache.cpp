@@ -0,0 +1,396 @@
+#include "ProceduralMeshCache.h"
+#include "MboFile.h"
+#include "MeshSimplifier.h"
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	struct KindInfo
+	{
+		const char* Name;
+		std::uint32_t SizeCount;
+		std::uint32_t CountCount;
+	};
+
+	const KindInfo Kinds[] =
+	{
+		{ "box", 3, 1 },
+		{ "sphere", 1, 2 },
+		{ "geosphere", 1, 1 },
+		{ "cylinder", 3, 2 },
+		{ "grid", 2, 2 },
+		{ "quad", 5, 0 },
+	};
+
+	std::uint32_t FloatBits(float f)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+
+	// Indices of the full mesh, then with lods each coarser level simplified from the
+	// one before with borders locked, as in ObjReader's LOD chain.  TangentU sits between
+	// Normal and TexC, so the attributes are all three.
+	template<typename Index>
+	void BuildIndices(const GeometryGenerator::MeshData& meshData, const std::vector<Index>& full, bool lods,
+		std::vector<Index>& indices, std::vector<RenderItemLod>& levels)
+	{
+		indices = full;
+		levels.clear();
+		if (!lods)
+			return;
+
+		const GeometryGenerator::Vertex* vertices = meshData.Vertices.data();
+		levels.push_back(RenderItemLod{ (UINT)full.size(), 0, 0.0f });
+		for (float ratio : MeshSimplifier::DefaultLodRatios)
+		{
+			RenderItemLod previous = levels.back();
+			std::vector<Index> lod(indices.begin() + previous.StartIndexLocation,
+				indices.begin() + previous.StartIndexLocation + previous.IndexCount);
+			float error = 0.0f;
+			size_t lodCount = MeshSimplifier::Simplify(lod.data(), lod.data(), lod.size(),
+				&vertices[0].Position, meshData.Vertices.size(), sizeof(GeometryGenerator::Vertex),
+				(size_t)(full.size() * ratio), FLT_MAX, MeshSimplifyLockBorder, &error, &vertices[0].Normal.x, 8);
+			if (lodCount == 0 || lodCount == previous.IndexCount)
+				break;
+			levels.push_back(RenderItemLod{ (UINT)lodCount, (UINT)indices.size(), previous.Error + error });
+			indices.insert(indices.end(), lod.begin(), lod.begin() + lodCount);
+		}
+	}
+
+	template<typename Index>
+	void CopyIndices(const std::vector<Index>& indices, MeshGeometry& geo)
+	{
+		geo.IndexFormat = sizeof(Index) == sizeof(std::uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		geo.IndexBufferByteSize = (UINT)(indices.size() * sizeof(Index));
+		ThrowIfFailed(D3DCreateBlob(geo.IndexBufferByteSize, &geo.IndexBufferCPU));
+		CopyMemory(geo.IndexBufferCPU->GetBufferPointer(), indices.data(), geo.IndexBufferByteSize);
+	}
+
+	// Part indices followed by those of each LOD, which is how they sit in the file.
+	template<typename Index, typename Span>
+	void ReadIndices(const MboFile& file, Span (MboFile::*lodIndices)(UINT, UINT)const, Span part,
+		std::vector<Index>& indices, std::vector<RenderItemLod>& levels)
+	{
+		indices.assign(part.begin(), part.end());
+		if (!file.HasLods())
+			return;
+		const MboLodRange& range = file.LodRange(0);
+		levels.push_back(RenderItemLod{ (UINT)part.size(), 0, 0.0f });
+		for (UINT lod = 0; lod < range.LodCount; ++lod)
+		{
+			Span span = (file.*lodIndices)(0, lod);
+			levels.push_back(RenderItemLod{ (UINT)span.size(), (UINT)indices.size(), file.Lod(range.FirstLod + lod).Error });
+			indices.insert(indices.end(), span.begin(), span.end());
+		}
+	}
+}
+
+const char* const ProceduralMeshCache::SubmeshName = "mesh";
+
+ProceduralMeshDesc ProceduralMeshDesc::Box(float width, float height, float depth, std::uint32_t numSubdivisions)
+{
+	ProceduralMeshDesc desc;
+	desc.Kind = ProceduralMeshKind::Box;
+	desc.Sizes[0] = width;
+	desc.Sizes[1] = height;
+	desc.Sizes[2] = depth;
+	desc.Counts[0] = numSubdivisions;
+	return desc;
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Sphere(float radius, std::uint32_t sliceCount, std::uint32_t stackCount)
+{
+	ProceduralMeshDesc desc;
+	desc.Kind = ProceduralMeshKind::Sphere;
+	desc.Sizes[0] = radius;
+	desc.Counts[0] = sliceCount;
+	desc.Counts[1] = stackCount;
+	return desc;
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Geosphere(float radius, std::uint32_t numSubdivisions)
+{
+	ProceduralMeshDesc desc;
+	desc.Kind = ProceduralMeshKind::Geosphere;
+	desc.Sizes[0] = radius;
+	desc.Counts[0] = numSubdivisions;
+	return desc;
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Cylinder(float bottomRadius, float topRadius, float height,
+	std::uint32_t sliceCount, std::uint32_t stackCount)
+{
+	ProceduralMeshDesc desc;
+	desc.Kind = ProceduralMeshKind::Cylinder;
+	desc.Sizes[0] = bottomRadius;
+	desc.Sizes[1] = topRadius;
+	desc.Sizes[2] = height;
+	desc.Counts[0] = sliceCount;
+	desc.Counts[1] = stackCount;
+	return desc;
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Grid(float width, float depth, std::uint32_t m, std::uint32_t n)
+{
+	ProceduralMeshDesc desc;
+	desc.Kind = ProceduralMeshKind::Grid;
+	desc.Sizes[0] = width;
+	desc.Sizes[1] = depth;
+	desc.Counts[0] = m;
+	desc.Counts[1] = n;
+	return desc;
+}
+
+ProceduralMeshDesc ProceduralMeshDesc::Quad(float x, float y, float w, float h, float depth)
+{
+	ProceduralMeshDesc desc;
+	desc.Kind = ProceduralMeshKind::Quad;
+	desc.Sizes[0] = x;
+	desc.Sizes[1] = y;
+	desc.Sizes[2] = w;
+	desc.Sizes[3] = h;
+	desc.Sizes[4] = depth;
+	return desc;
+}
+
+bool ProceduralMeshKey::operator==(const ProceduralMeshKey& rhs)const
+{
+	if (Desc.Kind != rhs.Desc.Kind || Desc.Lods != rhs.Desc.Lods ||
+		VertexFormat != rhs.VertexFormat || VertexStride != rhs.VertexStride)
+		return false;
+	for (size_t i = 0; i < _countof(Desc.Sizes); ++i)
+	{
+		if (FloatBits(Desc.Sizes[i]) != FloatBits(rhs.Desc.Sizes[i]))
+			return false;
+	}
+	return Desc.Counts[0] == rhs.Desc.Counts[0] && Desc.Counts[1] == rhs.Desc.Counts[1];
+}
+
+std::string ProceduralMeshKey::Name()const
+{
+	const KindInfo& kind = Kinds[(size_t)Desc.Kind];
+	std::string name = kind.Name;
+	char text[32];
+	for (std::uint32_t i = 0; i < kind.SizeCount + kind.CountCount; ++i)
+	{
+		if (i < kind.SizeCount)
+			snprintf(text, sizeof(text), "%c%.9g", i ? ',' : '(', Desc.Sizes[i]);
+		else
+			snprintf(text, sizeof(text), "%c%u", i ? ',' : '(', Desc.Counts[i - kind.SizeCount]);
+		name += text;
+	}
+	snprintf(text, sizeof(text), ")%s format %u/%u", Desc.Lods ? " lods" : "", VertexFormat, VertexStride);
+	name += text;
+	return name;
+}
+
+size_t ProceduralMeshKeyHash::operator()(const ProceduralMeshKey& key)const
+{
+	std::uint64_t h = ((std::uint64_t)key.Desc.Kind << 1 | (key.Desc.Lods ? 1 : 0)) * 0x9E3779B97F4A7C15ull;
+	h = (h ^ key.VertexFormat ^ ((std::uint64_t)key.VertexStride << 32)) * 0xC2B2AE3D27D4EB4Full;
+	for (float size : key.Desc.Sizes)
+		h = (h ^ FloatBits(size)) * 0x165667B19E3779F9ull;
+	h = (h ^ key.Desc.Counts[0] ^ ((std::uint64_t)key.Desc.Counts[1] << 32)) * 0x9E3779B97F4A7C15ull;
+	return (size_t)(h ^ (h >> 29));
+}
+
+void ProceduralMeshCache::Trim()
+{
+	for (auto it = mMeshes.begin(); it != mMeshes.end();)
+	{
+		if (it->second.use_count() == 1)
+			it = mMeshes.erase(it);
+		else
+			++it;
+	}
+}
+
+std::shared_ptr<ProceduralMesh> ProceduralMeshCache::Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+	const ProceduralMeshKey& key, VertexStore store, bool mboVertex, std::uint32_t numThreads)
+{
+	auto mesh = std::make_shared<ProceduralMesh>();
+	bool persist = !mDirectory.empty() && mboVertex;
+	std::wstring fileName = persist ? FileName(key) : std::wstring();
+	if (persist && Load(fileName, key, *mesh))
+	{
+		++mStatistics.Loaded;
+	}
+	else
+	{
+		Generate(key, store, numThreads, *mesh);
+		++mStatistics.Generated;
+		if (persist && Save(fileName, key, *mesh))
+			++mStatistics.Saved;
+	}
+
+	MeshGeometry& geo = mesh->Geometry;
+	geo.Name = key.Name();
+	geo.VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList,
+		geo.VertexBufferCPU->GetBufferPointer(), geo.VertexBufferByteSize, geo.VertexBufferUploader);
+	geo.IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList,
+		geo.IndexBufferCPU->GetBufferPointer(), geo.IndexBufferByteSize, geo.IndexBufferUploader);
+
+	mMeshes.emplace(key, mesh);
+	return mesh;
+}
+
+void ProceduralMeshCache::Generate(const ProceduralMeshKey& key, VertexStore store,
+	std::uint32_t numThreads, ProceduralMesh& mesh)
+{
+	const ProceduralMeshDesc& desc = key.Desc;
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData;
+	switch (desc.Kind)
+	{
+	case ProceduralMeshKind::Box:
+		meshData = geoGen.CreateBox(desc.Sizes[0], desc.Sizes[1], desc.Sizes[2], desc.Counts[0]);
+		break;
+	case ProceduralMeshKind::Sphere:
+		meshData = geoGen.CreateSphere(desc.Sizes[0], desc.Counts[0], desc.Counts[1]);
+		break;
+	case ProceduralMeshKind::Geosphere:
+		meshData = geoGen.CreateGeosphere(desc.Sizes[0], desc.Counts[0], numThreads);
+		break;
+	case ProceduralMeshKind::Cylinder:
+		meshData = geoGen.CreateCylinder(desc.Sizes[0], desc.Sizes[1], desc.Sizes[2], desc.Counts[0], desc.Counts[1]);
+		break;
+	case ProceduralMeshKind::Grid:
+		meshData = geoGen.CreateGrid(desc.Sizes[0], desc.Sizes[1], desc.Counts[0], desc.Counts[1], numThreads);
+		break;
+	case ProceduralMeshKind::Quad:
+		meshData = geoGen.CreateQuad(desc.Sizes[0], desc.Sizes[1], desc.Sizes[2], desc.Sizes[3], desc.Sizes[4]);
+		break;
+	}
+
+	MeshGeometry& geo = mesh.Geometry;
+	const size_t vertexCount = meshData.Vertices.size();
+	geo.VertexByteStride = key.VertexStride;
+	geo.VertexBufferByteSize = (UINT)(vertexCount * key.VertexStride);
+	ThrowIfFailed(D3DCreateBlob(geo.VertexBufferByteSize, &geo.VertexBufferCPU));
+	store(geo.VertexBufferCPU->GetBufferPointer(), meshData.Vertices.data(), vertexCount);
+
+	if (vertexCount <= 65536)
+	{
+		std::vector<std::uint16_t> indices;
+		BuildIndices(meshData, meshData.GetIndices16(), desc.Lods, indices, mesh.Lods);
+		CopyIndices(indices, geo);
+	}
+	else
+	{
+		std::vector<std::uint32_t> indices;
+		BuildIndices(meshData, meshData.Indices32, desc.Lods, indices, mesh.Lods);
+		CopyIndices(indices, geo);
+	}
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)meshData.Indices32.size();
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
+	if (vertexCount)
+		BoundingBox::CreateFromPoints(submesh.Bounds, vertexCount, &meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+	geo.DrawArgs[SubmeshName] = submesh;
+}
+
+bool ProceduralMeshCache::Load(const std::wstring& fileName, const ProceduralMeshKey& key, ProceduralMesh& mesh)
+{
+	MboFile file;
+	if (!file.Open(fileName.c_str()))
+		return false;
+	if (file.IsQuantized() || file.PartCount() != 1 || file.PartName(0) != key.Name())
+		return false;
+
+	MeshGeometry& geo = mesh.Geometry;
+	MboSpan<VertexPosNormalTex> vertices = file.Vertices(0);
+	geo.VertexByteStride = key.VertexStride;
+	geo.VertexBufferByteSize = (UINT)(vertices.size() * sizeof(VertexPosNormalTex));
+	ThrowIfFailed(D3DCreateBlob(geo.VertexBufferByteSize, &geo.VertexBufferCPU));
+	CopyMemory(geo.VertexBufferCPU->GetBufferPointer(), vertices.Data, geo.VertexBufferByteSize);
+
+	mesh.Lods.clear();
+	const MboPart& part = file.Part(0);
+	if (part.IndexStride == sizeof(WORD))
+	{
+		std::vector<WORD> indices;
+		ReadIndices(file, &MboFile::LodIndices16, file.Indices16(0), indices, mesh.Lods);
+		CopyIndices(indices, geo);
+	}
+	else
+	{
+		std::vector<DWORD> indices;
+		ReadIndices(file, &MboFile::LodIndices32, file.Indices32(0), indices, mesh.Lods);
+		CopyIndices(indices, geo);
+	}
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = part.IndexCount;
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
+	BoundingBox::CreateFromPoints(submesh.Bounds, XMLoadFloat3(&file.Header().VMin), XMLoadFloat3(&file.Header().VMax));
+	geo.DrawArgs[SubmeshName] = submesh;
+	return true;
+}
+
+bool ProceduralMeshCache::Save(const std::wstring& fileName, const ProceduralMeshKey& key, const ProceduralMesh& mesh)
+{
+	const MeshGeometry& geo = mesh.Geometry;
+	const SubmeshGeometry& submesh = geo.DrawArgs.at(SubmeshName);
+	const bool wide = geo.IndexFormat == DXGI_FORMAT_R32_UINT;
+	const std::uint32_t indexStride = wide ? sizeof(DWORD) : sizeof(WORD);
+
+	MboWriter writer;
+	MboPart part = {};
+	std::string name = key.Name();
+	part.Name = writer.AddString(name.data(), name.size());
+	part.FirstVertex = 0;
+	part.VertexCount = geo.VertexBufferByteSize / geo.VertexByteStride;
+	part.FirstIndex = 0;
+	part.IndexCount = submesh.IndexCount;
+	part.IndexStride = indexStride;
+	writer.AddSection(MboSectionType::Parts, sizeof(MboPart), &part, sizeof(MboPart));
+	writer.AddSection(MboSectionType::Vertices, sizeof(VertexPosNormalTex),
+		geo.VertexBufferCPU->GetBufferPointer(), geo.VertexBufferByteSize);
+
+	// The LODs already follow the full mesh in the index buffer, as MBO stores them.
+	const void* indices = geo.IndexBufferCPU->GetBufferPointer();
+	writer.AddSection(MboSectionType::Indices16, sizeof(WORD), wide ? nullptr : indices, wide ? 0 : geo.IndexBufferByteSize);
+	writer.AddSection(MboSectionType::Indices32, sizeof(DWORD), wide ? indices : nullptr, wide ? geo.IndexBufferByteSize : 0);
+	if (mesh.Lods.size() > 1)
+	{
+		MboLodRange range = { 0, (std::uint32_t)mesh.Lods.size() - 1 };
+		std::vector<MboLod> lods;
+		for (size_t i = 1; i < mesh.Lods.size(); ++i)
+		{
+			MboLod lod = {};
+			lod.FirstIndex = mesh.Lods[i].StartIndexLocation;
+			lod.IndexCount = mesh.Lods[i].IndexCount;
+			lod.Error = mesh.Lods[i].Error;
+			lods.push_back(lod);
+		}
+		writer.AddSection(MboSectionType::LodRanges, sizeof(MboLodRange), &range, sizeof(MboLodRange));
+		writer.AddSection(MboSectionType::Lods, sizeof(MboLod), lods.data(), lods.size() * sizeof(MboLod));
+	}
+
+	XMFLOAT3 vMin, vMax;
+	XMVECTOR center = XMLoadFloat3(&submesh.Bounds.Center);
+	XMVECTOR extents = XMLoadFloat3(&submesh.Bounds.Extents);
+	XMStoreFloat3(&vMin, XMVectorSubtract(center, extents));
+	XMStoreFloat3(&vMax, XMVectorAdd(center, extents));
+	return writer.Write(fileName.c_str(), vMin, vMax);
+}
+
+std::wstring ProceduralMeshCache::FileName(const ProceduralMeshKey& key)const
+{
+	// FNV-1a of the name, so the file name does not change between runs or builds.
+	std::uint64_t h = 0xCBF29CE484222325ull;
+	for (char c : key.Name())
+		h = (h ^ (std::uint8_t)c) * 0x100000001B3ull;
+	wchar_t text[24];
+	swprintf(text, _countof(text), L"/%016llx.mbo", (unsigned long long)h);
+	return mDirectory + text;
+}
@@ -0,0 +1,159 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// cache of procedurally generated meshes
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "d3dUtil.h"
+#include "GeometryGenerator.h"
+#include "RenderItem.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class ProceduralMeshKind : std::uint32_t
+{
+	Box,
+	Sphere,
+	Geosphere,
+	Cylinder,
+	Grid,
+	Quad
+};
+
+// The parameters of one GeometryGenerator Create call.  Build it with the function of
+// the same name, which leaves the parameters that kind has no use for at 0.
+struct ProceduralMeshDesc
+{
+	ProceduralMeshKind Kind = ProceduralMeshKind::Box;
+	// The float and the count parameters of the Create function, in order.
+	float Sizes[5] = {};
+	std::uint32_t Counts[2] = {};
+	// Append a MeshSimplifier chain at MeshSimplifier::DefaultLodRatios after the
+	// full-detail indices.
+	bool Lods = false;
+
+	static ProceduralMeshDesc Box(float width, float height, float depth, std::uint32_t numSubdivisions = 0);
+	static ProceduralMeshDesc Sphere(float radius, std::uint32_t sliceCount, std::uint32_t stackCount);
+	static ProceduralMeshDesc Geosphere(float radius, std::uint32_t numSubdivisions);
+	static ProceduralMeshDesc Cylinder(float bottomRadius, float topRadius, float height,
+		std::uint32_t sliceCount, std::uint32_t stackCount);
+	static ProceduralMeshDesc Grid(float width, float depth, std::uint32_t m, std::uint32_t n);
+	static ProceduralMeshDesc Quad(float x, float y, float w, float h, float depth);
+};
+
+// Floats compare by their bits, so the key of -0 differs from that of 0 and NaN matches.
+struct ProceduralMeshKey
+{
+	ProceduralMeshDesc Desc;
+	std::uint32_t VertexFormat = 0;  // GeometryVertexFormat<VertexOut>::Id
+	std::uint32_t VertexStride = 0;
+
+	bool operator==(const ProceduralMeshKey& rhs)const;
+	// Readable and exact: floats are printed with enough digits to read back the same.
+	std::string Name()const;
+};
+
+struct ProceduralMeshKeyHash
+{
+	size_t operator()(const ProceduralMeshKey& key)const;
+};
+
+// A generated mesh on the GPU.  Geometry.DrawArgs["mesh"] covers the full-detail mesh;
+// with ProceduralMeshDesc::Lods, Lods holds the levels finest first with Lods[0] the
+// full mesh, ready to copy into RenderItem::Lods.
+struct ProceduralMesh
+{
+	MeshGeometry Geometry;
+	std::vector<RenderItemLod> Lods;
+};
+
+struct ProceduralMeshCacheStatistics
+{
+	size_t Hits = 0;
+	size_t Generated = 0;
+	// Misses served from the cache directory instead of being generated.
+	size_t Loaded = 0;
+	size_t Saved = 0;
+};
+
+// Hands out one shared mesh per (kind, parameters, vertex format), so asking for the same
+// primitive again costs a hash lookup instead of generating and uploading it again.  A
+// miss generates through the MeshData Create functions, converts the vertices with
+// GeometryVertexFormat<VertexOut>::Store straight into the vertex blob, and records
+// buffer uploads on the command list, which must be open and executed before the mesh is
+// drawn.  Meshes of up to 65536 vertices get 16-bit indices.
+//
+// With a cache directory set, a miss first tries <directory>/<key hash>.mbo and writes
+// that file after generating.  Only vertex formats whose GeometryVertexFormat sets
+// MboVertex fit the MBO vertex section, so other formats are always generated.  The file's part name
+// holds ProceduralMeshKey::Name, so a hash collision or stale file is regenerated.
+//
+// The cache holds a reference to everything it made until Trim or Clear; the handles it
+// returns stay valid after either.  It is not thread-safe.
+class ProceduralMeshCache
+{
+public:
+	// Also the submesh name in DrawArgs.
+	static const char* const SubmeshName;
+
+	// An empty directory, the default, keeps the cache in memory only.
+	void SetDirectory(const std::wstring& directory) { mDirectory = directory; }
+
+	// VertexOut needs a GeometryVertexFormat with a unique Id and must start with its
+	// XMFLOAT3 position.  numThreads (0 uses every hardware thread) only speeds up
+	// generating geospheres and grids; it is not part of the key.
+	template<typename VertexOut>
+	std::shared_ptr<ProceduralMesh> Get(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		const ProceduralMeshDesc& desc, std::uint32_t numThreads = 1)
+	{
+		static_assert(!GeometryVertexFormat<VertexOut>::MboVertex || sizeof(VertexOut) == sizeof(VertexPosNormalTex),
+			"an MboVertex format must be laid out like VertexPosNormalTex");
+		ProceduralMeshKey key;
+		key.Desc = desc;
+		key.VertexFormat = GeometryVertexFormat<VertexOut>::Id;
+		key.VertexStride = sizeof(VertexOut);
+		auto it = mMeshes.find(key);
+		if (it != mMeshes.end())
+		{
+			++mStatistics.Hits;
+			return it->second;
+		}
+		return Create(device, cmdList, key, &StoreVertices<VertexOut>, GeometryVertexFormat<VertexOut>::MboVertex,
+			numThreads);
+	}
+
+	// Drops the meshes no one else holds a handle to.
+	void Trim();
+	void Clear() { mMeshes.clear(); }
+
+	size_t size()const { return mMeshes.size(); }
+	const ProceduralMeshCacheStatistics& Statistics()const { return mStatistics; }
+
+private:
+	// Converts count generated vertices into the key's format at out, one call per mesh.
+	using VertexStore = void (*)(void* out, const GeometryGenerator::Vertex* vertices, size_t count);
+
+	template<typename VertexOut>
+	static void StoreVertices(void* out, const GeometryGenerator::Vertex* vertices, size_t count)
+	{
+		VertexOut* outVertices = static_cast<VertexOut*>(out);
+		for (size_t i = 0; i < count; ++i)
+			GeometryVertexFormat<VertexOut>::Store(outVertices[i], vertices[i]);
+	}
+
+	std::shared_ptr<ProceduralMesh> Create(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		const ProceduralMeshKey& key, VertexStore store, bool mboVertex, std::uint32_t numThreads);
+	void Generate(const ProceduralMeshKey& key, VertexStore store, std::uint32_t numThreads,
+		ProceduralMesh& mesh);
+	bool Load(const std::wstring& fileName, const ProceduralMeshKey& key, ProceduralMesh& mesh);
+	bool Save(const std::wstring& fileName, const ProceduralMeshKey& key, const ProceduralMesh& mesh);
+	std::wstring FileName(const ProceduralMeshKey& key)const;
+
+	std::unordered_map<ProceduralMeshKey, std::shared_ptr<ProceduralMesh>, ProceduralMeshKeyHash> mMeshes;
+	std::wstring mDirectory;
+	ProceduralMeshCacheStatistics mStatistics;
+};
@@ -12,6 +12,13 @@
 
 const int gNumFrameResources = 3;
 
+// One level of detail: a range of the item's index buffer and how far, in model units,
+// its surface departs from the full-detail mesh.
+struct RenderItemLod {
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	float Error = 0.0f;
+};
 
 struct RenderItem {
 	RenderItem() = default;
@@ -34,5 +41,13 @@ struct RenderItem {
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// Levels of detail, finest first with Lods[0] the full mesh.  When there are any,
+	// LodSelector copies the range of CurrentLod into IndexCount/StartIndexLocation.
+	std::vector<RenderItemLod> Lods;
+	UINT CurrentLod = 0;
+
+	// Model space bounds, used to measure how large an error looks on screen.
+	DirectX::BoundingSphere Bounds;
 };
 
@@ -0,0 +1,347 @@
+#include "Terrain.h"
+#include "GeometryGenerator.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+const D3D12_INPUT_ELEMENT_DESC TerrainVertex::inputLayout[4] = {
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+	{ "MORPHHEIGHT", 0, DXGI_FORMAT_R32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+};
+
+struct Terrain::BuildContext
+{
+	const float* Heights;
+	float HalfWidth;
+	float HalfDepth;
+	// Scratch space for one node's heights.
+	std::vector<float> NodeHeights;
+
+	float Height(std::uint32_t row, std::uint32_t col, std::uint32_t width)const { return Heights[(size_t)row * width + col]; }
+};
+
+struct Terrain::SelectContext
+{
+	XMFLOAT3 Eye;
+	const XMFLOAT4* Planes;
+	float RangesSq[MaxLevels];
+	float MorphStart[MaxLevels];
+	float MorphEnd[MaxLevels];
+	std::vector<TerrainChunk>* Chunks;
+	TerrainSelectStatistics Stats;
+};
+
+namespace
+{
+	float DistanceSq(const XMFLOAT3& p, const BoundingBox& box)
+	{
+		float dx = std::max(std::abs(p.x - box.Center.x) - box.Extents.x, 0.0f);
+		float dy = std::max(std::abs(p.y - box.Center.y) - box.Extents.y, 0.0f);
+		float dz = std::max(std::abs(p.z - box.Center.z) - box.Extents.z, 0.0f);
+		return dx * dx + dy * dy + dz * dz;
+	}
+}
+
+void Terrain::Build(const float* heights, std::uint32_t width, std::uint32_t depth, float spacing,
+	std::uint32_t chunkQuads, std::uint32_t levelCount)
+{
+	mNodes.clear();
+	mRoots.clear();
+	mVertices.clear();
+	mIndices.clear();
+	mDiagonals.clear();
+	mWidth = width;
+	mDepth = depth;
+	mSpacing = spacing;
+	mChunkQuads = std::min(std::max(chunkQuads & ~1u, 2u), MaxChunkQuads);
+	if (width < 2 || depth < 2)
+	{
+		mLevelCount = 0;
+		return;
+	}
+
+	const std::uint32_t quadsX = width - 1, quadsZ = depth - 1;
+	if (levelCount == 0)
+	{
+		levelCount = 1;
+		while (levelCount < MaxLevels && ((std::uint64_t)mChunkQuads << (levelCount - 1)) < std::max(quadsX, quadsZ))
+			++levelCount;
+	}
+	mLevelCount = std::min(levelCount, MaxLevels);
+	mDiagonals.assign(mLevelCount, 0.0f);
+
+	//
+	// One grid for every node, its quads regrouped by quadrant.
+	//
+
+	const std::uint32_t n = mChunkQuads, half = n / 2;
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(n + 1, n + 1);
+	std::vector<GeometryGenerator::Vertex> grid(size.VertexCount);
+	std::vector<std::uint16_t> gridIndices(size.IndexCount);
+	geoGen.CreateGrid((float)n, (float)n, n + 1, n + 1, grid.data(), gridIndices.data());
+
+	mIndices.reserve(gridIndices.size());
+	for (std::uint32_t q = 0; q < 4; ++q)
+	{
+		for (std::uint32_t i = (q / 2) * half; i < (q / 2 + 1) * half; ++i)
+		{
+			for (std::uint32_t j = (q % 2) * half; j < (q % 2 + 1) * half; ++j)
+			{
+				auto quad = gridIndices.begin() + (i * n + j) * 6;
+				mIndices.insert(mIndices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	//
+	// Root nodes tile the heightmap; children past its edges are left out.
+	//
+
+	BuildContext context;
+	context.Heights = heights;
+	context.HalfWidth = 0.5f * quadsX * spacing;
+	context.HalfDepth = 0.5f * quadsZ * spacing;
+	context.NodeHeights.resize((n + 1) * (n + 1));
+
+	const std::uint64_t rootQuads = (std::uint64_t)n << (mLevelCount - 1);
+	for (std::uint64_t row = 0; row < quadsZ; row += rootQuads)
+	{
+		for (std::uint64_t col = 0; col < quadsX; col += rootQuads)
+			mRoots.push_back(AddNode(context, mLevelCount - 1, (std::uint32_t)row, (std::uint32_t)col));
+	}
+}
+
+std::uint32_t Terrain::AddNode(BuildContext& context, std::uint32_t level, std::uint32_t row, std::uint32_t col)
+{
+	const std::uint32_t n = mChunkQuads, step = 1u << level;
+	const std::uint32_t index = (std::uint32_t)mNodes.size();
+	mNodes.emplace_back();
+	{
+		TerrainNode& node = mNodes.back();
+		node.Level = level;
+		node.BaseVertex = (std::uint32_t)mVertices.size();
+		std::fill(std::begin(node.Children), std::end(node.Children), NoNode);
+	}
+
+	// Grid points past the heightmap are clamped onto its edge, where their triangles
+	// collapse.
+	auto sampleRow = [&](std::uint64_t i) { return (std::uint32_t)std::min<std::uint64_t>(row + i * step, mDepth - 1); };
+	auto sampleCol = [&](std::uint64_t j) { return (std::uint32_t)std::min<std::uint64_t>(col + j * step, mWidth - 1); };
+	float* h = context.NodeHeights.data();
+	for (std::uint32_t i = 0; i <= n; ++i)
+	{
+		for (std::uint32_t j = 0; j <= n; ++j)
+			h[i * (n + 1) + j] = context.Height(sampleRow(i), sampleCol(j), mWidth);
+	}
+
+	XMVECTOR lo = g_XMInfinity, hi = g_XMNegInfinity;
+	for (std::uint32_t i = 0; i <= n; ++i)
+	{
+		std::uint32_t r = sampleRow(i);
+		std::uint32_t r0 = r > 0 ? r - 1 : r, r1 = std::min(r + 1, mDepth - 1);
+		for (std::uint32_t j = 0; j <= n; ++j)
+		{
+			std::uint32_t c = sampleCol(j);
+			std::uint32_t c0 = c > 0 ? c - 1 : c, c1 = std::min(c + 1, mWidth - 1);
+
+			TerrainVertex v;
+			v.pos = XMFLOAT3(-context.HalfWidth + c * mSpacing, h[i * (n + 1) + j], context.HalfDepth - r * mSpacing);
+
+			// Central differences on the full heightmap; z runs against the rows.
+			float dhdx = (context.Height(r, c1, mWidth) - context.Height(r, c0, mWidth)) / ((c1 - c0) * mSpacing);
+			float dhdz = (context.Height(r0, c, mWidth) - context.Height(r1, c, mWidth)) / ((r1 - r0) * mSpacing);
+			XMStoreFloat3(&v.normal, XMVector3Normalize(XMVectorSet(-dhdx, 1.0f, -dhdz, 0.0f)));
+			v.tex = XMFLOAT2((float)c / (mWidth - 1), (float)r / (mDepth - 1));
+
+			// The parent's grid keeps the even points and splits each of its quads along
+			// the same diagonal as CreateGrid, from (i-1, j+1) to (i+1, j-1).
+			auto at = [&](std::uint32_t ii, std::uint32_t jj) { return h[ii * (n + 1) + jj]; };
+			if (i % 2 == 0 && j % 2 == 0)
+				v.morphHeight = at(i, j);
+			else if (i % 2 == 0)
+				v.morphHeight = 0.5f * (at(i, j - 1) + at(i, j + 1));
+			else if (j % 2 == 0)
+				v.morphHeight = 0.5f * (at(i - 1, j) + at(i + 1, j));
+			else
+				v.morphHeight = 0.5f * (at(i - 1, j + 1) + at(i + 1, j - 1));
+			if (level == mLevelCount - 1)
+				v.morphHeight = v.pos.y;
+
+			XMVECTOR p = XMLoadFloat3(&v.pos);
+			lo = XMVectorMin(lo, p);
+			hi = XMVectorMax(hi, p);
+			mVertices.push_back(v);
+		}
+	}
+	BoundingBox::CreateFromPoints(mNodes[index].Bounds, lo, hi);
+	mDiagonals[level] = std::max(mDiagonals[level], XMVectorGetX(XMVector3Length(XMVectorSubtract(hi, lo))));
+
+	if (level > 0)
+	{
+		const std::uint32_t childQuads = (n / 2) << level;
+		for (std::uint32_t q = 0; q < 4; ++q)
+		{
+			std::uint64_t childRow = row + (std::uint64_t)(q / 2) * childQuads;
+			std::uint64_t childCol = col + (std::uint64_t)(q % 2) * childQuads;
+			if (childRow >= mDepth - 1 || childCol >= mWidth - 1)
+				continue;
+			std::uint32_t child = AddNode(context, level - 1, (std::uint32_t)childRow, (std::uint32_t)childCol);
+			mNodes[index].Children[q] = child;
+		}
+	}
+	return index;
+}
+
+std::unique_ptr<MeshGeometry> Terrain::CreateGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+	const std::string& name)const
+{
+	const UINT vbByteSize = (UINT)(mVertices.size() * sizeof(TerrainVertex));
+	const UINT ibByteSize = (UINT)(mIndices.size() * sizeof(std::uint16_t));
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = name;
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mVertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), mIndices.data(), ibByteSize);
+
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList, mVertices.data(), vbByteSize,
+		geo->VertexBufferUploader);
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(device, cmdList, mIndices.data(), ibByteSize,
+		geo->IndexBufferUploader);
+
+	geo->VertexByteStride = sizeof(TerrainVertex);
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
+
+	SubmeshGeometry submesh;
+	submesh.IndexCount = (UINT)mIndices.size();
+	submesh.StartIndexLocation = 0;
+	submesh.BaseVertexLocation = 0;
+	if (!mRoots.empty())
+	{
+		XMVECTOR lo = g_XMInfinity, hi = g_XMNegInfinity;
+		for (std::uint32_t root : mRoots)
+		{
+			const BoundingBox& bounds = mNodes[root].Bounds;
+			XMVECTOR center = XMLoadFloat3(&bounds.Center), extents = XMLoadFloat3(&bounds.Extents);
+			lo = XMVectorMin(lo, XMVectorSubtract(center, extents));
+			hi = XMVectorMax(hi, XMVectorAdd(center, extents));
+		}
+		BoundingBox::CreateFromPoints(submesh.Bounds, lo, hi);
+	}
+	geo->DrawArgs["grid"] = submesh;
+	return geo;
+}
+
+TerrainSelectStatistics Terrain::Select(const LodView& view, const XMFLOAT4* planes,
+	std::vector<TerrainChunk>& chunks, float threshold, float morphStart)const
+{
+	SelectContext context;
+	context.Eye = view.EyePos;
+	context.Planes = planes;
+	context.Chunks = &chunks;
+	context.Stats.FullTriangles = mWidth > 1 && mDepth > 1 ? (size_t)(mWidth - 1) * (mDepth - 1) * 2 : 0;
+	chunks.clear();
+
+	// A level's range is where its quads shrink to threshold pixels, but at least twice
+	// the longest diagonal of its nodes: a node drawn at one level then reaches at most
+	// half way into the next level's range, so it has morphed fully where it meets a
+	// coarser neighbour and that neighbour has not started morphing yet.
+	float range = 0.0f;
+	for (std::uint32_t level = 0; level < mLevelCount; ++level)
+	{
+		float quad = mSpacing * (float)(1u << level);
+		float previous = range;
+		range = std::max({ quad * view.PixelsPerUnit / std::max(threshold, 1e-6f), 2.0f * mDiagonals[level], range * 2.0f });
+		context.RangesSq[level] = range * range;
+		context.MorphStart[level] = previous + (range - previous) * morphStart;
+		context.MorphEnd[level] = range;
+	}
+
+	for (std::uint32_t root : mRoots)
+		SelectNode(context, root, planes == nullptr);
+	return context.Stats;
+}
+
+// Returns false if the node is out of its level's range, so that its parent has to
+// cover its area.
+bool Terrain::SelectNode(SelectContext& context, std::uint32_t index, bool inside)const
+{
+	const TerrainNode& node = mNodes[index];
+	++context.Stats.NodesVisited;
+
+	float distanceSq = DistanceSq(context.Eye, node.Bounds);
+	if (node.Level + 1 < mLevelCount && distanceSq > context.RangesSq[node.Level])
+		return false;
+
+	// Children of a node entirely inside the frustum are not tested again.
+	if (!inside)
+	{
+		inside = true;
+		for (int i = 0; i < 6; ++i)
+		{
+			const XMFLOAT4& plane = context.Planes[i];
+			const BoundingBox& box = node.Bounds;
+			float d = plane.x * box.Center.x + plane.y * box.Center.y + plane.z * box.Center.z + plane.w;
+			float r = std::abs(plane.x) * box.Extents.x + std::abs(plane.y) * box.Extents.y + std::abs(plane.z) * box.Extents.z;
+			if (d < -r)
+			{
+				++context.Stats.NodesCulled;
+				return true;
+			}
+			inside = inside && d >= r;
+		}
+	}
+
+	if (node.Level == 0 || distanceSq > context.RangesSq[node.Level - 1])
+	{
+		AddChunk(context, index, 0, 4);
+		return true;
+	}
+
+	// The node draws the quadrants whose children are still out of their range; runs of
+	// neighbouring quadrants in the index buffer go out as one chunk.
+	std::uint32_t first = 0, count = 0;
+	for (std::uint32_t q = 0; q < 4; ++q)
+	{
+		std::uint32_t child = node.Children[q];
+		if (child != NoNode && !SelectNode(context, child, inside))
+		{
+			if (count == 0)
+				first = q;
+			++count;
+			continue;
+		}
+		if (count)
+			AddChunk(context, index, first, count);
+		count = 0;
+	}
+	if (count)
+		AddChunk(context, index, first, count);
+	return true;
+}
+
+void Terrain::AddChunk(SelectContext& context, std::uint32_t index, std::uint32_t firstQuadrant,
+	std::uint32_t quadrantCount)const
+{
+	const TerrainNode& node = mNodes[index];
+	const UINT quadrantIndices = (UINT)(mIndices.size() / 4);
+	TerrainChunk chunk;
+	chunk.Node = index;
+	chunk.IndexCount = quadrantCount * quadrantIndices;
+	chunk.StartIndexLocation = firstQuadrant * quadrantIndices;
+	chunk.BaseVertexLocation = (INT)node.BaseVertex;
+	chunk.MorphStart = context.MorphStart[node.Level];
+	chunk.MorphEnd = context.MorphEnd[node.Level];
+	context.Chunks->push_back(chunk);
+	++context.Stats.Chunks;
+	context.Stats.Triangles += chunk.IndexCount / 3;
+}
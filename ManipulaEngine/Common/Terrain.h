@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// chunked quadtree heightfield terrain with CDLOD selection
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "d3dUtil.h"
+#include "LodSelector.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// VertexPosNormalTex followed by the height the vertex morphs to, so the standard
+// three-element layout still draws the terrain, unmorphed, at this stride.
+struct TerrainVertex
+{
+	DirectX::XMFLOAT3 pos;
+	DirectX::XMFLOAT3 normal;
+	DirectX::XMFLOAT2 tex;
+	// Height of the parent node's surface below the vertex.
+	float morphHeight;
+	static const D3D12_INPUT_ELEMENT_DESC inputLayout[4];
+};
+
+struct TerrainNode
+{
+	// World bounds of the node's vertices.
+	DirectX::BoundingBox Bounds;
+	// 0 is the finest level; a node of level L steps 2^L heightmap samples per grid quad.
+	std::uint32_t Level;
+	// First of the node's vertices, (ChunkQuads + 1)^2 of them in CreateGrid order.
+	std::uint32_t BaseVertex;
+	// Quadrants in grid order: the two of the first rows (towards +z) west to east, then
+	// the two of the last rows.  Terrain::NoNode for quadrants past the heightmap.
+	std::uint32_t Children[4];
+};
+
+// A node, or one quadrant of it, to draw with the shared grid index buffer:
+// DrawIndexedInstanced(IndexCount, 1, StartIndexLocation, BaseVertexLocation, 0).
+struct TerrainChunk
+{
+	std::uint32_t Node;
+	UINT IndexCount;
+	UINT StartIndexLocation;
+	INT BaseVertexLocation;
+	// The vertex shader morphs towards morphHeight by
+	// saturate((distance to eye - MorphStart) / (MorphEnd - MorphStart)).
+	float MorphStart;
+	float MorphEnd;
+};
+
+struct TerrainSelectStatistics
+{
+	size_t NodesVisited = 0;
+	size_t NodesCulled = 0;
+	size_t Chunks = 0;
+	size_t Triangles = 0;
+	// Triangles of the whole heightmap at the finest level.
+	size_t FullTriangles = 0;
+};
+
+// Splits a heightmap into a quadtree of square chunks after CDLOD (Strugar, "Continuous
+// Distance-Dependent Level of Detail for Rendering Heightmaps").  Every node, whatever
+// its level, is a grid of ChunkQuads x ChunkQuads quads with its heights baked into its
+// own vertices, so all nodes share one CreateGrid index buffer.  That buffer is ordered
+// by quadrant, which lets a node draw only the quadrants its children leave uncovered.
+//
+// Level L is used up to a range at which its quads look threshold pixels wide, so the
+// ranges double from level to level.  Over the last part of its range a node morphs
+// each vertex to the surface of its parent, so switching levels does not pop and the
+// edges between neighbouring levels stay closed.  Selection walks the tree from the
+// roots, culls against frustum planes and allocates nothing once the chunk vector has
+// grown, so it costs microseconds per frame.
+//
+// Every node keeps its own vertices, which costs about 4/3 of a TerrainVertex per
+// heightmap sample over all levels.
+class Terrain
+{
+public:
+	static constexpr std::uint32_t NoNode = ~0u;
+	static constexpr std::uint32_t DefaultChunkQuads = 32;
+	static constexpr std::uint32_t MaxChunkQuads = 254;
+	static constexpr std::uint32_t MaxLevels = 16;
+	// Width in pixels of a grid quad at the far end of its level's range.
+	static constexpr float DefaultThreshold = 8.0f;
+	// Where in a level's range, between the previous level's range and its own, the
+	// morph starts.  Below 0.5 a coarser neighbour may already be morphing where a node
+	// meets it, which opens cracks.
+	static constexpr float DefaultMorphStart = 0.7f;
+
+	// heights holds width * depth samples, row by row, spacing apart in x and z.  As in
+	// CreateGrid, the terrain is centred on the origin, the first row lies towards +z and
+	// texture coordinates stretch over the whole terrain.  Heights are in world units.
+	// chunkQuads is rounded down to an even number up to MaxChunkQuads; a levelCount of 0
+	// adds levels until one root node covers the heightmap.
+	void Build(const float* heights, std::uint32_t width, std::uint32_t depth, float spacing,
+		std::uint32_t chunkQuads = DefaultChunkQuads, std::uint32_t levelCount = 0);
+
+	// Uploads the vertices and the grid indices; DrawArgs["grid"] is a whole node.
+	std::unique_ptr<MeshGeometry> CreateGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		const std::string& name)const;
+
+	// Fills chunks with what to draw from view.EyePos, all in world space.  planes are the
+	// six inward facing planes of MeshletCuller::ExtractFrustumPlanes, or null to skip
+	// culling.
+	TerrainSelectStatistics Select(const LodView& view, const DirectX::XMFLOAT4* planes,
+		std::vector<TerrainChunk>& chunks, float threshold = DefaultThreshold,
+		float morphStart = DefaultMorphStart)const;
+
+	std::uint32_t ChunkQuads()const { return mChunkQuads; }
+	std::uint32_t LevelCount()const { return mLevelCount; }
+	const std::vector<TerrainNode>& Nodes()const { return mNodes; }
+	const std::vector<std::uint32_t>& Roots()const { return mRoots; }
+	const std::vector<TerrainVertex>& Vertices()const { return mVertices; }
+	// Whole-node grid indices, a quarter of them per quadrant in TerrainNode::Children order.
+	const std::vector<std::uint16_t>& Indices()const { return mIndices; }
+
+private:
+	struct BuildContext;
+	struct SelectContext;
+
+	std::uint32_t AddNode(BuildContext& context, std::uint32_t level, std::uint32_t row, std::uint32_t col);
+	bool SelectNode(SelectContext& context, std::uint32_t index, bool inside)const;
+	void AddChunk(SelectContext& context, std::uint32_t index, std::uint32_t firstQuadrant,
+		std::uint32_t quadrantCount)const;
+
+	std::uint32_t mChunkQuads = 0;
+	std::uint32_t mLevelCount = 0;
+	std::uint32_t mWidth = 0;
+	std::uint32_t mDepth = 0;
+	float mSpacing = 1.0f;
+	std::vector<TerrainNode> mNodes;
+	std::vector<std::uint32_t> mRoots;
+	std::vector<TerrainVertex> mVertices;
+	std::vector<std::uint16_t> mIndices;
+	// Longest bounding box diagonal of the nodes of each level.
+	std::vector<float> mDiagonals;
+};
@@ -0,0 +1,85 @@
+#include "VertexQuantization.h"
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+QuantizationBounds VertexQuantization::ComputeBounds(const VertexPosNormalTex* vertices, size_t count)
+{
+	XMVECTOR vecMin = g_XMInfinity, vecMax = g_XMNegInfinity;
+	for (size_t i = 0; i < count; ++i)
+	{
+		XMVECTOR pos = XMLoadFloat3(&vertices[i].pos);
+		vecMin = XMVectorMin(vecMin, pos);
+		vecMax = XMVectorMax(vecMax, pos);
+	}
+	if (count == 0)
+		vecMin = vecMax = XMVectorZero();
+
+	QuantizationBounds bounds;
+	XMStoreFloat3(&bounds.Offset, vecMin);
+	XMStoreFloat3(&bounds.Scale, XMVectorSubtract(vecMax, vecMin));
+	return bounds;
+}
+
+XMVECTOR XM_CALLCONV VertexQuantization::OctEncode(FXMVECTOR n)
+{
+	// Project onto the octahedron |x|+|y|+|z| = 1, then fold the lower half over the
+	// diagonals so that the whole sphere covers the unit square.
+	XMVECTOR l1 = XMVector3Dot(XMVectorAbs(n), g_XMOne);
+	XMVECTOR p = XMVectorDivide(n, XMVectorMax(l1, XMVectorReplicate(1e-20f)));
+
+	XMVECTOR yx = XMVectorSwizzle<XM_SWIZZLE_Y, XM_SWIZZLE_X, XM_SWIZZLE_Z, XM_SWIZZLE_W>(p);
+	XMVECTOR sign = XMVectorSelect(g_XMNegativeOne, g_XMOne, XMVectorGreaterOrEqual(p, XMVectorZero()));
+	XMVECTOR folded = XMVectorMultiply(XMVectorSubtract(g_XMOne, XMVectorAbs(yx)), sign);
+
+	XMVECTOR lower = XMVectorLess(XMVectorSplatZ(p), XMVectorZero());
+	return XMVectorSelect(p, folded, lower);
+}
+
+XMVECTOR XM_CALLCONV VertexQuantization::OctDecode(FXMVECTOR e)
+{
+	XMVECTOR absE = XMVectorAbs(e);
+	// z = 1 - |x| - |y|; negative z means the point was folded.
+	XMVECTOR z = XMVectorSubtract(g_XMOne, XMVectorAdd(XMVectorSplatX(absE), XMVectorSplatY(absE)));
+
+	XMVECTOR yx = XMVectorSwizzle<XM_SWIZZLE_Y, XM_SWIZZLE_X, XM_SWIZZLE_Z, XM_SWIZZLE_W>(absE);
+	XMVECTOR sign = XMVectorSelect(g_XMNegativeOne, g_XMOne, XMVectorGreaterOrEqual(e, XMVectorZero()));
+	XMVECTOR unfolded = XMVectorMultiply(XMVectorSubtract(g_XMOne, yx), sign);
+	XMVECTOR xy = XMVectorSelect(e, unfolded, XMVectorLess(z, XMVectorZero()));
+
+	XMVECTOR n = XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_1Z, XM_PERMUTE_1W>(xy, z);
+	return XMVector3Normalize(XMVectorSetW(n, 0.0f));
+}
+
+void VertexQuantization::Encode(const VertexPosNormalTex* src, size_t count, const QuantizationBounds& bounds,
+	VertexPosNormalTexQuantized* dst)
+{
+	XMVECTOR offset = XMLoadFloat3(&bounds.Offset);
+	XMVECTOR scale = XMLoadFloat3(&bounds.Scale);
+	// A flat axis has Scale 0 and encodes as 0.
+	XMVECTOR invScale = XMVectorSelect(XMVectorReciprocal(scale), XMVectorZero(),
+		XMVectorEqual(scale, XMVectorZero()));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		// The N formats saturate and round to nearest.
+		XMVECTOR pos = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&src[i].pos), offset), invScale);
+		XMStoreUShortN4(&dst[i].pos, XMVectorSetW(pos, 0.0f));
+		XMStoreShortN2(&dst[i].normal, OctEncode(XMLoadFloat3(&src[i].normal)));
+		XMStoreHalf2(&dst[i].tex, XMLoadFloat2(&src[i].tex));
+	}
+}
+
+void VertexQuantization::Decode(const VertexPosNormalTexQuantized* src, size_t count, const QuantizationBounds& bounds,
+	VertexPosNormalTex* dst)
+{
+	XMVECTOR offset = XMLoadFloat3(&bounds.Offset);
+	XMVECTOR scale = XMLoadFloat3(&bounds.Scale);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		XMStoreFloat3(&dst[i].pos, XMVectorMultiplyAdd(XMLoadUShortN4(&src[i].pos), scale, offset));
+		XMStoreFloat3(&dst[i].normal, OctDecode(XMLoadShortN2(&src[i].normal)));
+		XMStoreFloat2(&dst[i].tex, XMLoadHalf2(&src[i].tex));
+	}
+}
@@ -0,0 +1,38 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// VertexPosNormalTex <-> VertexPosNormalTexQuantized
+//
+//////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "d3dUtil.h"
+
+// Dequantized position = Offset + pos.xyz * Scale.  No shader reads the quantized
+// layout; it is a storage format that ReadMbo decodes back to VertexPosNormalTex.
+struct QuantizationBounds
+{
+	DirectX::XMFLOAT3 Offset;
+	DirectX::XMFLOAT3 Scale;
+};
+
+// Error of a round trip:
+//   position  half a 16-bit step, Scale / 131070 per axis (plus float rounding)
+//   normal    below 0.0001 radians
+//   texcoord  half precision, relative error at most 2^-11
+class VertexQuantization
+{
+public:
+	static constexpr float MaxNormalRadians = 0.0001f;
+
+	// The AABB of the positions, which is the tightest box for quantization.
+	static QuantizationBounds ComputeBounds(const VertexPosNormalTex* vertices, size_t count);
+
+	static void Encode(const VertexPosNormalTex* src, size_t count, const QuantizationBounds& bounds,
+		VertexPosNormalTexQuantized* dst);
+	static void Decode(const VertexPosNormalTexQuantized* src, size_t count, const QuantizationBounds& bounds,
+		VertexPosNormalTex* dst);
+
+	// Unit vector -> point in [-1,1]^2 (x,y) and back.
+	static DirectX::XMVECTOR XM_CALLCONV OctEncode(DirectX::FXMVECTOR n);
+	static DirectX::XMVECTOR XM_CALLCONV OctDecode(DirectX::FXMVECTOR e);
+};
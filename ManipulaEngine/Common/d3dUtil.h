@@ -412,6 +412,16 @@ struct VertexPosNormalTangentTex
 	static const D3D12_INPUT_ELEMENT_DESC inputLayout[4];
 };
 
+// 16-byte form of VertexPosNormalTex, see VertexQuantization.h.
+struct VertexPosNormalTexQuantized
+{
+	// xyz as a fraction of the part bounds, w unused
+	DirectX::PackedVector::XMUSHORTN4 pos;
+	// octahedral encoded unit normal
+	DirectX::PackedVector::XMSHORTN2 normal;
+	DirectX::PackedVector::XMHALF2 tex;
+};
+
 #ifndef ThrowIfFailed
 #define ThrowIfFailed(x)                                              \
 {                                                                     \